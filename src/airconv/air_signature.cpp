@@ -468,6 +468,15 @@ uint32_t FunctionSignatureBuilder::DefineInput(const FunctionInput &input) {
   return index;
 };
 
+std::optional<uint32_t> FunctionSignatureBuilder::FindInput(const FunctionInput &input) const {
+  for (uint32_t i = 0; i < inputs.size(); i++) {
+    if (inputs[i].index() == input.index()) {
+      return i;
+    }
+  }
+  return std::nullopt;
+};
+
 uint32_t FunctionSignatureBuilder::DefineOutput(const FunctionOutput &output) {
   uint32_t index = outputs.size();
   for (uint32_t i = 0; i < index; i++) {
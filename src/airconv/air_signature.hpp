@@ -613,6 +613,8 @@ public:
    * for ArgumentBinding*: no guarantee
    */
   uint32_t DefineInput(const FunctionInput &input);
+  /* index of an input of the same variant type, if already defined */
+  std::optional<uint32_t> FindInput(const FunctionInput &input) const;
   uint32_t DefineOutput(const FunctionOutput &output);
   uint32_t DefineMeshVertexOutput(const MeshVertexOutput &output);
   uint32_t DefineMeshPrimitiveOutput(const MeshPrimitiveOutput &output);
@@ -46,6 +46,16 @@ static cl::opt<std::string>
 static cl::opt<std::string>
   GeometryAfterVertex("geometry-after-vertex", cl::desc("Compile vertex shader with supplied geometry shader"));
 
+static cl::opt<unsigned> DepthBoundsTest(
+  "depth-bounds-test", cl::init(0),
+  cl::desc("Compile pixel shader with depth bounds test, value is the sample count of depth attachment")
+);
+
+static cl::opt<bool> DepthBoundsTestArray(
+  "depth-bounds-test-array", cl::init(false),
+  cl::desc("Read the depth attachment of depth bounds test as a 2d array")
+);
+
 static cl::opt<bool>
   EmitLLVM("S", cl::init(false), cl::desc("Write output as LLVM assembly"));
 
@@ -221,6 +231,15 @@ int main(int argc, char **argv) {
   data.next = 0;
   data.type = SM50_SHADER_COMMON;
 
+  SM50_SHADER_PSO_PIXEL_SHADER_DATA pixel_data = {};
+  if (DepthBoundsTest) {
+    pixel_data.type = SM50_SHADER_PSO_PIXEL_SHADER;
+    pixel_data.next = &data;
+    pixel_data.sample_mask = 0xffffffff;
+    pixel_data.depth_bounds_test_sample_count = DepthBoundsTest;
+    pixel_data.depth_bounds_test_array = DepthBoundsTestArray;
+  }
+
   if (!HullBeforeDomain.getValue().empty()) {
     ErrorOr<std::unique_ptr<MemoryBuffer>> FileOrErr =
       MemoryBuffer::getFile(HullBeforeDomain, /*IsText=*/false);
@@ -363,7 +382,11 @@ int main(int argc, char **argv) {
     }
   } else {
     if (auto err =
-          dxmt::dxbc::convertDXBC(sm50, "shader_main", Context, M, (SM50_SHADER_COMPILATION_ARGUMENT_DATA *)&data)) {
+          dxmt::dxbc::convertDXBC(
+            sm50, "shader_main", Context, M,
+            DepthBoundsTest ? (SM50_SHADER_COMPILATION_ARGUMENT_DATA *)&pixel_data
+                            : (SM50_SHADER_COMPILATION_ARGUMENT_DATA *)&data
+          )) {
       errs() << err << '\n';
       return 1;
     }
@@ -241,6 +241,16 @@ struct SM50_SHADER_PSO_PIXEL_SHADER_DATA {
   bool dual_source_blending;
   bool disable_depth_output;
   uint32_t unorm_output_reg_mask;
+  /**
+  0 if disabled, otherwise sample count of the depth attachment. Fragments are
+  discarded if the stored depth is outside of [min, max] read from fragment
+  buffer 27, a copy of the depth attachment is read from fragment texture 30.
+  */
+  uint32_t depth_bounds_test_sample_count;
+  /**
+  The copy is a 2d array, indexed by the render target array index.
+  */
+  bool depth_bounds_test_array;
 };
 
 struct SM50_IA_INPUT_ELEMENT {
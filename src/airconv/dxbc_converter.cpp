@@ -420,12 +420,16 @@ llvm::Error convert_dxbc_pixel_shader(
   bool pso_dual_source_blending = false;
   bool pso_disable_depth_output = false;
   uint32_t pso_unorm_output_reg_mask = 0;
+  uint32_t pso_depth_bounds_test_sample_count = 0;
+  bool pso_depth_bounds_test_array = false;
   SM50_SHADER_PSO_PIXEL_SHADER_DATA *pso_data = nullptr;
   if (args_get_data<SM50_SHADER_PSO_PIXEL_SHADER, SM50_SHADER_PSO_PIXEL_SHADER_DATA>(pArgs, &pso_data)) {
     pso_dual_source_blending = pso_data->dual_source_blending;
     pso_disable_depth_output = pso_data->disable_depth_output;
     pso_unorm_output_reg_mask = pso_data->unorm_output_reg_mask;
     pso_sample_mask = pso_data->sample_mask;
+    pso_depth_bounds_test_sample_count = pso_data->depth_bounds_test_sample_count;
+    pso_depth_bounds_test_array = pso_data->depth_bounds_test_array;
   }
   SM50_SHADER_METAL_VERSION metal_version = SM50_SHADER_METAL_310;
   SM50_SHADER_FLAG shader_flags = {};
@@ -447,6 +451,77 @@ llvm::Error convert_dxbc_pixel_shader(
   io_binding_map resource_map;
   air::AirType types(context);
 
+  if (pso_depth_bounds_test_sample_count) {
+    // runs before anything else, so rejected fragments do no work
+    // reuse SV_Position if the shader declares it, so its interpolation is kept
+    uint32_t position_idx;
+    if (auto declared = func_signature.FindInput(air::InputPosition{})) {
+      position_idx = *declared;
+    } else {
+      position_idx = func_signature.DefineInput(
+        air::InputPosition{.interpolation = air::Interpolation::center_no_perspective}
+      );
+    }
+    auto texture_kind = pso_depth_bounds_test_sample_count > 1
+                          ? (pso_depth_bounds_test_array ? air::TextureKind::depth_2d_ms_array
+                                                         : air::TextureKind::depth_2d_ms)
+                          : (pso_depth_bounds_test_array ? air::TextureKind::depth_2d_array
+                                                         : air::TextureKind::depth_2d);
+    // a layered draw reads the slice it renders to
+    uint32_t array_index_idx = ~0u;
+    if (pso_depth_bounds_test_array) {
+      array_index_idx = func_signature.DefineInput(air::InputRenderTargetArrayIndex{});
+    }
+    auto depth_idx = func_signature.DefineInput(air::ArgumentBindingTexture{
+      .location_index = 30,
+      .array_size = 0,
+      .memory_access = air::MemoryAccess::read,
+      .type = air::MSLTexture{
+        .component_type = air::MSLFloat{},
+        .memory_access = air::MemoryAccess::read,
+        .resource_kind = texture_kind,
+        .resource_kind_logical = texture_kind,
+      },
+      .arg_name = "depth_bounds_attachment",
+      .raster_order_group = {}
+    });
+    auto bounds_idx = func_signature.DefineInput(air::ArgumentBindingBuffer{
+      .buffer_size = 8,
+      .location_index = 27,
+      .array_size = 0,
+      .memory_access = air::MemoryAccess::read,
+      .address_space = air::AddressSpace::constant,
+      .type = air::MSLFloat{},
+      .arg_name = "depth_bounds",
+      .raster_order_group = {}
+    });
+    prologue << make_effect([=](struct context ctx) {
+      auto &builder = ctx.builder;
+      auto position = ctx.function->getArg(position_idx);
+      auto coord = builder.CreateFPToUI(
+        builder.CreateShuffleVector(position, {0, 1}), llvm::FixedVectorType::get(ctx.types._int, 2)
+      );
+      llvm::air::Texture texture{texture_kind, llvm::air::Texture::sample_float, llvm::air::Texture::access_read};
+      auto array_index = array_index_idx != ~0u ? ctx.function->getArg(array_index_idx) : nullptr;
+      auto [depth, _] = ctx.air.CreateRead(
+        texture, ctx.function->getArg(depth_idx), coord, array_index, builder.getInt32(0), builder.getInt32(0)
+      );
+      auto bounds = ctx.function->getArg(bounds_idx);
+      auto min_depth = builder.CreateLoad(ctx.types._float, builder.CreateConstGEP1_32(ctx.types._float, bounds, 0));
+      auto max_depth = builder.CreateLoad(ctx.types._float, builder.CreateConstGEP1_32(ctx.types._float, bounds, 1));
+      auto out_of_bounds =
+        builder.CreateOr(builder.CreateFCmpOLT(depth, min_depth), builder.CreateFCmpOGT(depth, max_depth));
+      auto discard_bb = llvm::BasicBlock::Create(ctx.llvm, "depth_bounds_discard", ctx.function);
+      auto pass_bb = llvm::BasicBlock::Create(ctx.llvm, "depth_bounds_pass", ctx.function);
+      builder.CreateCondBr(out_of_bounds, discard_bb, pass_bb);
+      builder.SetInsertPoint(discard_bb);
+      ctx.air.CreateDiscard();
+      builder.CreateBr(pass_bb);
+      builder.SetInsertPoint(pass_bb);
+      return std::monostate();
+    });
+  }
+
   {
     SignatureContext sig_ctx(prologue, epilogue, func_signature, resource_map);
     sig_ctx.dual_source_blending = pso_dual_source_blending;
@@ -71,7 +71,13 @@ public:
     // if (pDesc->Usage != D3D11_USAGE_DEFAULT)
     if (pDesc->Usage == D3D11_USAGE_IMMUTABLE)
       flags.set(BufferAllocationFlag::GpuReadonly);
-    if (pDesc->Usage != D3D11_USAGE_DYNAMIC) {
+    if (pDesc->Usage == D3D11_USAGE_DEFAULT && pDesc->CPUAccessFlags) {
+      // MapOnDefaultBuffers: lives in shared storage and is mapped in place
+      flags.set(BufferAllocationFlag::CpuMappable);
+#ifdef __i386__
+      flags.set(BufferAllocationFlag::CpuPlaced);
+#endif
+    } else if (pDesc->Usage != D3D11_USAGE_DYNAMIC) {
       if (pInitialData)
         flags.set(BufferAllocationFlag::GpuManaged);
       else if (pDesc->BindFlags & kD3D11OutputBindFlags)
@@ -96,7 +102,10 @@ public:
     structured = pDesc->MiscFlags & D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
     allow_raw_view = pDesc->MiscFlags & D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
     if (!(desc.BindFlags & kD3D11OutputBindFlags)) {
-      dynamic_ = new DynamicBuffer(buffer_.ptr(), flags);
+      // small constant buffers are renamed into a ring shared by all of them
+      bool use_ring = pDesc->Usage == D3D11_USAGE_DYNAMIC && pDesc->BindFlags == D3D11_BIND_CONSTANT_BUFFER &&
+                      pDesc->ByteWidth <= DynamicBufferRing::kMaxBufferLength && !m_parent->IsTraced();
+      dynamic_ = new DynamicBuffer(buffer_.ptr(), flags, use_ring);
     }
   }
 
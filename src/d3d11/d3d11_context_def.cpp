@@ -65,6 +65,26 @@ void DeferredContextBase::UseCopySource(Rc<StagingResource> &staging) {
   ctx_state.current_cmdlist->read_staging_resources.push_back(staging);
 }
 
+template <>
+void DeferredContextBase::UseBuffer(const Rc<Buffer> &buffer) {
+  // the immediate context treats an executed command list as using any buffer
+}
+
+template <>
+void DeferredContextBase::UseBoundBuffers() {
+  // same as above
+}
+
+template <>
+bool
+DeferredContextBase::UpdateStagingInPlace(
+    Rc<StagingResource> &staging, UINT DstOffset, const void *pSrcData, UINT SrcRowPitch, UINT SrcDepthPitch,
+    UINT BytesPerRow, UINT Rows, UINT Depth
+) {
+  // must happen when the command list is executed
+  return false;
+}
+
 template <>
 std::pair<BufferAllocation *, uint32_t>
 DeferredContextBase::GetDynamicBufferAllocation(Rc<DynamicBuffer> &dynamic) {
@@ -75,6 +95,24 @@ DeferredContextBase::GetDynamicBufferAllocation(Rc<DynamicBuffer> &dynamic) {
   return {ret.allocation, ret.suballocation};
 }
 
+template <>
+void
+DeferredContextBase::ElideInitialization(Texture *texture, TextureViewKey view, uint32_t planar) {
+  // the command list may be executed after other uses of the texture
+}
+
+template <>
+void
+DeferredContextBase::KeepInitialization(Texture *texture) {
+  // nothing is elided
+}
+
+template <>
+void
+DeferredContextBase::UseBoundTextures(bool compute) {
+  // same as above
+}
+
 class MTLD3D11DeferredContext : public DeferredContextBase {
 public:
   MTLD3D11DeferredContext(MTLD3D11Device *pDevice, UINT ContextFlags) :
@@ -158,19 +196,7 @@ public:
       case D3D11_MAP_READ_WRITE:
         return E_INVALIDARG;
       case D3D11_MAP_WRITE_DISCARD: {
-        if (bind_flag & D3D11_BIND_VERTEX_BUFFER) {
-          state_.InputAssembler.VertexBuffers.set_dirty();
-        }
-        if (bind_flag & D3D11_BIND_CONSTANT_BUFFER) {
-          for (auto &stage : state_.ShaderStages) {
-            stage.ConstantBuffers.set_dirty();
-          }
-        }
-        if (bind_flag & D3D11_BIND_SHADER_RESOURCE) {
-          for (auto &stage : state_.ShaderStages) {
-            stage.SRVs.set_dirty();
-          }
-        }
+        DirtyRenamedResourceBindings(pResource);
 
         pMappedResource->pData = MapDynamicBuffer(dynamic);
         pMappedResource->RowPitch = buffer_length;
@@ -201,9 +227,7 @@ public:
       case D3D11_MAP_READ_WRITE:
         return E_INVALIDARG;
       case D3D11_MAP_WRITE_DISCARD: {
-        for (auto &stage : state_.ShaderStages) {
-            stage.SRVs.set_dirty();
-        }
+        DirtyRenamedResourceBindings(pResource);
         Rc<TextureAllocation> new_allocation = dynamic->allocate(ctx_state.cmd_queue.CoherentSeqId());
         uint32_t id = ctx_state.current_cmdlist->used_dynamic_lineartextures.size();
         // track the current allocation in case of a following NO_OVERWRITE map
@@ -251,9 +275,7 @@ public:
       case D3D11_MAP_WRITE_NO_OVERWRITE:
         return E_INVALIDARG;
       case D3D11_MAP_WRITE_DISCARD: {
-        for (auto &stage : state_.ShaderStages) {
-            stage.SRVs.set_dirty();
-        }
+        DirtyRenamedResourceBindings(pResource);
         pMappedResource->pData = MapDynamicBuffer(dynamic);
         pMappedResource->RowPitch = row_pitch;
         pMappedResource->DepthPitch = depth_pitch;
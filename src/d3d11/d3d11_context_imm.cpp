@@ -12,6 +12,7 @@ struct ContextInternalState {
   using device_mutex_t = d3d11_device_mutex;
   CommandQueue &cmd_queue;
   bool has_dirty_op_since_last_event = false;
+  uint64_t bound_buffers_used_seq_id = 0;
 };
 
 
@@ -64,12 +65,95 @@ ImmediateContextBase::UseCopySource(Rc<StagingResource> &staging) {
   staging->useCopySource(ctx_state.cmd_queue.CurrentSeqId());
 }
 
+template <>
+void
+ImmediateContextBase::UseBuffer(const Rc<Buffer> &buffer) {
+  buffer->recordUse(ctx_state.cmd_queue.CurrentSeqId());
+}
+
+/**
+Bindings are recorded as uses when they're made, but a buffer that stays bound
+is also accessed by draws and dispatches in later chunks, so record those once
+per chunk
+*/
+template <>
+void
+ImmediateContextBase::UseBoundBuffers() {
+  auto seq_id = ctx_state.cmd_queue.CurrentSeqId();
+  if (ctx_state.bound_buffers_used_seq_id == seq_id)
+    return;
+  ctx_state.bound_buffers_used_seq_id = seq_id;
+  AnyBoundBuffer([=](Buffer *buffer) {
+    if (buffer)
+      buffer->recordUse(seq_id);
+    return false;
+  });
+}
+
+template <>
+bool
+ImmediateContextBase::UpdateStagingInPlace(
+    Rc<StagingResource> &staging, UINT DstOffset, const void *pSrcData, UINT SrcRowPitch, UINT SrcDepthPitch,
+    UINT BytesPerRow, UINT Rows, UINT Depth
+) {
+  auto coherent_seq_id = ctx_state.cmd_queue.CoherentSeqId();
+  auto result = staging->tryMap(coherent_seq_id, false, true);
+  if (result == StagingMapResult::Renamable) {
+    // only read by the GPU, the update goes to a new name
+    auto next_name = staging->allocate(coherent_seq_id);
+    std::memcpy(staging->mappedMemory(next_name), staging->mappedImmediateMemory(), staging->length);
+    staging->updateImmediateName(ctx_state.cmd_queue.CurrentSeqId(), next_name);
+    EmitST([staging, next_name](ArgumentEncodingContext &enc) mutable {
+      auto _ = staging->buffer()->rename(staging->allocation(next_name));
+    });
+    result = StagingMapResult::Mappable;
+  }
+  if (result != StagingMapResult::Mappable)
+    return false;
+  WriteStagingRows(
+      ptr_add(staging->mappedImmediateMemory(), DstOffset), staging->bytesPerRow, staging->bytesPerImage, pSrcData,
+      SrcRowPitch, SrcDepthPitch, BytesPerRow, Rows, Depth
+  );
+  return true;
+}
+
 template <>
 std::pair<BufferAllocation *, uint32_t>
 ImmediateContextBase::GetDynamicBufferAllocation(Rc<DynamicBuffer> &dynamic) {
   return {dynamic->immediateName().ptr(), dynamic->immediateSuballocation()};
 }
 
+template <>
+void
+ImmediateContextBase::ElideInitialization(Texture *texture, TextureViewKey view, uint32_t planar) {
+  ctx_state.cmd_queue.initializer.elideWithClear(texture->current(), view, planar);
+}
+
+template <>
+void
+ImmediateContextBase::KeepInitialization(Texture *texture) {
+  auto &initializer = ctx_state.cmd_queue.initializer;
+  if (texture && initializer.hasPendingClears())
+    initializer.keepInitialization(texture->current());
+}
+
+/**
+Only a clear that comes first can stand in for zero initialization, textures
+bound to a draw or dispatch may be accessed by it
+*/
+template <>
+void
+ImmediateContextBase::UseBoundTextures(bool compute) {
+  auto &initializer = ctx_state.cmd_queue.initializer;
+  if (!initializer.hasPendingClears())
+    return;
+  AnyBoundTexture(compute, [&](Texture *texture) {
+    if (texture)
+      initializer.keepInitialization(texture->current());
+    return false;
+  });
+}
+
 class MTLD3D11ImmediateContext : public ImmediateContextBase {
 public:
   MTLD3D11ImmediateContext(MTLD3D11Device *pDevice, CommandQueue &cmd_queue) :
@@ -117,7 +201,16 @@ public:
 
   void *
   MapDynamicBuffer(Rc<DynamicBuffer> &dynamic, uint64_t current_seq_id, uint64_t coherent_seq_id) {
-    if (auto next_sub = dynamic->nextSuballocation()) {
+    if (dynamic->renameToRing(cmd_queue.GetDynamicBufferRing(), current_seq_id, coherent_seq_id)) {
+      EmitST([allocation = dynamic->immediateName(), sub = dynamic->immediateSuballocation(),
+              buffer = Rc(dynamic->buffer)](ArgumentEncodingContext &enc) mutable {
+        allocation->useSuballocation(sub);
+        // only the offset changes once the buffer lives in the ring
+        if (buffer->current() != allocation.ptr()) {
+          auto _ = buffer->rename(forward_rc(allocation));
+        }
+      });
+    } else if (auto next_sub = dynamic->nextSuballocation()) {
       EmitST([allocation = dynamic->immediateName(), next_sub](ArgumentEncodingContext &enc) mutable {
         allocation->useSuballocation(next_sub);
       });
@@ -150,21 +243,12 @@ public:
       case D3D11_MAP_READ:
       case D3D11_MAP_WRITE:
       case D3D11_MAP_READ_WRITE:
-        return E_INVALIDARG;
+        return MapDefaultBuffer(
+            GetResourceCommon(pResource)->buffer().ptr(), dynamic->immediateName().ptr(),
+            dynamic->immediateMappedMemory(), buffer_length, MapType, MapFlags, pMappedResource
+        );
       case D3D11_MAP_WRITE_DISCARD: {
-        if (bind_flag & D3D11_BIND_VERTEX_BUFFER) {
-          state_.InputAssembler.VertexBuffers.set_dirty();
-        }
-        if (bind_flag & D3D11_BIND_CONSTANT_BUFFER) {
-          for (auto &stage : state_.ShaderStages) {
-            stage.ConstantBuffers.set_dirty();
-          }
-        }
-        if (bind_flag & D3D11_BIND_SHADER_RESOURCE) {
-          for (auto &stage : state_.ShaderStages) {
-            stage.SRVs.set_dirty();
-          }
-        }
+        DirtyRenamedResourceBindings(pResource);
 
         pMappedResource->pData = MapDynamicBuffer(dynamic, current_seq_id, coherent_seq_id);
         pMappedResource->RowPitch = buffer_length;
@@ -188,9 +272,7 @@ public:
       case D3D11_MAP_WRITE_NO_OVERWRITE:
         return E_INVALIDARG;
       case D3D11_MAP_WRITE_DISCARD: {
-        for (auto &stage : state_.ShaderStages) {
-          stage.SRVs.set_dirty();
-        }
+        DirtyRenamedResourceBindings(pResource);
 
         pMappedResource->pData = MapDynamicBuffer(dynamic, current_seq_id, coherent_seq_id);
         pMappedResource->RowPitch = row_pitch;
@@ -207,9 +289,7 @@ public:
       case D3D11_MAP_READ_WRITE:
         return E_INVALIDARG;
       case D3D11_MAP_WRITE_DISCARD: {
-        for (auto &stage : state_.ShaderStages) {
-          stage.SRVs.set_dirty();
-        }
+        DirtyRenamedResourceBindings(pResource);
 
         dynamic->updateImmediateName(current_seq_id, dynamic->allocate(coherent_seq_id), false);
         EmitST([allocation = dynamic->immediateName(),
@@ -238,6 +318,7 @@ public:
       if (ignore_map_flag_no_wait_)
         MapFlags &= ~D3D11_MAP_FLAG_DO_NOT_WAIT;
 
+      bool stalled = false;
       while (true) {
         auto result = staging->tryMap(coherent_seq_id, MapType & D3D11_MAP_READ, MapType & D3D11_MAP_WRITE);
         if (result == StagingMapResult::Mapped)
@@ -255,12 +336,22 @@ public:
         }
         if (result == StagingMapResult::Mappable) {
           TRACE("staging map ready");
+          if (MapType & D3D11_MAP_READ) {
+            auto &statistics = cmd_queue.CurrentFrameStatistics();
+            if (stalled)
+              statistics.readback_stalled++;
+            else
+              statistics.readback_ready++;
+          }
           pMappedResource->pData = staging->mappedImmediateMemory();
           pMappedResource->RowPitch = staging->bytesPerRow;
           pMappedResource->DepthPitch = staging->bytesPerImage;
           return S_OK;
         }
         if (MapFlags & D3D11_MAP_FLAG_DO_NOT_WAIT) {
+          // the pending copy may still sit in the open chunk, a poll must not wait on it forever
+          if (coherent_seq_id + uint64_t(result) >= current_seq_id)
+            Flush();
           return DXGI_ERROR_WAS_STILL_DRAWING;
         }
         // even it's in a while loop
@@ -274,16 +365,70 @@ public:
         auto t1 = clock::now();
         statistics.sync_count++;
         statistics.sync_interval += (t1 - t0);
+        stalled = true;
         current_seq_id = cmd_queue.CurrentSeqId();
         coherent_seq_id = cmd_queue.CoherentSeqId();
       };
     };
-    if (pMappedResource == nullptr) {
-      UNIMPLEMENTED("map-on-default: map");
+    if (auto &buffer = GetResourceCommon(pResource)->buffer(); buffer.ptr()) {
+      // never renamed without a DynamicBuffer, so the current name is also the immediate one
+      auto allocation = buffer->current();
+      return MapDefaultBuffer(
+          buffer.ptr(), allocation, allocation->mappedMemory(0), buffer->length(), MapType, MapFlags, pMappedResource
+      );
     }
     return E_INVALIDARG;
   }
 
+  HRESULT
+  MapDefaultBuffer(
+      Buffer *buffer, BufferAllocation *allocation, void *mapped, UINT length, D3D11_MAP MapType, UINT MapFlags,
+      D3D11_MAPPED_SUBRESOURCE *pMappedResource
+  ) {
+    if (!allocation->flags().test(BufferAllocationFlag::CpuMappable))
+      return E_INVALIDARG;
+    if (MapType == D3D11_MAP_WRITE_DISCARD)
+      return E_INVALIDARG;
+
+    if (MapType != D3D11_MAP_WRITE_NO_OVERWRITE) {
+      bool do_not_wait = (MapFlags & D3D11_MAP_FLAG_DO_NOT_WAIT) && !ignore_map_flag_no_wait_;
+      auto current_seq_id = cmd_queue.CurrentSeqId();
+      // the last chunk that may access the buffer, as far as it's known before encoding
+      auto last_use = std::max(buffer->lastRecordedUse(), executed_command_list_seq_id_);
+      if (last_use == current_seq_id) {
+        Flush();
+        // nothing is committed if the open chunk has no operation that could access it
+        last_use = cmd_queue.CurrentSeqId() - 1;
+      }
+      if (last_use > cmd_queue.CoherentSeqId()) {
+        // GPU accesses are recorded while encoding
+        if (!cmd_queue.IsEncoded(last_use)) {
+          if (do_not_wait)
+            return DXGI_ERROR_WAS_STILL_DRAWING;
+          cmd_queue.WaitEncoded(last_use);
+        }
+        // a read only has to wait for the last writer
+        auto seq_id = (MapType & D3D11_MAP_WRITE) ? allocation->lastGpuAccess() : allocation->lastGpuWrite();
+        if (seq_id > cmd_queue.CoherentSeqId()) {
+          if (do_not_wait)
+            return DXGI_ERROR_WAS_STILL_DRAWING;
+          TRACE("default buffer map block");
+          auto &statistics = cmd_queue.CurrentFrameStatistics();
+          auto t0 = clock::now();
+          cmd_queue.WaitCPUFence(seq_id);
+          auto t1 = clock::now();
+          statistics.sync_count++;
+          statistics.sync_interval += (t1 - t0);
+        }
+      }
+    }
+
+    pMappedResource->pData = mapped;
+    pMappedResource->RowPitch = length;
+    pMappedResource->DepthPitch = length;
+    return S_OK;
+  }
+
   void
   STDMETHODCALLTYPE
   Unmap(ID3D11Resource *pResource, UINT Subresource) override {
@@ -317,6 +462,8 @@ public:
     ((ID3D11Query *)pAsync)->GetDesc(&desc);
     switch (desc.Query) {
     case D3D11_QUERY_TIMESTAMP_DISJOINT:
+      static_cast<MTLD3D11TimestampDisjointQuery *>(pAsync)->Begin(cmd_queue.CalibrateTimestamps());
+      break;
     case D3D11_QUERY_TIMESTAMP:
     case D3D11_QUERY_EVENT:
       break;
@@ -351,6 +498,8 @@ public:
     ((ID3D11Query *)pAsync)->GetDesc(&desc);
     switch (desc.Query) {
     case D3D11_QUERY_TIMESTAMP_DISJOINT:
+      static_cast<MTLD3D11TimestampDisjointQuery *>(pAsync)->End(cmd_queue.CalibrateTimestamps());
+      [[fallthrough]];
     case D3D11_QUERY_EVENT: {
       if (ctx_state.has_dirty_op_since_last_event) {
         auto event_id = cmd_queue.GetNextEventSeqId();
@@ -378,7 +527,7 @@ public:
     }
     case D3D11_QUERY_OCCLUSION:
     case D3D11_QUERY_OCCLUSION_PREDICATE: {
-      if (auto query = static_cast<MTLD3D11OcclusionQuery *>(pAsync)->End())
+      if (auto query = static_cast<MTLD3D11OcclusionQuery *>(pAsync)->End(render_pass_id_))
         EmitST([query = Rc(query)](ArgumentEncodingContext &enc) mutable {
           enc.endVisibilityResultQuery(std::move(query));
         });
@@ -454,8 +603,14 @@ public:
       break;
     }
     case D3D11_QUERY_TIMESTAMP_DISJOINT: {
+      if (hr != S_OK)
+        break;
+      auto &result = static_cast<MTLD3D11TimestampDisjointQuery *>(pAsync)->GetResult([&](uint64_t begin_epoch, uint64_t end_epoch) {
+        BOOL disjoint = begin_epoch != ~0ull && cmd_queue.TimestampDisjoint(begin_epoch, end_epoch);
+        return D3D11_QUERY_DATA_TIMESTAMP_DISJOINT{cmd_queue.TimestampFrequency(), disjoint};
+      });
       if (pData) {
-        (*static_cast<D3D11_QUERY_DATA_TIMESTAMP_DISJOINT *>(pData)) = {1'000'000'000, FALSE};
+        (*static_cast<D3D11_QUERY_DATA_TIMESTAMP_DISJOINT *>(pData)) = result;
       }
       break;
     }
@@ -514,10 +669,14 @@ public:
     auto seq_id = ctx_state.cmd_queue.CurrentSeqId();
 
     promote_flush = cmdlist->promote_flush;
+    // buffers used by command lists are not tracked individually
+    executed_command_list_seq_id_ = seq_id;
+    // neither are textures
+    ctx_state.cmd_queue.initializer.keepAllInitialization();
 
     auto query_list = AllocateCommandData<Rc<VisibilityResultQuery>>(cmdlist->visibility_query_count);
     for (const auto &[query, index] : cmdlist->issued_visibility_query) {
-      query_list[index] = new VisibilityResultQuery();
+      query_list[index] = VisibilityResultQuery::allocate();
       query->DoDeferredQuery(query_list[index].ptr());
     }
 
@@ -628,6 +787,7 @@ private:
   std::atomic<uint32_t> refcount = 0;
   D3D11Multithread d3dmt_;
   bool ignore_map_flag_no_wait_;
+  uint64_t executed_command_list_seq_id_ = 0;
 };
 
 std::unique_ptr<MTLD3D11DeviceContextBase>
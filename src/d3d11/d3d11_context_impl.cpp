@@ -38,7 +38,9 @@
 #include "dxmt_staging.hpp"
 #include "d3d11_resource.hpp"
 #include "dxmt_texture.hpp"
+#include "util_bit.hpp"
 #include "util_flags.hpp"
+#include "util_hash.hpp"
 #include "util_math.hpp"
 #include "util_win32_compat.h"
 
@@ -563,13 +565,11 @@ public:
     DstOrigin = {DstBox.left, DstBox.top, DstBox.front};
     DstSize = {DstBox.right - DstBox.left, DstBox.bottom - DstBox.top, DstBox.back - DstBox.front};
 
-    if (DstFormat.Flag & MTL_DXGI_FORMAT_BC) {
-      EffectiveBytesPerRow = (align(DstSize.width, 4u) >> 2) * DstFormat.BytesPerTexel;
-      EffectiveRows = align(DstSize.height, 4u) >> 2;
-    } else {
-      EffectiveBytesPerRow = DstSize.width * DstFormat.BytesPerTexel;
-      EffectiveRows = DstSize.height;
-    }
+    auto extent = GetStagingExtent(
+        DstSize.width, DstSize.height, DstFormat.BytesPerTexel, DstFormat.Flag & MTL_DXGI_FORMAT_BC
+    );
+    EffectiveBytesPerRow = extent.bytes_per_row;
+    EffectiveRows = extent.rows;
 
     Invalid = false;
   }
@@ -623,7 +623,8 @@ public:
       return S_OK;
     }
 
-    if (riid == __uuidof(IMTLD3D11ContextExt) || riid == __uuidof(IMTLD3D11ContextExt1)) {
+    if (riid == __uuidof(IMTLD3D11ContextExt) || riid == __uuidof(IMTLD3D11ContextExt1) ||
+        riid == __uuidof(IMTLD3D11ContextExt2)) {
       *ppvObject = ref(&ext_);
       return S_OK;
     }
@@ -681,6 +682,8 @@ public:
     SwitchToComputeEncoder();
     D3D11_UNORDERED_ACCESS_VIEW_DESC desc;
     pUAV->GetDesc(&desc);
+    if (auto buffer = pUAV->buffer())
+      UseBuffer(buffer);
     if (desc.ViewDimension == D3D11_UAV_DIMENSION_BUFFER)
       EmitOP([=, buffer = pUAV->buffer(), viewId = pUAV->viewId(), slice = pUAV->bufferSlice(),
             value = std::array<uint32_t, 4>({Values[0], Values[1], Values[2], Values[3]}),
@@ -751,6 +754,8 @@ public:
     SwitchToComputeEncoder();
     D3D11_UNORDERED_ACCESS_VIEW_DESC desc;
     pUAV->GetDesc(&desc);
+    if (auto buffer = pUAV->buffer())
+      UseBuffer(buffer);
     if (desc.ViewDimension == D3D11_UAV_DIMENSION_BUFFER)
       EmitOP([=, buffer = pUAV->buffer(), viewId = pUAV->viewId(), slice = pUAV->bufferSlice(),
             value = std::array<float, 4>({Values[0], Values[1], Values[2], Values[3]}),
@@ -900,6 +905,8 @@ public:
       auto uav = static_cast<D3D11UnorderedAccessView *>(expected.ptr());
       D3D11_UNORDERED_ACCESS_VIEW_DESC1 desc;
       uav->GetDesc1(&desc);
+      if (auto buffer = uav->buffer())
+        UseBuffer(buffer);
       if (desc.ViewDimension != D3D11_UAV_DIMENSION_BUFFER) {
         EmitST([=, texture = uav->texture(),
                 view = uav->viewId()](ArgumentEncodingContext &enc) {
@@ -944,6 +951,7 @@ public:
       if (desc.ViewDimension == D3D11_SRV_DIMENSION_BUFFER || desc.ViewDimension == D3D11_SRV_DIMENSION_BUFFEREX) {
         return;
       }
+      KeepInitialization(srv->texture_);
       SwitchToBlitEncoder(CommandBufferState::BlitEncoderActive);
       EmitOP([tex = srv->texture(), viewId = srv->viewId()](ArgumentEncodingContext &enc) {
         // workaround: mipmap generation of a8unorm is borked, so use a r8unorm view
@@ -997,6 +1005,7 @@ public:
       ERR("ResolveSubresource: invalid format ", Format);
       return;
     }
+    KeepInitialization(GetTexture(pSrcResource).ptr());
     InvalidateCurrentPass();
     EmitOP([src = static_cast<D3D11ResourceCommon *>(pSrcResource)->texture(),
             dst = static_cast<D3D11ResourceCommon *>(pDstResource)->texture(),
@@ -1125,6 +1134,7 @@ public:
     if (auto dst_bind = GetResourceCommon(pDstBuffer)) {
       if (auto uav = static_cast<D3D11UnorderedAccessView *>(pSrcView)) {
         SwitchToBlitEncoder(CommandBufferState::BlitEncoderActive);
+        UseBuffer(dst_bind->buffer());
         EmitOP([=, dst = dst_bind->buffer(), counter = uav->counter()](ArgumentEncodingContext &enc) {
           auto [dst_buffer, dst_offset] = enc.access(dst, DstAlignedByteOffset, 4, ResourceAccess::Write);
           auto [counter_buffer, counter_offset] = enc.access(counter, 0, 4, ResourceAccess::Read);
@@ -1198,11 +1208,12 @@ public:
         // Also MSDN: A resource cannot be used as a destination if: the resource is created with immutable or
         // dynamic usage.
         // So it's legal?
-        UNIMPLEMENTED("update buffer: staging");
+        UpdateStaging(staging, copy_offset, pSrcData, copy_len, copy_len, copy_len, 1, 1);
       } else if (auto bindable = GetResourceCommon(pDstResource)) {
         auto [staging_buffer, offset] = AllocateStagingBuffer(copy_len, 16);
         staging_buffer.updateContents(offset, pSrcData, copy_len);
         SwitchToBlitEncoder(CommandBufferState::UpdateBlitEncoderActive);
+        UseBuffer(bindable->buffer());
         EmitOP([staging_buffer, offset, dst = bindable->buffer(), copy_offset, copy_len](ArgumentEncodingContext &enc) {
           auto [dst_buffer, dst_offset] = enc.access(dst, copy_offset, copy_len, ResourceAccess::Write);
           auto &cmd = enc.encodeBlitCommand<wmtcmd_blit_copy_from_buffer_to_buffer>();
@@ -1269,9 +1280,22 @@ public:
     if (status == DrawCallStatus::Tessellation) {
       return TessellationDraw(ControlPointCount, VertexCount, 1, StartVertexLocation, 0);
     }
+    AdvanceSOFilledSize(VertexCount, 1);
     EmitOP([Primitive, StartVertexLocation, VertexCount](ArgumentEncodingContext& enc) {
+      auto predication = enc.checkPredicate();
+      if (predication == Predication::Skip)
+        return;
       enc.bumpVisibilityResultOffset();
       enc.resolveRenderPassBarrier();
+      if (predication == Predication::Deferred) {
+        auto args = enc.encodePredicatedArguments({VertexCount, 1, StartVertexLocation, 0}, 4);
+        auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw_indirect>();
+        cmd.type = WMTRenderCommandDrawIndirect;
+        cmd.primitive_type = Primitive;
+        cmd.indirect_args_buffer = args.gpu_buffer;
+        cmd.indirect_args_offset = args.offset;
+        return;
+      }
       auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw>();
       cmd.type = WMTRenderCommandDraw;
       cmd.primitive_type = Primitive;
@@ -1307,10 +1331,26 @@ public:
     auto IndexBufferOffset =
         state_.InputAssembler.IndexBufferOffset +
         StartIndexLocation * (state_.InputAssembler.IndexBufferFormat == DXGI_FORMAT_R32_UINT ? 4 : 2);
+    AdvanceSOFilledSize(IndexCount, 1);
     EmitOP([IndexType, IndexBufferOffset, Primitive, IndexCount, BaseVertexLocation](ArgumentEncodingContext &enc) {
+      auto predication = enc.checkPredicate();
+      if (predication == Predication::Skip)
+        return;
       enc.bumpVisibilityResultOffset();
       auto [index_buffer, index_sub_offset] = enc.currentIndexBuffer();
       enc.resolveRenderPassBarrier();
+      if (predication == Predication::Deferred) {
+        auto args = enc.encodePredicatedArguments({IndexCount, 1, 0, uint32_t(BaseVertexLocation), 0}, 5);
+        auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw_indexed_indirect>();
+        cmd.type = WMTRenderCommandDrawIndexedIndirect;
+        cmd.primitive_type = Primitive;
+        cmd.index_type = IndexType;
+        cmd.indirect_args_buffer = args.gpu_buffer;
+        cmd.indirect_args_offset = args.offset;
+        cmd.index_buffer = index_buffer;
+        cmd.index_buffer_offset = IndexBufferOffset + index_sub_offset;
+        return;
+      }
       auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw_indexed>();
       cmd.type = WMTRenderCommandDrawIndexed;
       cmd.primitive_type = Primitive;
@@ -1347,10 +1387,25 @@ public:
           ControlPointCount, VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation
       );
     }
+    AdvanceSOFilledSize(VertexCountPerInstance, InstanceCount);
     EmitOP([Primitive, StartVertexLocation, VertexCountPerInstance, InstanceCount,
           StartInstanceLocation](ArgumentEncodingContext &enc) {
+      auto predication = enc.checkPredicate();
+      if (predication == Predication::Skip)
+        return;
       enc.bumpVisibilityResultOffset();
       enc.resolveRenderPassBarrier();
+      if (predication == Predication::Deferred) {
+        auto args = enc.encodePredicatedArguments(
+            {VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation}, 4
+        );
+        auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw_indirect>();
+        cmd.type = WMTRenderCommandDrawIndirect;
+        cmd.primitive_type = Primitive;
+        cmd.indirect_args_buffer = args.gpu_buffer;
+        cmd.indirect_args_offset = args.offset;
+        return;
+      }
       auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw>();
       cmd.type = WMTRenderCommandDraw;
       cmd.primitive_type = Primitive;
@@ -1394,11 +1449,29 @@ public:
     auto IndexBufferOffset =
         state_.InputAssembler.IndexBufferOffset +
         StartIndexLocation * (state_.InputAssembler.IndexBufferFormat == DXGI_FORMAT_R32_UINT ? 4 : 2);
+    AdvanceSOFilledSize(IndexCountPerInstance, InstanceCount);
     EmitOP([IndexType, IndexBufferOffset, Primitive, InstanceCount, BaseVertexLocation, StartInstanceLocation,
           IndexCountPerInstance](ArgumentEncodingContext &enc) {
+      auto predication = enc.checkPredicate();
+      if (predication == Predication::Skip)
+        return;
       enc.bumpVisibilityResultOffset();
       auto [index_buffer, index_sub_offset] = enc.currentIndexBuffer();
       enc.resolveRenderPassBarrier();
+      if (predication == Predication::Deferred) {
+        auto args = enc.encodePredicatedArguments(
+            {IndexCountPerInstance, InstanceCount, 0, uint32_t(BaseVertexLocation), StartInstanceLocation}, 5
+        );
+        auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw_indexed_indirect>();
+        cmd.type = WMTRenderCommandDrawIndexedIndirect;
+        cmd.primitive_type = Primitive;
+        cmd.index_type = IndexType;
+        cmd.indirect_args_buffer = args.gpu_buffer;
+        cmd.indirect_args_offset = args.offset;
+        cmd.index_buffer = index_buffer;
+        cmd.index_buffer_offset = IndexBufferOffset + index_sub_offset;
+        return;
+      }
       auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw_indexed>();
       cmd.type = WMTRenderCommandDrawIndexed;
       cmd.primitive_type = Primitive;
@@ -1420,6 +1493,8 @@ public:
     auto draw_arguments_offset = PreAllocateArgumentBuffer(sizeof(DXMT_DRAW_ARGUMENTS), 32);
     auto max_object_threadgroups = max_object_threadgroups_;
     EmitOP([=](ArgumentEncodingContext &enc) {
+      if (enc.checkPredicate(false) == Predication::Skip)
+        return;
       DXMT_DRAW_ARGUMENTS *draw_argument = enc.getMappedArgumentBuffer<DXMT_DRAW_ARGUMENTS>(draw_arguments_offset);
       draw_argument->StartVertex = StartVertexLocation;
       draw_argument->VertexCount = VertexCountPerInstance;
@@ -1460,6 +1535,8 @@ public:
     auto draw_arguments_offset = PreAllocateArgumentBuffer(sizeof(DXMT_DRAW_INDEXED_ARGUMENTS), 32);
     auto max_object_threadgroups = max_object_threadgroups_;
     EmitOP([=](ArgumentEncodingContext &enc) {
+      if (enc.checkPredicate(false) == Predication::Skip)
+        return;
       DXMT_DRAW_INDEXED_ARGUMENTS *draw_argument = enc.getMappedArgumentBuffer<DXMT_DRAW_INDEXED_ARGUMENTS>(draw_arguments_offset);
       draw_argument->BaseVertex = BaseVertexLocation;
       draw_argument->IndexCount = IndexCountPerInstance;
@@ -1503,6 +1580,8 @@ public:
     auto draw_arguments_offset = PreAllocateArgumentBuffer(sizeof(DXMT_DRAW_ARGUMENTS), 32);
     auto max_object_threadgroups = max_object_threadgroups_;
     EmitOP([=, topo = state_.InputAssembler.Topology](ArgumentEncodingContext &enc) {
+      if (enc.checkPredicate(false) == Predication::Skip)
+        return;
       DXMT_DRAW_ARGUMENTS *draw_argument = enc.getMappedArgumentBuffer<DXMT_DRAW_ARGUMENTS>(draw_arguments_offset);
       draw_argument->StartVertex = StartVertexLocation;
       draw_argument->VertexCount = VertexCountPerInstance;
@@ -1537,6 +1616,8 @@ public:
     auto draw_arguments_offset = PreAllocateArgumentBuffer(sizeof(DXMT_DRAW_INDEXED_ARGUMENTS), 32);
     auto max_object_threadgroups = max_object_threadgroups_;
     EmitOP([=, topo = state_.InputAssembler.Topology](ArgumentEncodingContext &enc) {
+      if (enc.checkPredicate(false) == Predication::Skip)
+        return;
       DXMT_DRAW_INDEXED_ARGUMENTS *draw_argument = enc.getMappedArgumentBuffer<DXMT_DRAW_INDEXED_ARGUMENTS>(draw_arguments_offset);
       draw_argument->BaseVertex = BaseVertexLocation;
       draw_argument->IndexCount = IndexCountPerInstance;
@@ -1587,9 +1668,14 @@ public:
     auto IndexType =
         state_.InputAssembler.IndexBufferFormat == DXGI_FORMAT_R32_UINT ? WMTIndexTypeUInt32 : WMTIndexTypeUInt16;
     auto IndexBufferOffset = state_.InputAssembler.IndexBufferOffset;
+    AdvanceSOFilledSize(pBufferForArgs, AlignedByteOffsetForArgs);
     if (auto bindable = GetResourceCommon(pBufferForArgs)) {
+      UseBuffer(bindable->buffer());
       EmitOP([IndexType, IndexBufferOffset, Primitive, ArgBuffer = bindable->buffer(),
               AlignedByteOffsetForArgs](ArgumentEncodingContext &enc) {
+        auto predication = enc.checkPredicate();
+        if (predication == Predication::Skip)
+          return;
         auto [buffer, buffer_offset] = enc.access<PipelineStage::Vertex>(
             ArgBuffer, AlignedByteOffsetForArgs, sizeof(DXMT_DRAW_INDEXED_ARGUMENTS), ResourceAccess::Read
         );
@@ -1600,8 +1686,16 @@ public:
         cmd.type = WMTRenderCommandDrawIndexedIndirect;
         cmd.primitive_type = Primitive;
         cmd.index_type = IndexType;
-        cmd.indirect_args_buffer = buffer->buffer();
-        cmd.indirect_args_offset = AlignedByteOffsetForArgs + buffer_offset;
+        if (predication == Predication::Deferred) {
+          auto args = enc.encodePredicatedArguments(
+              buffer->buffer(), buffer->gpuAddress() + buffer_offset + AlignedByteOffsetForArgs, 5
+          );
+          cmd.indirect_args_buffer = args.gpu_buffer;
+          cmd.indirect_args_offset = args.offset;
+        } else {
+          cmd.indirect_args_buffer = buffer->buffer();
+          cmd.indirect_args_offset = AlignedByteOffsetForArgs + buffer_offset;
+        }
         cmd.index_buffer = index_buffer;
         cmd.index_buffer_offset = IndexBufferOffset + index_sub_offset;
       });
@@ -1626,8 +1720,13 @@ public:
     if (status == DrawCallStatus::Tessellation) {
       return TessellationDrawIndirect(ControlPointCount, pBufferForArgs, AlignedByteOffsetForArgs);
     }
+    AdvanceSOFilledSize(pBufferForArgs, AlignedByteOffsetForArgs);
     if (auto bindable = GetResourceCommon(pBufferForArgs)) {
+      UseBuffer(bindable->buffer());
       EmitOP([Primitive, ArgBuffer = bindable->buffer(), AlignedByteOffsetForArgs](ArgumentEncodingContext &enc) {
+        auto predication = enc.checkPredicate();
+        if (predication == Predication::Skip)
+          return;
         auto [buffer, buffer_offset] = enc.access<PipelineStage::Vertex>(
             ArgBuffer, AlignedByteOffsetForArgs, sizeof(DXMT_DRAW_ARGUMENTS), ResourceAccess::Read
         );
@@ -1636,19 +1735,205 @@ public:
         auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw_indirect>();
         cmd.type = WMTRenderCommandDrawIndirect;
         cmd.primitive_type = Primitive;
-        cmd.indirect_args_buffer = buffer->buffer();
-        cmd.indirect_args_offset = AlignedByteOffsetForArgs + buffer_offset;
+        if (predication == Predication::Deferred) {
+          auto args = enc.encodePredicatedArguments(
+              buffer->buffer(), buffer->gpuAddress() + buffer_offset + AlignedByteOffsetForArgs, 4
+          );
+          cmd.indirect_args_buffer = args.gpu_buffer;
+          cmd.indirect_args_offset = args.offset;
+        } else {
+          cmd.indirect_args_buffer = buffer->buffer();
+          cmd.indirect_args_offset = AlignedByteOffsetForArgs + buffer_offset;
+        }
       });
     }
   }
 
+  /**
+  Backs NvAPI depth bounds test. Toggling it selects a pixel shader variant
+  that discards fragments whose stored depth is out of bounds, changing only
+  the bounds just rebinds them.
+  */
+  void
+  SetDepthBoundsTest(BOOL Enable, FLOAT MinDepth, FLOAT MaxDepth) {
+    std::lock_guard<mutex_t> lock(mutex);
+
+    Enable = !!Enable;
+    if (state_.OutputMerger.DepthBoundsTestEnable != Enable) {
+      state_.OutputMerger.DepthBoundsTestEnable = Enable;
+      InvalidateRenderPipeline();
+    }
+    state_.OutputMerger.DepthBoundsMin = MinDepth;
+    state_.OutputMerger.DepthBoundsMax = MaxDepth;
+    dirty_state.set(DirtyState::DepthBounds);
+  }
+
+  /**
+  Number of draws whose arguments lie within the args buffer, the draws past its end are dropped.
+  Computed in 64 bits, so that neither the offset nor the stride can wrap around.
+  */
+  UINT
+  ClampIndirectDrawCount(
+      ID3D11Buffer *pBufferForArgs, UINT DrawCount, UINT AlignedByteOffsetForArgs, UINT AlignedByteStrideForArgs,
+      UINT ArgumentsSize
+  ) {
+    if (!pBufferForArgs)
+      return 0;
+    D3D11_BUFFER_DESC desc;
+    pBufferForArgs->GetDesc(&desc);
+    uint64_t first_end = uint64_t(AlignedByteOffsetForArgs) + ArgumentsSize;
+    if (first_end > desc.ByteWidth)
+      return 0;
+    if (!AlignedByteStrideForArgs)
+      return DrawCount;
+    return std::min<uint64_t>(DrawCount, (desc.ByteWidth - first_end) / AlignedByteStrideForArgs + 1);
+  }
+
+  /**
+  Backs NvAPI multi-draw-indirect: the pipeline is validated once and all
+  draws are encoded in one command, instead of a full pass per draw
+  */
+  void
+  MultiDrawIndexedInstancedIndirect(
+      UINT DrawCount, ID3D11Buffer *pBufferForArgs, UINT AlignedByteOffsetForArgs, UINT AlignedByteStrideForArgs
+  ) {
+    std::lock_guard<mutex_t> lock(mutex);
+
+    DrawCount = ClampIndirectDrawCount(
+        pBufferForArgs, DrawCount, AlignedByteOffsetForArgs, AlignedByteStrideForArgs,
+        sizeof(DXMT_DRAW_INDEXED_ARGUMENTS)
+    );
+    if (unlikely(!DrawCount))
+      return;
+    WMTPrimitiveType Primitive;
+    uint32_t ControlPointCount;
+    if(!to_metal_primitive_type(state_.InputAssembler.Topology, Primitive, ControlPointCount))
+      return;
+    DrawCallStatus status = PreDraw<true>();
+    if (status == DrawCallStatus::Invalid)
+      return;
+    if (status == DrawCallStatus::Geometry || status == DrawCallStatus::Tessellation) {
+      // emulated pipelines marshal arguments per draw anyway
+      for (unsigned i = 0; i < DrawCount; i++) {
+        auto offset = AlignedByteOffsetForArgs + i * AlignedByteStrideForArgs;
+        if (status == DrawCallStatus::Geometry)
+          GeometryDrawIndexedIndirect(pBufferForArgs, offset);
+        else
+          TessellationDrawIndexedIndirect(ControlPointCount, pBufferForArgs, offset);
+      }
+      return;
+    }
+    auto bindable = GetResourceCommon(pBufferForArgs);
+    if (!bindable)
+      return;
+    UseBuffer(bindable->buffer());
+    for (unsigned i = 0; i < DrawCount; i++)
+      AdvanceSOFilledSize(pBufferForArgs, AlignedByteOffsetForArgs + i * AlignedByteStrideForArgs);
+    auto IndexType =
+        state_.InputAssembler.IndexBufferFormat == DXGI_FORMAT_R32_UINT ? WMTIndexTypeUInt32 : WMTIndexTypeUInt16;
+    auto IndexBufferOffset = state_.InputAssembler.IndexBufferOffset;
+    EmitOP([=, ArgBuffer = bindable->buffer()](ArgumentEncodingContext &enc) {
+      auto predication = enc.checkPredicate();
+      if (predication == Predication::Skip)
+        return;
+      auto [buffer, buffer_offset] = enc.access<PipelineStage::Vertex>(
+          ArgBuffer, AlignedByteOffsetForArgs,
+          AlignedByteStrideForArgs * (DrawCount - 1) + sizeof(DXMT_DRAW_INDEXED_ARGUMENTS), ResourceAccess::Read
+      );
+      enc.bumpVisibilityResultOffset();
+      auto [index_buffer, index_sub_offset] = enc.currentIndexBuffer();
+      enc.resolveRenderPassBarrier();
+      for (unsigned i = 0; i < DrawCount; i++) {
+        auto args_offset = buffer_offset + AlignedByteOffsetForArgs + i * AlignedByteStrideForArgs;
+        auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw_indexed_indirect>();
+        cmd.type = WMTRenderCommandDrawIndexedIndirect;
+        cmd.primitive_type = Primitive;
+        cmd.index_type = IndexType;
+        if (predication == Predication::Deferred) {
+          auto args = enc.encodePredicatedArguments(buffer->buffer(), buffer->gpuAddress() + args_offset, 5);
+          cmd.indirect_args_buffer = args.gpu_buffer;
+          cmd.indirect_args_offset = args.offset;
+        } else {
+          cmd.indirect_args_buffer = buffer->buffer();
+          cmd.indirect_args_offset = args_offset;
+        }
+        cmd.index_buffer = index_buffer;
+        cmd.index_buffer_offset = IndexBufferOffset + index_sub_offset;
+      }
+    });
+  }
+
+  void
+  MultiDrawInstancedIndirect(
+      UINT DrawCount, ID3D11Buffer *pBufferForArgs, UINT AlignedByteOffsetForArgs, UINT AlignedByteStrideForArgs
+  ) {
+    std::lock_guard<mutex_t> lock(mutex);
+
+    DrawCount = ClampIndirectDrawCount(
+        pBufferForArgs, DrawCount, AlignedByteOffsetForArgs, AlignedByteStrideForArgs, sizeof(DXMT_DRAW_ARGUMENTS)
+    );
+    if (unlikely(!DrawCount))
+      return;
+    WMTPrimitiveType Primitive;
+    uint32_t ControlPointCount;
+    if(!to_metal_primitive_type(state_.InputAssembler.Topology, Primitive, ControlPointCount))
+      return;
+    DrawCallStatus status = PreDraw<false>();
+    if (status == DrawCallStatus::Invalid)
+      return;
+    if (status == DrawCallStatus::Geometry || status == DrawCallStatus::Tessellation) {
+      for (unsigned i = 0; i < DrawCount; i++) {
+        auto offset = AlignedByteOffsetForArgs + i * AlignedByteStrideForArgs;
+        if (status == DrawCallStatus::Geometry)
+          GeometryDrawIndirect(pBufferForArgs, offset);
+        else
+          TessellationDrawIndirect(ControlPointCount, pBufferForArgs, offset);
+      }
+      return;
+    }
+    auto bindable = GetResourceCommon(pBufferForArgs);
+    if (!bindable)
+      return;
+    UseBuffer(bindable->buffer());
+    for (unsigned i = 0; i < DrawCount; i++)
+      AdvanceSOFilledSize(pBufferForArgs, AlignedByteOffsetForArgs + i * AlignedByteStrideForArgs);
+    EmitOP([=, ArgBuffer = bindable->buffer()](ArgumentEncodingContext &enc) {
+      auto predication = enc.checkPredicate();
+      if (predication == Predication::Skip)
+        return;
+      auto [buffer, buffer_offset] = enc.access<PipelineStage::Vertex>(
+          ArgBuffer, AlignedByteOffsetForArgs,
+          AlignedByteStrideForArgs * (DrawCount - 1) + sizeof(DXMT_DRAW_ARGUMENTS), ResourceAccess::Read
+      );
+      enc.bumpVisibilityResultOffset();
+      enc.resolveRenderPassBarrier();
+      for (unsigned i = 0; i < DrawCount; i++) {
+        auto args_offset = buffer_offset + AlignedByteOffsetForArgs + i * AlignedByteStrideForArgs;
+        auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw_indirect>();
+        cmd.type = WMTRenderCommandDrawIndirect;
+        cmd.primitive_type = Primitive;
+        if (predication == Predication::Deferred) {
+          auto args = enc.encodePredicatedArguments(buffer->buffer(), buffer->gpuAddress() + args_offset, 4);
+          cmd.indirect_args_buffer = args.gpu_buffer;
+          cmd.indirect_args_offset = args.offset;
+        } else {
+          cmd.indirect_args_buffer = buffer->buffer();
+          cmd.indirect_args_offset = args_offset;
+        }
+      }
+    });
+  }
+
   void
   GeometryDrawIndirect(
     ID3D11Buffer *pBufferForArgs, UINT AlignedByteOffsetForArgs
   ) {
     auto max_object_threadgroups = max_object_threadgroups_;
     if (auto bindable = GetResourceCommon(pBufferForArgs)) {
+      UseBuffer(bindable->buffer());
       EmitOP([=, topo = state_.InputAssembler.Topology, ArgBuffer = bindable->buffer()](ArgumentEncodingContext &enc) {
+        if (enc.checkPredicate(false) == Predication::Skip)
+          return;
         auto [buffer, buffer_offset] = enc.access<PipelineStage::Vertex>(
             ArgBuffer, AlignedByteOffsetForArgs, sizeof(DXMT_DRAW_ARGUMENTS), ResourceAccess::Read
         );
@@ -1682,7 +1967,10 @@ public:
     auto max_object_threadgroups = max_object_threadgroups_;
 
     if (auto bindable = GetResourceCommon(pBufferForArgs)) {
+      UseBuffer(bindable->buffer());
       EmitOP([=, topo = state_.InputAssembler.Topology, ArgBuffer = bindable->buffer()](ArgumentEncodingContext &enc) {
+        if (enc.checkPredicate(false) == Predication::Skip)
+          return;
         auto [buffer, buffer_offset] = enc.access<PipelineStage::Vertex>(
             ArgBuffer, AlignedByteOffsetForArgs, sizeof(DXMT_DRAW_INDEXED_ARGUMENTS), ResourceAccess::Read
         );
@@ -1717,7 +2005,10 @@ public:
   ) {
     auto max_object_threadgroups = max_object_threadgroups_;
     if (auto bindable = GetResourceCommon(pBufferForArgs)) {
+      UseBuffer(bindable->buffer());
       EmitOP([=, ArgBuffer = bindable->buffer()](ArgumentEncodingContext &enc) {
+        if (enc.checkPredicate(false) == Predication::Skip)
+          return;
         auto [buffer, buffer_offset] = enc.access<PipelineStage::Vertex>(
             ArgBuffer, AlignedByteOffsetForArgs, sizeof(DXMT_DRAW_ARGUMENTS), ResourceAccess::Read
         );
@@ -1754,7 +2045,10 @@ public:
     auto max_object_threadgroups = max_object_threadgroups_;
 
     if (auto bindable = GetResourceCommon(pBufferForArgs)) {
+      UseBuffer(bindable->buffer());
       EmitOP([=, ArgBuffer = bindable->buffer()](ArgumentEncodingContext &enc) {
+        if (enc.checkPredicate(false) == Predication::Skip)
+          return;
         auto [buffer, buffer_offset] = enc.access<PipelineStage::Vertex>(
             ArgBuffer, AlignedByteOffsetForArgs, sizeof(DXMT_DRAW_INDEXED_ARGUMENTS), ResourceAccess::Read
         );
@@ -1791,7 +2085,36 @@ public:
   DrawAuto() override {
     std::lock_guard<mutex_t> lock(mutex);
 
-    EmitST([](ArgumentEncodingContext &enc) { enc.setCompatibilityFlag(FeatureCompatibility::UnsupportedDrawAuto); });
+    WMTPrimitiveType Primitive;
+    uint32_t ControlPointCount;
+    if (!to_metal_primitive_type(state_.InputAssembler.Topology, Primitive, ControlPointCount))
+      return;
+    if (!state_.InputAssembler.VertexBuffers.test_bound(0))
+      return;
+    auto &vb0 = state_.InputAssembler.VertexBuffers[0];
+    if (!vb0.Stride)
+      return;
+    DrawCallStatus status = PreDraw<false>();
+    if (status == DrawCallStatus::Invalid)
+      return;
+    if (status != DrawCallStatus::Ordinary) {
+      EmitST([](ArgumentEncodingContext &enc) { enc.setCompatibilityFlag(FeatureCompatibility::UnsupportedDrawAuto); });
+      return;
+    }
+    // vertex count is derived from the filled size counter on GPU
+    EmitOP([Primitive, Source = vb0.Buffer->buffer(), Offset = vb0.Offset,
+            Stride = vb0.Stride](ArgumentEncodingContext &enc) {
+      if (enc.checkPredicate(false) == Predication::Skip)
+        return;
+      enc.bumpVisibilityResultOffset();
+      enc.resolveRenderPassBarrier();
+      auto args = enc.encodeDrawAutoArguments(Source, Offset, Stride);
+      auto &cmd = enc.encodeRenderCommand<wmtcmd_render_draw_indirect>();
+      cmd.type = WMTRenderCommandDrawIndirect;
+      cmd.primitive_type = Primitive;
+      cmd.indirect_args_buffer = args.gpu_buffer;
+      cmd.indirect_args_offset = args.offset;
+    });
   }
 
   void
@@ -1802,7 +2125,18 @@ public:
     if (!PreDispatch())
       return;
     EmitOP([ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ](ArgumentEncodingContext &enc) {
+      auto predication = enc.checkPredicate();
+      if (predication == Predication::Skip)
+        return;
       enc.resolveComputePassBarrier();
+      if (predication == Predication::Deferred) {
+        auto args = enc.encodePredicatedArguments({ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ}, 3);
+        auto &cmd = enc.encodeComputeCommand<wmtcmd_compute_dispatch_indirect>();
+        cmd.type = WMTComputeCommandDispatchIndirect;
+        cmd.indirect_args_buffer = args.gpu_buffer;
+        cmd.indirect_args_offset = args.offset;
+        return;
+      }
       auto &cmd = enc.encodeComputeCommand<wmtcmd_compute_dispatch>();
       cmd.type = WMTComputeCommandDispatch;
       cmd.size = {ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ};
@@ -1817,13 +2151,25 @@ public:
     if (!PreDispatch())
       return;
     if (auto bindable = GetResourceCommon(pBufferForArgs)) {
+      UseBuffer(bindable->buffer());
       EmitOP([AlignedByteOffsetForArgs, ArgBuffer = bindable->buffer()](ArgumentEncodingContext &enc) {
+        auto predication = enc.checkPredicate();
+        if (predication == Predication::Skip)
+          return;
         auto [buffer, buffer_offset] = enc.access(ArgBuffer, AlignedByteOffsetForArgs, 12, ResourceAccess::Read);
         enc.resolveComputePassBarrier();
         auto &cmd = enc.encodeComputeCommand<wmtcmd_compute_dispatch_indirect>();
         cmd.type = WMTComputeCommandDispatchIndirect;
-        cmd.indirect_args_buffer = buffer->buffer();;
-        cmd.indirect_args_offset = AlignedByteOffsetForArgs + buffer_offset;
+        if (predication == Predication::Deferred) {
+          auto args = enc.encodePredicatedArguments(
+              buffer->buffer(), buffer->gpuAddress() + buffer_offset + AlignedByteOffsetForArgs, 3
+          );
+          cmd.indirect_args_buffer = args.gpu_buffer;
+          cmd.indirect_args_offset = args.offset;
+        } else {
+          cmd.indirect_args_buffer = buffer->buffer();
+          cmd.indirect_args_offset = AlignedByteOffsetForArgs + buffer_offset;
+        }
       });
     }
   }
@@ -1855,8 +2201,46 @@ public:
     state_.predicate = pPredicate;
     state_.predicate_value = PredicateValue;
 
-    if (pPredicate)
-      EmitST([](ArgumentEncodingContext &enc) { enc.setCompatibilityFlag(FeatureCompatibility::UnsupportedPredication); });
+    EmitPredication();
+  }
+
+  /**
+  An occlusion predicate is evaluated on GPU at the beginning of the encoder
+  where it's used, so the current render pass is ended if the query ends in
+  it.
+  */
+  void
+  EmitPredication() {
+    if (!state_.predicate) {
+      EmitST([](ArgumentEncodingContext &enc) { enc.setPredicate(false); });
+      return;
+    }
+    D3D11_QUERY_DESC desc;
+    state_.predicate->GetDesc(&desc);
+    // only occlusion predicates are supported, and only on the immediate context: a query referenced by a
+    // deferred context may not be issued yet when the command list is recorded, so it's ignored there
+    if (desc.Query != D3D11_QUERY_OCCLUSION_PREDICATE || GetType() == D3D11_DEVICE_CONTEXT_DEFERRED) {
+      EmitST([](ArgumentEncodingContext &enc) {
+        enc.setPredicate(false);
+        enc.setCompatibilityFlag(FeatureCompatibility::UnsupportedPredication);
+      });
+      return;
+    }
+    uint64_t value, pass_id;
+    auto predicate = static_cast<MTLD3D11OcclusionQuery *>(static_cast<ID3D11Asynchronous *>(state_.predicate.ptr()));
+    auto query = predicate->Predicate(&value, &pass_id);
+    if (!query) {
+      EmitST([skip = bool(value) == bool(state_.predicate_value)](ArgumentEncodingContext &enc) {
+        enc.setPredicate(skip);
+      });
+      return;
+    }
+    if (pass_id == render_pass_id_ && cmdbuf_state >= CommandBufferState::RenderEncoderActive &&
+        cmdbuf_state <= CommandBufferState::GeometryRenderPipelineReady)
+      InvalidateCurrentPass();
+    EmitST([query = Rc(query), value = bool(state_.predicate_value)](ArgumentEncodingContext &enc) mutable {
+      enc.setPredicate(std::move(query), value);
+    });
   }
 
   //-----------------------------------------------------------------------------
@@ -1933,6 +2317,7 @@ public:
     auto pBuffer = GetResourceCommon(pIndexBuffer);
     if (pBuffer && (pBuffer->bindFlags() & D3D11_BIND_INDEX_BUFFER) && ValidateIAHazard(pBuffer)) {
       state_.InputAssembler.IndexBuffer = pBuffer;
+      UseBuffer(pBuffer->buffer());
       EmitST([buffer = state_.InputAssembler.IndexBuffer->buffer()](ArgumentEncodingContext &enc) mutable {
         enc.bindIndexBuffer(forward_rc(buffer));
       });
@@ -2239,6 +2624,7 @@ public:
         }
         entry.Buffer = pBuffer;
         entry.Offset = pOffsets ? pOffsets[slot] : 0;
+        UseBuffer(pBuffer->buffer());
         SOResolveSRVHazard(pBuffer);
         ResolveIAHazard(pBuffer);
         /**
@@ -2489,6 +2875,7 @@ public:
           continue;
         entry.View = pUAV;
         if (auto buffer = pUAV->buffer()) {
+          UseBuffer(buffer);
           EmitST([=, buffer = std::move(buffer), viewId = pUAV->viewId(), counter = pUAV->counter(),
                   slice = pUAV->bufferSlice()](ArgumentEncodingContext &enc) mutable {
             enc.bindOutputBuffer<PipelineStage::Compute>(Slot, forward_rc(buffer), viewId, forward_rc(counter), slice);
@@ -2860,6 +3247,7 @@ public:
             continue;
           entry.View = pUAV;
           if (auto buffer = pUAV->buffer()) {
+            UseBuffer(buffer);
             EmitST([=, buffer = std::move(buffer), viewId = pUAV->viewId(), counter = pUAV->counter(),
                     slice = pUAV->bufferSlice()](ArgumentEncodingContext &enc) mutable {
               enc.bindOutputBuffer<PipelineStage::Pixel>(Slot, forward_rc(buffer), viewId, forward_rc(counter), slice);
@@ -2993,6 +3381,11 @@ public:
     }
     state_.OutputMerger.StencilRef = StencilRef;
     dirty_state.set(DirtyState::DepthStencilState);
+    if (state_.OutputMerger.DepthBoundsTestEnable) {
+      // depth write mask decides whether the depth bounds variant is usable
+      InvalidateRenderPipeline();
+      dirty_state.set(DirtyState::DepthBounds);
+    }
   }
 
   void
@@ -3235,10 +3628,20 @@ public:
   std::tuple<WMT::Buffer, uint64_t> AllocateStagingBuffer(size_t size, size_t alignment);
   void UseCopyDestination(Rc<StagingResource> &);
   void UseCopySource(Rc<StagingResource> &);
+  void UseBuffer(const Rc<Buffer> &);
+  void UseBoundBuffers();
+  bool UpdateStagingInPlace(
+      Rc<StagingResource> &staging, UINT DstOffset, const void *pSrcData, UINT SrcRowPitch, UINT SrcDepthPitch,
+      UINT BytesPerRow, UINT Rows, UINT Depth
+  );
 
   std::pair<BufferAllocation *, uint32_t>
   GetDynamicBufferAllocation(Rc<DynamicBuffer> &dynamic);
 
+  void ElideInitialization(Texture *texture, TextureViewKey view, uint32_t planar);
+  void KeepInitialization(Texture *texture);
+  void UseBoundTextures(bool compute);
+
   uint64_t *allocated_encoder_argbuf_size_ = nullptr;
 
   uint64_t PreAllocateArgumentBuffer(size_t size, size_t alignment) {
@@ -3249,6 +3652,210 @@ public:
     return aligned;
   }
 
+  /**
+  Argument tables encoded in current encoder, looked up by the bound objects.
+  The key holds the layout, the pipeline kind and every bound object, its
+  hash only speeds up the comparison. Entries are only valid in the encoder
+  they were encoded in, and are dropped when a bound object may have been
+  freed, or when a resource they refer to may have been renamed.
+   */
+  struct ArgumentTableCache {
+    static constexpr unsigned kEntryCount = 8;
+    struct Entry {
+      uint64_t hash;
+      uint64_t offset;
+      /* a filter of the resources behind the bound objects, see ResourceFilterBit() */
+      uint64_t resources;
+      std::vector<uint64_t> key;
+    };
+    std::array<Entry, kEntryCount> entries;
+    unsigned count = 0;
+    unsigned next = 0;
+    /* the table currently bound to the stage, dirty bits are relative to it */
+    uint64_t active_offset = kArgumentTableNoBase;
+    const void *active_layout = nullptr;
+    PipelineKind active_kind = PipelineKind::Ordinary;
+
+    uint64_t
+    find(uint64_t hash, const std::vector<uint64_t> &key) const {
+      for (unsigned i = 0; i < count; i++) {
+        if (entries[i].hash == hash && entries[i].key == key)
+          return entries[i].offset;
+      }
+      return kArgumentTableNoBase;
+    }
+
+    void
+    insert(uint64_t hash, const std::vector<uint64_t> &key, uint64_t resources, uint64_t offset) {
+      auto &entry = entries[next];
+      entry.hash = hash;
+      entry.offset = offset;
+      entry.resources = resources;
+      entry.key.assign(key.begin(), key.end()); // reuses the storage of the evicted entry
+      next = (next + 1) % kEntryCount;
+      count = std::min(count + 1, kEntryCount);
+    }
+
+    void
+    drop(uint64_t resource_bit) {
+      for (unsigned i = 0; i < count;) {
+        if (entries[i].resources & resource_bit)
+          std::swap(entries[i], entries[--count]); // keeps the key storage
+        else
+          i++;
+      }
+      if (count < kEntryCount)
+        next = count;
+    }
+
+    uint64_t
+    base(const void *layout, PipelineKind kind) const {
+      return active_layout == layout && active_kind == kind ? active_offset : kArgumentTableNoBase;
+    }
+
+    void
+    activate(uint64_t offset, const void *layout, PipelineKind kind) {
+      active_offset = offset;
+      active_layout = layout;
+      active_kind = kind;
+    }
+  };
+
+  std::array<ArgumentTableCache, kStages * 2> argument_table_cache_;
+  uint64_t argument_table_epoch_ = 0;
+  std::vector<uint64_t> argument_table_key_;
+
+  uint64_t
+  ArgumentTableKeyHash() {
+    HashState hash;
+    for (auto value : argument_table_key_)
+      hash.add(value);
+    return hash;
+  }
+
+  void
+  ResetArgumentTableCache() {
+    // keeps the key storage of the entries
+    for (auto &cache : argument_table_cache_) {
+      cache.count = 0;
+      cache.next = 0;
+      cache.activate(kArgumentTableNoBase, nullptr, PipelineKind::Ordinary);
+    }
+  }
+
+  void
+  InvalidateArgumentTableCache() {
+    for (auto &cache : argument_table_cache_)
+      cache.count = 0;
+  }
+
+  static uint64_t
+  ResourceFilterBit(const D3D11ResourceCommon *resource) {
+    return 1ull << (((uint64_t)resource >> 4) * 0x9E3779B97F4A7C15ull >> 58);
+  }
+
+  /**
+  Whether \p pred holds for the buffer behind any bound slot (which can be
+  null for slots bound to textures)
+  */
+  template <typename Predicate>
+  bool
+  AnyBoundBuffer(Predicate &&pred) {
+    for (const auto &[slot, entry] : state_.InputAssembler.VertexBuffers) {
+      if (pred(entry.Buffer->buffer().ptr()))
+        return true;
+    }
+    if (state_.InputAssembler.IndexBuffer && pred(state_.InputAssembler.IndexBuffer->buffer().ptr()))
+      return true;
+    for (auto &ShaderStage : state_.ShaderStages) {
+      for (const auto &[slot, entry] : ShaderStage.ConstantBuffers) {
+        if (pred(entry.Buffer->buffer().ptr()))
+          return true;
+      }
+      for (const auto &[slot, entry] : ShaderStage.SRVs) {
+        if (pred(entry.SRV->buffer().ptr()))
+          return true;
+      }
+    }
+    for (const auto &[slot, entry] : state_.OutputMerger.UAVs) {
+      if (pred(entry.View->buffer().ptr()))
+        return true;
+    }
+    for (const auto &[slot, entry] : state_.ComputeStageUAV.UAVs) {
+      if (pred(entry.View->buffer().ptr()))
+        return true;
+    }
+    for (const auto &[slot, entry] : state_.StreamOutput.Targets) {
+      if (pred(entry.Buffer->buffer().ptr()))
+        return true;
+    }
+    return false;
+  }
+
+  /**
+  \p compute selects the textures accessed by a dispatch, otherwise those of a
+  draw. The texture pointer passed to \p pred may be null.
+  */
+  template <typename Predicate>
+  bool
+  AnyBoundTexture(bool compute, Predicate &&pred) {
+    if (compute) {
+      for (const auto &[slot, entry] : state_.ShaderStages[PipelineStage::Compute].SRVs) {
+        if (pred(entry.SRV->texture_))
+          return true;
+      }
+      for (const auto &[slot, entry] : state_.ComputeStageUAV.UAVs) {
+        if (pred(entry.View->texture_))
+          return true;
+      }
+      return false;
+    }
+    for (auto stage : {PipelineStage::Vertex, PipelineStage::Pixel, PipelineStage::Geometry, PipelineStage::Hull,
+                       PipelineStage::Domain}) {
+      for (const auto &[slot, entry] : state_.ShaderStages[stage].SRVs) {
+        if (pred(entry.SRV->texture_))
+          return true;
+      }
+    }
+    for (const auto &[slot, entry] : state_.OutputMerger.UAVs) {
+      if (pred(entry.View->texture_))
+        return true;
+    }
+    for (unsigned i = 0; i < state_.OutputMerger.NumRTVs; i++) {
+      if (state_.OutputMerger.RTVs[i] && pred(state_.OutputMerger.RTVs[i]->texture_))
+        return true;
+    }
+    if (state_.OutputMerger.DSV && pred(state_.OutputMerger.DSV->texture_))
+      return true;
+    return false;
+  }
+
+  /**
+  After a dynamic resource is renamed, only the slots it's bound to need their
+  argument entries re-encoded, and only the cached tables that may refer to it
+  are dropped.
+  */
+  void
+  DirtyRenamedResourceBindings(ID3D11Resource *pResource) {
+    auto resource = GetResourceCommon(pResource);
+    for (auto &cache : argument_table_cache_)
+      cache.drop(ResourceFilterBit(resource));
+    auto bind_flags = resource->bindFlags();
+    if (bind_flags & D3D11_BIND_VERTEX_BUFFER) {
+      state_.InputAssembler.VertexBuffers.set_dirty_if([=](auto &bound) { return bound.Buffer.ptr() == resource; });
+    }
+    if (bind_flags & D3D11_BIND_CONSTANT_BUFFER) {
+      for (auto &stage : state_.ShaderStages) {
+        stage.ConstantBuffers.set_dirty_if([=](auto &bound) { return bound.Buffer.ptr() == resource; });
+      }
+    }
+    if (bind_flags & D3D11_BIND_SHADER_RESOURCE) {
+      for (auto &stage : state_.ShaderStages) {
+        stage.SRVs.set_dirty_if([=](auto &bound) { return CheckOverlap(resource, bound.SRV.ptr()); });
+      }
+    }
+  }
+
   template <PipelineStage stage, PipelineKind kind>
   void
   UploadShaderStageResourceBinding() {
@@ -3268,21 +3875,91 @@ public:
     if (!dirty_cbuffer && !dirty_sampler && !dirty_srv && !uav_bound)
       return;
 
+    if (auto epoch = DeviceChildDestructionEpoch.load(std::memory_order_acquire); epoch != argument_table_epoch_) {
+      InvalidateArgumentTableCache();
+      argument_table_epoch_ = epoch;
+    }
+
     if (reflection->NumConstantBuffers && dirty_cbuffer) {
-      auto ConstantBufferCount = reflection->NumConstantBuffers;
-      auto offset = PreAllocateArgumentBuffer(ConstantBufferCount << 3, 32);
-      EmitST([=, cb = managed_shader->constant_buffers_info()](ArgumentEncodingContext &enc) {
-        enc.encodeConstantBuffers<stage, kind>(reflection, cb, offset);
-      });
+      auto &cache = argument_table_cache_[unsigned(stage) * 2];
+      auto cb = managed_shader->constant_buffers_info();
+      auto &key = argument_table_key_;
+      uint64_t resources = 0;
+      key.clear();
+      key.push_back((uint64_t)cb);
+      key.push_back((uint64_t)kind);
+      for (uint64_t mask = reflection->ConstantBufferSlotMask; mask; mask &= mask - 1) {
+        auto &entry = ShaderStage.ConstantBuffers.at(bit::tzcnt(mask));
+        key.push_back((uint64_t)entry.RawPointer);
+        key.push_back(uint64_t(entry.FirstConstant) << 32 | entry.NumConstants);
+        resources |= ResourceFilterBit(entry.Buffer.ptr());
+      }
+      auto hash = ArgumentTableKeyHash();
+      auto offset = cache.find(hash, key);
+      if (offset != kArgumentTableNoBase) {
+        EmitST([=](ArgumentEncodingContext &enc) {
+          enc.setArgumentTableOffset<stage, kind, true>(offset);
+          enc.currentFrameStatistics().argument_table_reused++;
+        });
+      } else {
+        ArgumentTableDirtyMask dirty_mask;
+        dirty_mask.constant_buffer = ShaderStage.ConstantBuffers.dirty_qword(0);
+        auto base_offset = cache.base(cb, kind);
+        offset = PreAllocateArgumentBuffer(reflection->NumConstantBuffers << 3, 32);
+        EmitST([=](ArgumentEncodingContext &enc) {
+          enc.encodeConstantBuffers<stage, kind>(reflection, cb, offset, base_offset, dirty_mask);
+        });
+        cache.insert(hash, key, resources, offset);
+      }
+      cache.activate(offset, cb, kind);
       ShaderStage.ConstantBuffers.clear_dirty();
     }
 
     if (reflection->NumArguments && (dirty_sampler || dirty_srv || uav_bound)) {
-      auto ArgumentTableQwords = reflection->ArgumentTableQwords;
-      auto offset = PreAllocateArgumentBuffer(ArgumentTableQwords << 3, 32);
-      EmitST([=, arg = managed_shader->arguments_info()](ArgumentEncodingContext &enc) {
-        enc.encodeShaderResources<stage, kind>(reflection, arg, offset);
-      });
+      auto &cache = argument_table_cache_[unsigned(stage) * 2 + 1];
+      auto arg = managed_shader->arguments_info();
+      auto &key = argument_table_key_;
+      uint64_t hash = 0;
+      uint64_t resources = 0;
+      uint64_t offset = kArgumentTableNoBase;
+      // UAV entries are always encoded (counters may be renamed), never reuse such tables
+      if (!uav_bound) {
+        auto push_srv = [&](const SRV_B &entry) {
+          key.push_back((uint64_t)entry.RawPointer);
+          if (entry.SRV)
+            resources |= ResourceFilterBit(entry.SRV->resource_.ptr());
+        };
+        key.clear();
+        key.push_back((uint64_t)arg);
+        key.push_back((uint64_t)kind);
+        for (uint64_t mask = reflection->SamplerSlotMask; mask; mask &= mask - 1)
+          key.push_back((uint64_t)ShaderStage.Samplers.at(bit::tzcnt(mask)).RawPointer);
+        for (uint64_t mask = reflection->SRVSlotMaskLo; mask; mask &= mask - 1)
+          push_srv(ShaderStage.SRVs.at(bit::tzcnt(mask)));
+        for (uint64_t mask = reflection->SRVSlotMaskHi; mask; mask &= mask - 1)
+          push_srv(ShaderStage.SRVs.at(64 + bit::tzcnt(mask)));
+        hash = ArgumentTableKeyHash();
+        offset = cache.find(hash, key);
+      }
+      if (offset != kArgumentTableNoBase) {
+        EmitST([=](ArgumentEncodingContext &enc) {
+          enc.setArgumentTableOffset<stage, kind, false>(offset);
+          enc.currentFrameStatistics().argument_table_reused++;
+        });
+      } else {
+        ArgumentTableDirtyMask dirty_mask;
+        dirty_mask.sampler = ShaderStage.Samplers.dirty_qword(0);
+        dirty_mask.srv_lo = ShaderStage.SRVs.dirty_qword(0);
+        dirty_mask.srv_hi = ShaderStage.SRVs.dirty_qword(1);
+        auto base_offset = cache.base(arg, kind);
+        offset = PreAllocateArgumentBuffer(reflection->ArgumentTableQwords << 3, 32);
+        EmitST([=](ArgumentEncodingContext &enc) {
+          enc.encodeShaderResources<stage, kind>(reflection, arg, offset, base_offset, dirty_mask);
+        });
+        if (!uav_bound)
+          cache.insert(hash, key, resources, offset);
+      }
+      cache.activate(offset, arg, kind);
       ShaderStage.Samplers.clear_dirty();
       ShaderStage.SRVs.clear_dirty();
       if (stage == PipelineStage::Pixel || stage == PipelineStage::Compute) {
@@ -3447,6 +4124,7 @@ public:
           entry.NumConstants = desc.ByteWidth >> 4;
         }
         entry.Buffer = GetResourceCommon(pConstantBuffer);
+        UseBuffer(entry.Buffer->buffer());
         EmitST([=, buffer = entry.Buffer->buffer(), offset = entry.FirstConstant << 4](ArgumentEncodingContext &enc
              ) mutable { enc.bindConstantBuffer<Stage>(slot, offset, forward_rc(buffer)); });
       } else {
@@ -3552,6 +4230,7 @@ public:
           continue;
         entry.SRV = pView;
         if (auto buffer = entry.SRV->buffer()) {
+          UseBuffer(buffer);
           EmitST([=, buffer = std::move(buffer), viewId = pView->viewId(),
                 slice = pView->bufferSlice()](ArgumentEncodingContext &enc) mutable {
             enc.bindBuffer<Stage>(slot, forward_rc(buffer), viewId, slice);
@@ -3725,6 +4404,7 @@ public:
           entry.Stride = 0;
         }
         entry.Buffer = pVertexBuffer;
+        UseBuffer(pVertexBuffer->buffer());
           EmitST([=, buffer = entry.Buffer->buffer(), offset = entry.Offset,
                 stride = entry.Stride](ArgumentEncodingContext &enc) mutable {
             enc.bindVertexBuffer(slot, offset, stride, forward_rc(buffer));
@@ -3810,6 +4490,7 @@ public:
         // copy from device to staging
         SwitchToBlitEncoder(CommandBufferState::ReadbackBlitEncoderActive);
         UseCopyDestination(staging_dst);
+        UseBuffer(src->buffer());
         EmitOP([src_ = src->buffer(), dst_ = std::move(staging_dst), DstX, SrcBox](ArgumentEncodingContext &enc) {
           auto [src, src_offset] = enc.access(src_, SrcBox.left, SrcBox.right - SrcBox.left, ResourceAccess::Read);
           auto [dst, dst_offset] = enc.access(dst_->buffer(), DstX, SrcBox.right - SrcBox.left, ResourceAccess::Write);
@@ -3829,6 +4510,7 @@ public:
       if (auto staging_src = GetStagingResource(pSrcResource, SrcSubresource)) {
         SwitchToBlitEncoder(CommandBufferState::UpdateBlitEncoderActive);
         UseCopySource(staging_src);
+        UseBuffer(dst->buffer());
         EmitOP([dst_ = dst->buffer(), src_ = std::move(staging_src), DstX, SrcBox](ArgumentEncodingContext &enc) {
           auto [src, src_offset] = enc.access(src_->buffer(), SrcBox.left, SrcBox.right - SrcBox.left, ResourceAccess::Read);
           auto [dst, dst_offset] = enc.access(dst_, DstX, SrcBox.right - SrcBox.left, ResourceAccess::Write);
@@ -3843,6 +4525,8 @@ public:
       } else if (auto src = GetResourceCommon(pSrcResource)) {
         // on-device copy
         SwitchToBlitEncoder(CommandBufferState::BlitEncoderActive);
+        UseBuffer(dst->buffer());
+        UseBuffer(src->buffer());
         EmitOP([dst_ = dst->buffer(), src_ = src->buffer(), DstX,
                                SrcBox](ArgumentEncodingContext& enc) {
           auto [src, src_offset] = enc.access(src_, SrcBox.left, SrcBox.right - SrcBox.left, ResourceAccess::Read);
@@ -3867,6 +4551,7 @@ public:
   CopyTexture(TextureCopyCommand &&cmd) {
     if (cmd.Invalid)
       return;
+    KeepInitialization(GetTexture(cmd.pSrc).ptr());
     if ((cmd.SrcFormat.Flag & MTL_DXGI_FORMAT_BC) != (cmd.DstFormat.Flag & MTL_DXGI_FORMAT_BC)) {
       if (cmd.SrcFormat.Flag & MTL_DXGI_FORMAT_BC) {
         return CopyTextureFromCompressed(std::move(cmd));
@@ -4207,13 +4892,64 @@ public:
         cmd_cptex.origin = cmd.DstOrigin;
       });
     } else if (auto staging_dst = GetStagingResource(cmd.pDst, cmd.DstSubresource)) {
-      // staging: ...
-      UNIMPLEMENTED("update texture: staging");
+      auto dst_offset = GetStagingOffset(
+          cmd.DstOrigin.x, cmd.DstOrigin.y, cmd.DstOrigin.z, cmd.DstFormat.BytesPerTexel,
+          cmd.DstFormat.Flag & MTL_DXGI_FORMAT_BC, staging_dst->bytesPerRow, staging_dst->bytesPerImage
+      );
+      UpdateStaging(
+          staging_dst, dst_offset, pSrcData, SrcRowPitch, SrcDepthPitch, cmd.EffectiveBytesPerRow, cmd.EffectiveRows,
+          cmd.DstSize.depth
+      );
     } else {
       UNREACHABLE
     }
   }
 
+  /**
+  Writes rows of data to a staging resource, starting at DstOffset in its linear layout.
+  Written by the CPU if the staging resource isn't in use by the GPU (immediate context only),
+  otherwise copied on the GPU after the pending accesses, without flushing.
+  */
+  void
+  UpdateStaging(
+      Rc<StagingResource> &staging, UINT DstOffset, const void *pSrcData, UINT SrcRowPitch, UINT SrcDepthPitch,
+      UINT BytesPerRow, UINT Rows, UINT Depth
+  ) {
+    if (UpdateStagingInPlace(staging, DstOffset, pSrcData, SrcRowPitch, SrcDepthPitch, BytesPerRow, Rows, Depth))
+      return;
+
+    auto bytes_per_image = BytesPerRow * Rows;
+    auto [upload_buffer, upload_offset] = AllocateStagingBuffer(bytes_per_image * Depth, 16);
+    for (unsigned image = 0; image < Depth; image++) {
+      for (unsigned row = 0; row < Rows; row++) {
+        const char *src = ((const char *)pSrcData) + row * SrcRowPitch + image * SrcDepthPitch;
+        upload_buffer.updateContents(upload_offset + image * bytes_per_image + row * BytesPerRow, src, BytesPerRow);
+      }
+    }
+    SwitchToBlitEncoder(CommandBufferState::BlitEncoderActive);
+    UseCopyDestination(staging);
+    EmitOP([upload_buffer, upload_offset, dst_ = staging, DstOffset, BytesPerRow, Rows, Depth,
+            bytes_per_image](ArgumentEncodingContext &enc) {
+      auto [dst, dst_offset] = enc.access(dst_->buffer(), DstOffset, dst_->length - DstOffset, ResourceAccess::Write);
+      // one copy per slice if the rows are contiguous in both layouts
+      bool packed = BytesPerRow == dst_->bytesPerRow;
+      for (unsigned image = 0; image < Depth; image++) {
+        for (unsigned row = 0; row < Rows; row++) {
+          auto &cmd = enc.encodeBlitCommand<wmtcmd_blit_copy_from_buffer_to_buffer>();
+          cmd.type = WMTBlitCommandCopyFromBufferToBuffer;
+          cmd.copy_length = packed ? bytes_per_image : BytesPerRow;
+          cmd.src = upload_buffer;
+          cmd.src_offset = upload_offset + image * bytes_per_image + row * BytesPerRow;
+          cmd.dst = dst->buffer();
+          cmd.dst_offset = dst_offset + DstOffset + image * dst_->bytesPerImage + row * dst_->bytesPerRow;
+          if (packed)
+            break;
+        }
+      }
+    });
+    promote_flush = true;
+  }
+
   void
   UpdateTexture(
       TextureUpdateCommand &&cmd, Rc<Buffer> &&src, UINT SrcRowPitch, UINT SrcDepthPitch
@@ -4304,6 +5040,93 @@ public:
     return false;
   }
 
+  /**
+  The depth bounds variant tests against a copy of the bound DSV, which is only
+  accurate as long as the draw doesn't write depth. Otherwise the test is
+  skipped.
+  */
+  bool
+  DepthBoundsTestApplicable() {
+    if (!state_.OutputMerger.DepthBoundsTestEnable || !state_.OutputMerger.DSV)
+      return false;
+    IMTLD3D11DepthStencilState *state =
+        state_.OutputMerger.DepthStencilState ? state_.OutputMerger.DepthStencilState : default_depth_stencil_state;
+    return !state->IsDepthWriteEnabled();
+  }
+
+  /**
+  Metal can't read a depth attachment within its own render pass (there is no
+  framebuffer fetch for depth), so the DSV is copied before the render pass that
+  tests against it begins. The copy stays valid until a draw of the same pass
+  writes depth, in which case the pass is ended and the DSV copied again.
+  */
+  void
+  UpdateDepthBoundsSnapshot() {
+    auto &dsv = state_.OutputMerger.DSV;
+    if (!state_.OutputMerger.DepthBoundsTestEnable || !dsv)
+      return;
+    if (!DepthBoundsTestApplicable()) {
+      depth_bounds_snapshot_pass_id_ = ~0ull;
+      return;
+    }
+    bool in_render_pass = cmdbuf_state >= CommandBufferState::RenderEncoderActive &&
+                          cmdbuf_state <= CommandBufferState::GeometryRenderPipelineReady;
+    if (in_render_pass && depth_bounds_snapshot_pass_id_ == render_pass_id_)
+      return;
+
+    auto texture = dsv->texture();
+    TextureViewKey view = dsv->viewId();
+    unsigned width = texture->width(view), height = texture->height(view);
+    unsigned array_length = texture->arrayLength(view), sample_count = texture->sampleCount();
+    auto &snapshot = depth_bounds_snapshot_;
+    if (!snapshot || snapshot->pixelFormat() != texture->pixelFormat() || snapshot->width() != width ||
+        snapshot->height() != height || snapshot->arrayLength() != array_length ||
+        snapshot->sampleCount() != sample_count) {
+      WMTTextureInfo info;
+      info.width = width;
+      info.height = height;
+      info.depth = 1;
+      info.array_length = array_length;
+      info.mipmap_level_count = 1;
+      info.pixel_format = texture->pixelFormat();
+      info.sample_count = sample_count;
+      if (sample_count > 1)
+        info.type = array_length > 1 ? WMTTextureType2DMultisampleArray : WMTTextureType2DMultisample;
+      else
+        info.type = array_length > 1 ? WMTTextureType2DArray : WMTTextureType2D;
+      info.usage = WMTTextureUsageShaderRead;
+      info.options = WMTResourceStorageModePrivate;
+      snapshot = new Texture(info, device->GetMTLDevice());
+      Flags<TextureAllocationFlag> flags;
+      flags.set(TextureAllocationFlag::GpuPrivate);
+      snapshot->rename(snapshot->allocate(flags));
+    }
+
+    SwitchToBlitEncoder(CommandBufferState::BlitEncoderActive);
+    EmitOP([src_ = std::move(texture), dst_ = snapshot, level = (uint32_t)view.mip_start,
+            first_slice = (uint32_t)view.array_start, array_length, width,
+            height](ArgumentEncodingContext &enc) {
+      for (uint32_t i = 0; i < array_length; i++) {
+        auto src = enc.access(src_, level, first_slice + i, ResourceAccess::Read);
+        auto dst = enc.access(dst_, 0, i, ResourceAccess::Write);
+        auto &cmd = enc.encodeBlitCommand<wmtcmd_blit_copy_from_texture_to_texture>();
+        cmd.type = WMTBlitCommandCopyFromTextureToTexture;
+        cmd.src = src;
+        cmd.src_slice = first_slice + i;
+        cmd.src_level = level;
+        cmd.src_origin = {0, 0, 0};
+        cmd.src_size = {width, height, 1};
+        cmd.dst = dst;
+        cmd.dst_slice = i;
+        cmd.dst_level = 0;
+        cmd.dst_origin = {0, 0, 0};
+      }
+    });
+    // the render pass of this draw begins right after
+    depth_bounds_snapshot_pass_id_ = render_pass_id_ + 1;
+    dirty_state.set(DirtyState::DepthBounds);
+  }
+
   /**
   Render pipeline can be invalidate by reasons:
   - shader program changes
@@ -4340,6 +5163,7 @@ public:
     InvalidateCurrentPass();
     auto clear_color = WMTClearColor{ColorRGBA[0], ColorRGBA[1], ColorRGBA[2], ColorRGBA[3]};
     auto &props = pRenderTargetView->description();
+    ElideInitialization(pRenderTargetView->texture().ptr(), pRenderTargetView->viewId(), 0);
 
     EmitOP([texture = pRenderTargetView->texture(), view = pRenderTargetView->viewId(),
           clear_color = std::move(clear_color), array_length = props.RenderTargetArrayLength](ArgumentEncodingContext &enc) mutable {
@@ -4353,6 +5177,7 @@ public:
       return;
     InvalidateCurrentPass();
     auto &props = pDepthStencilView->description();
+    ElideInitialization(pDepthStencilView->texture().ptr(), pDepthStencilView->viewId(), ClearFlags & 0b11);
 
     EmitOP([texture = pDepthStencilView->texture(), view = pDepthStencilView->viewId(),
           renamable = pDepthStencilView->renamable(), array_length = props.RenderTargetArrayLength,
@@ -4399,7 +5224,7 @@ public:
     state_.OutputMerger.UAVs.set_dirty();
     dirty_state.set(
         DirtyState::BlendFactorAndStencilRef, DirtyState::RasterizerState, DirtyState::DepthStencilState,
-        DirtyState::Viewport, DirtyState::Scissors
+        DirtyState::Viewport, DirtyState::Scissors, DirtyState::DepthBounds
     );
 
     // should assume: render target is properly set
@@ -4466,6 +5291,7 @@ public:
 
       auto allocated_encoder_argbuf_size = std::make_unique<uint64_t>(0);
       allocated_encoder_argbuf_size_ = allocated_encoder_argbuf_size.get();
+      ResetArgumentTableCache();
 
       EmitST([rtvs = std::move(rtvs), dsv = std::move(dsv_info), effective_render_target, uav_only,
             render_target_height, render_target_width, sample_count,
@@ -4518,6 +5344,7 @@ public:
 
     cmdbuf_state = CommandBufferState::RenderEncoderActive;
     previous_render_pipeline_state = cmdbuf_state;
+    render_pass_id_++;
     return true;
   }
 
@@ -4558,6 +5385,7 @@ public:
 
     auto allocated_encoder_argbuf_size = std::make_unique<uint64_t>(0);
     allocated_encoder_argbuf_size_ = allocated_encoder_argbuf_size.get();
+    ResetArgumentTableCache();
 
     EmitST([encoder_argbuf_size = std::move(allocated_encoder_argbuf_size)](
                ArgumentEncodingContext &enc) {
@@ -4619,6 +5447,8 @@ public:
     if (!Desc.RasterizationEnabled)
       Desc.PixelShader = nullptr; // Even rasterization is disabled, Metal still checks if VS-PS signatures match.
     Desc.SampleMask = state_.OutputMerger.SampleMask;
+    Desc.DepthBoundsTest = Desc.PixelShader && DepthBoundsTestApplicable();
+    Desc.DepthBoundsTestArray = Desc.DepthBoundsTest && depth_bounds_snapshot_->arrayLength() > 1;
     Desc.GSPassthrough = GS ? GS->reflection().GeometryShader.GSPassThrough : ~0u;
     if (unlikely(Desc.GSPassthrough == ~0u && Desc.GeometryShader != nullptr)) {
       Desc.GSStripTopology = is_strip_topology(state_.InputAssembler.Topology);
@@ -4820,9 +5650,12 @@ public:
       if (!state_.InputAssembler.IndexBuffer)
         return DrawCallStatus::Invalid;
     }
+    UpdateDepthBoundsSnapshot();
     if (status = FinalizeCurrentRenderPipeline<IndexedDraw>(); status == DrawCallStatus::Invalid) {
       return status;
     }
+    UseBoundBuffers();
+    UseBoundTextures(false);
     UpdateVertexBuffer();
     UpdateSOTargets();
     if (dirty_state.any(DirtyState::DepthStencilState)) {
@@ -4858,6 +5691,23 @@ public:
         cmd.stencil_ref = stencil_ref;
       });
     }
+    if (dirty_state.any(DirtyState::DepthBounds) && DepthBoundsTestApplicable()) {
+      EmitST([texture = depth_bounds_snapshot_, min = state_.OutputMerger.DepthBoundsMin,
+              max = state_.OutputMerger.DepthBoundsMax](ArgumentEncodingContext &enc) {
+        auto &settex = enc.encodeRenderCommand<wmtcmd_render_settexture>();
+        settex.type = WMTRenderCommandSetFragmentTexture;
+        settex.texture = enc.access<PipelineStage::Pixel>(texture, texture->fullView, ResourceAccess::Read).texture;
+        settex.index = 30;
+        auto &setbounds = enc.encodeRenderCommand<wmtcmd_render_setbytes>();
+        setbounds.type = WMTRenderCommandSetFragmentBytes;
+        float *bounds = (float *)enc.allocate_cpu_heap(sizeof(float) * 2, 16);
+        bounds[0] = min;
+        bounds[1] = max;
+        setbounds.bytes.set(bounds);
+        setbounds.length = sizeof(float) * 2;
+        setbounds.index = 27;
+      });
+    }
     IMTLD3D11RasterizerState *current_rs =
         state_.Rasterizer.RasterizerState ? state_.Rasterizer.RasterizerState : default_rasterizer_state;
     bool allow_scissor = current_rs->IsScissorEnabled();
@@ -4968,6 +5818,8 @@ public:
     if (!FinalizeCurrentComputePipeline()) {
       return false;
     }
+    UseBoundBuffers();
+    UseBoundTextures(true);
     UploadShaderStageResourceBinding<PipelineStage::Compute, PipelineKind::Ordinary>();
     return true;
   }
@@ -5007,6 +5859,7 @@ public:
           cmd.offset = offset + buffer_offset;
           cmd.index = 20;
           enc.makeResident<PipelineStage::Vertex, PipelineKind::Ordinary>(slot0.ptr(), false, true);
+          enc.resetStreamOutputFilledSize(slot0, offset);
         });
       }
     } else {
@@ -5026,6 +5879,69 @@ public:
     }
   }
 
+  /**
+  Returns the stride of stream output slot 0, or 0 if stream output is not
+  active. Only slot 0 is written (see UpdateSOTargets)
+  */
+  UINT
+  StreamOutputStride() {
+    if (likely(!state_.StreamOutput.Targets.test_bound(0)))
+      return 0;
+    auto so_layout = com_cast<IMTLD3D11StreamOutputLayout>(state_.ShaderStages[PipelineStage::Geometry].Shader.ptr());
+    if (!so_layout)
+      return 0;
+    MTL_SHADER_STREAM_OUTPUT_ELEMENT_DESC *elements;
+    uint32_t strides[4];
+    so_layout->GetStreamOutputElements(&elements, strides);
+    return strides[0];
+  }
+
+  /**
+  Advances filled size of stream output slot 0 by the following draw. It's
+  predicated the same way as the draw, so a skipped draw doesn't advance it.
+  */
+  void
+  AdvanceSOFilledSize(UINT VertexCountPerInstance, UINT InstanceCount) {
+    if (auto stride = StreamOutputStride()) {
+      EmitST([=, slot0 = state_.StreamOutput.Targets[0].Buffer->buffer()](ArgumentEncodingContext &enc) {
+        auto predication = enc.checkPredicate();
+        if (predication == Predication::Skip)
+          return;
+        if (predication == Predication::Deferred) {
+          auto args = enc.encodePredicatedArguments({VertexCountPerInstance, InstanceCount}, 2);
+          enc.advanceStreamOutputFilledSize(slot0, stride, args.gpu_buffer, args.gpu_address + args.offset);
+          return;
+        }
+        uint64_t VertexCount = uint64_t(VertexCountPerInstance) * InstanceCount;
+        enc.advanceStreamOutputFilledSize(slot0, stride, std::min<uint64_t>(VertexCount, UINT32_MAX));
+      });
+    }
+  }
+
+  void
+  AdvanceSOFilledSize(ID3D11Buffer *pBufferForArgs, UINT AlignedByteOffsetForArgs) {
+    auto bindable = GetResourceCommon(pBufferForArgs);
+    if (!bindable)
+      return;
+    if (auto stride = StreamOutputStride()) {
+      EmitST([=, slot0 = state_.StreamOutput.Targets[0].Buffer->buffer(),
+              ArgBuffer = bindable->buffer()](ArgumentEncodingContext &enc) {
+        auto predication = enc.checkPredicate();
+        if (predication == Predication::Skip)
+          return;
+        auto [buffer, buffer_offset] =
+            enc.access<PipelineStage::Vertex>(ArgBuffer, AlignedByteOffsetForArgs, 8, ResourceAccess::Read);
+        auto arguments_va = buffer->gpuAddress() + buffer_offset + AlignedByteOffsetForArgs;
+        if (predication == Predication::Deferred) {
+          auto args = enc.encodePredicatedArguments(buffer->buffer(), arguments_va, 2);
+          enc.advanceStreamOutputFilledSize(slot0, stride, args.gpu_buffer, args.gpu_address + args.offset);
+          return;
+        }
+        enc.advanceStreamOutputFilledSize(slot0, stride, buffer->buffer(), arguments_va);
+      });
+    }
+  }
+
   template <PipelineStage Stage>
   void RestoreEncodingContextStageState() {
       auto &ShaderStage = state_.ShaderStages[Stage];
@@ -5103,6 +6019,9 @@ public:
         });
       }
     }
+
+    if (state_.predicate)
+      EmitPredication();
   }
 
   void ResetEncodingContextState() {
@@ -5121,6 +6040,16 @@ protected:
   MTLD3D11Device *device;
   CommandBufferState cmdbuf_state = CommandBufferState::Idle;
   CommandBufferState previous_render_pipeline_state = CommandBufferState::Idle;
+  /**
+  Incremented when a render pass begins
+  */
+  uint64_t render_pass_id_ = 0;
+  /**
+  Copy of the bound DSV for depth bounds test, valid within the render pass
+  `depth_bounds_snapshot_pass_id_`
+  */
+  Rc<Texture> depth_bounds_snapshot_;
+  uint64_t depth_bounds_snapshot_pass_id_ = ~0ull;
   ContextInternalState &ctx_state;
   ContextInternalState::device_mutex_t &mutex;
 
@@ -5135,6 +6064,7 @@ public:
     BlendFactorAndStencilRef,
     Viewport,
     Scissors,
+    DepthBounds,
   };
 
   Flags<DirtyState> dirty_state = 0;
@@ -5171,7 +6101,7 @@ public:
 };
 
 template <typename ContextInternalState>
-class MTLD3D11ContextExt : public IMTLD3D11ContextExt1 {
+class MTLD3D11ContextExt : public IMTLD3D11ContextExt2 {
   class CachedTemporalScaler {
   public:
     WMTPixelFormat color_pixel_format;
@@ -5387,6 +6317,27 @@ public:
     return E_INVALIDARG;
   };
 
+  void STDMETHODCALLTYPE
+  MultiDrawInstancedIndirect(
+      UINT DrawCount, ID3D11Buffer *pBufferForArgs, UINT AlignedByteOffsetForArgs, UINT AlignedByteStrideForArgs
+  ) final {
+    ctx_->MultiDrawInstancedIndirect(DrawCount, pBufferForArgs, AlignedByteOffsetForArgs, AlignedByteStrideForArgs);
+  }
+
+  void STDMETHODCALLTYPE
+  MultiDrawIndexedInstancedIndirect(
+      UINT DrawCount, ID3D11Buffer *pBufferForArgs, UINT AlignedByteOffsetForArgs, UINT AlignedByteStrideForArgs
+  ) final {
+    ctx_->MultiDrawIndexedInstancedIndirect(
+        DrawCount, pBufferForArgs, AlignedByteOffsetForArgs, AlignedByteStrideForArgs
+    );
+  }
+
+  void STDMETHODCALLTYPE
+  SetDepthBoundsTest(BOOL Enable, FLOAT MinDepth, FLOAT MaxDepth) final {
+    ctx_->SetDepthBoundsTest(Enable, MinDepth, MaxDepth);
+  }
+
 private:
 
   MTLD3D11DeviceContextImplBase<ContextInternalState> *ctx_;
@@ -122,6 +122,10 @@ struct D3D11OutputMergerStageState {
 
   UINT SampleMask = 0xffffffff;
 
+  BOOL DepthBoundsTestEnable = FALSE;
+  FLOAT DepthBoundsMin = 0.0f;
+  FLOAT DepthBoundsMax = 1.0f;
+
   // state derived from valid RTV/DSV
   UINT SampleCount = 1;
   UINT ArrayLength = 0;
@@ -965,7 +965,7 @@ public:
     case D3D11_QUERY_TIMESTAMP:
       return CreateTimestampQuery(this, pQueryDesc, ppQuery);
     case D3D11_QUERY_TIMESTAMP_DISJOINT: {
-      *ppQuery = ref(new MTLD3D11EventQueryImpl<D3D11_QUERY_DATA_TIMESTAMP_DISJOINT>(this, pQueryDesc));
+      *ppQuery = ref(new MTLD3D11TimestampDisjointQuery(this, pQueryDesc));
       return S_OK;
     }
     case D3D11_QUERY_PIPELINE_STATISTICS: {
@@ -1041,6 +1041,11 @@ public:
     return S_OK;
   };
 
+  void
+  PromotePipelineWork(ThreadpoolWork *pWork) override {
+    pipeline_cache_->PromoteWork(pWork);
+  };
+
   Device &GetDXMTDevice() override { return device_; };
 
   void CreateCommandList(ID3D11CommandList** pCommandList) final {
@@ -1137,6 +1142,8 @@ public:
       else
         local_kmt_ = create.hDevice;
     }
+    // the adapter outlives the queue, which is destroyed along with the device
+    cmd_queue_.SetMemoryBudgetListener([adapter = adapter_.ptr()]() { adapter->NotifyVideoMemoryBudgetChange(); });
   }
 
   ~MTLD3D11DXGIDevice() {
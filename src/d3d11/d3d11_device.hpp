@@ -26,6 +26,7 @@ class MTLCompiledGraphicsPipeline;
 class MTLCompiledComputePipeline;
 class MTLCompiledGeometryPipeline;
 class MTLCompiledTessellationMeshPipeline;
+class ThreadpoolWork;
 
 class MTLD3D11Device : public ID3D11Device5 {
 public:
@@ -50,6 +51,11 @@ public:
                                              MTLCompiledTessellationMeshPipeline *
                                                  *ppPipeline) = 0;
 
+  /**
+  Called before blocking on a compilation task, so it runs ahead of others
+   */
+  virtual void PromotePipelineWork(ThreadpoolWork *pWork) = 0;
+
   virtual bool IsTraced() = 0;
 
   virtual Device& GetDXMTDevice() = 0;
@@ -74,6 +74,12 @@ Speaking of multi-threading:
 
 */
 
+/**
+Bumped whenever a device child is destroyed, so that caches keyed
+on object addresses can tell an address might have been reused
+ */
+inline std::atomic<uint64_t> DeviceChildDestructionEpoch = {0};
+
 template <typename... Base>
 class MTLD3D11DeviceChild : public MTLD3D11DeviceObject<ComObject<Base...>> {
 
@@ -81,7 +87,9 @@ public:
   MTLD3D11DeviceChild(MTLD3D11Device *pDevice)
       : MTLD3D11DeviceObject<ComObject<Base...>>(pDevice) {}
 
-  virtual ~MTLD3D11DeviceChild() {};
+  virtual ~MTLD3D11DeviceChild() {
+    DeviceChildDestructionEpoch.fetch_add(1, std::memory_order_release);
+  };
 };
 
 /**
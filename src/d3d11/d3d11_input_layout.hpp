@@ -79,8 +79,7 @@ template <> struct hash<MTL_INPUT_LAYOUT_DESC> {
   size_t operator()(const MTL_INPUT_LAYOUT_DESC &v) const noexcept {
     dxmt::HashState state;
     for (auto &element : v) {
-      state.add(std::hash<string_view>{}(
-          {reinterpret_cast<const char *>(&element), sizeof(element)}));
+      state.add(dxmt::HashBytes(&element, sizeof(element)));
     }
     return state;
   };
@@ -107,8 +106,7 @@ template <> struct hash<MTL_STREAM_OUTPUT_DESC> {
     state.add(v.Strides[2]);
     state.add(v.Strides[3]);
     for (auto &element : v.Elements) {
-      state.add(std::hash<string_view>{}(
-          {reinterpret_cast<const char *>(&element), sizeof(element)}));
+      state.add(dxmt::HashBytes(&element, sizeof(element)));
     }
     return state;
   };
@@ -39,6 +39,16 @@ DEFINE_COM_INTERFACE("19a8e35a-38be-418f-94e3-9f7323936870", IMTLD3D11ContextExt
   ) = 0;
 };
 
+DEFINE_COM_INTERFACE("6f1c3a2e-8d47-4b5e-9c0a-52e4d7b9a813", IMTLD3D11ContextExt2) : public IMTLD3D11ContextExt1 {
+  virtual void STDMETHODCALLTYPE MultiDrawInstancedIndirect(
+      UINT DrawCount, ID3D11Buffer *pBufferForArgs, UINT AlignedByteOffsetForArgs, UINT AlignedByteStrideForArgs
+  ) = 0;
+  virtual void STDMETHODCALLTYPE MultiDrawIndexedInstancedIndirect(
+      UINT DrawCount, ID3D11Buffer *pBufferForArgs, UINT AlignedByteOffsetForArgs, UINT AlignedByteStrideForArgs
+  ) = 0;
+  virtual void STDMETHODCALLTYPE SetDepthBoundsTest(BOOL Enable, FLOAT MinDepth, FLOAT MaxDepth) = 0;
+};
+
 DEFINE_COM_INTERFACE("efc77ae6-2179-4c0a-b844-7661ca0dcde7", IMTLD3D11DeviceExt)
     : public IUnknown {
   virtual void STDMETHODCALLTYPE SetShaderExtensionSlot(UINT Slot) = 0;
@@ -3,6 +3,7 @@
 #include "d3d11_pipeline.hpp"
 #include "d3d11_device.hpp"
 #include "d3d11_shader.hpp"
+#include "dxmt_trace.hpp"
 #include "log/log.hpp"
 #include <atomic>
 
@@ -38,7 +39,8 @@ public:
       PixelShader = pDesc->PixelShader->get_shader(ShaderVariantPixel{
           pDesc->SampleMask, pDesc->BlendState->IsDualSourceBlending(),
           depth_stencil_format == WMTPixelFormatInvalid,
-          unorm_output_reg_mask});
+          unorm_output_reg_mask, pDesc->DepthBoundsTest ? pDesc->SampleCount : 0u,
+          pDesc->DepthBoundsTest && pDesc->DepthBoundsTestArray});
       ps_valid_render_targets = pDesc->PixelShader->reflection().PSValidRenderTargets;
     } else {
       PixelShader = nullptr;
@@ -47,7 +49,11 @@ public:
   }
 
   void GetPipeline(MTL_COMPILED_GRAPHICS_PIPELINE *pPipeline) final {
-    ready_.wait(false, std::memory_order_acquire);
+    DXMT_TRACE_SCOPE("GetPipeline::wait");
+    if (!ready_.load(std::memory_order_acquire)) {
+      device_->PromotePipelineWork(this);
+      ready_.wait(false, std::memory_order_acquire);
+    }
     *pPipeline = {state_};
   }
 
@@ -96,7 +102,10 @@ public:
     info.immutable_vertex_buffers = (1 << 16) | (1 << 29) | (1 << 30);
     info.immutable_fragment_buffers = (1 << 29) | (1 << 30);
 
-    state_ = device_->GetMTLDevice().newRenderPipelineState(info, err);
+    {
+      DXMT_TRACE_SCOPE("newRenderPipelineState");
+      state_ = device_->GetMTLDevice().newRenderPipelineState(info, err);
+    }
 
     if (state_ == nullptr) {
       ERR("Failed to create PSO: ", err.description().getUTF8String());
@@ -151,7 +160,11 @@ public:
   }
 
   void GetPipeline(MTL_COMPILED_COMPUTE_PIPELINE *pPipeline) final {
-    ready_.wait(false, std::memory_order_acquire);
+    DXMT_TRACE_SCOPE("GetPipeline::wait");
+    if (!ready_.load(std::memory_order_acquire)) {
+      device_->PromotePipelineWork(this);
+      ready_.wait(false, std::memory_order_acquire);
+    }
     *pPipeline = {state_};
   }
 
@@ -172,7 +185,10 @@ public:
     info.tgsize_is_multiple_of_sgwidth = tgsize_is_multiple_of_sgwidth;
     info.immutable_buffers = (1 << 29) | (1 << 30);
 
-    state_ = device_->GetMTLDevice().newComputePipelineState(info, err);
+    {
+      DXMT_TRACE_SCOPE("newComputePipelineState");
+      state_ = device_->GetMTLDevice().newComputePipelineState(info, err);
+    }
 
     if (!state_) {
       ERR("Failed to create compute PSO: ", err.description().getUTF8String());
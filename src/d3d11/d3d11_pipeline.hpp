@@ -26,6 +26,8 @@ struct MTL_GRAPHICS_PIPELINE_DESC {
   SM50_INDEX_BUFFER_FORMAT IndexBufferFormat;
   uint32_t SampleMask;
   uint32_t GSPassthrough;
+  bool DepthBoundsTest;
+  bool DepthBoundsTestArray;
 };
 
 struct MTL_COMPUTE_PIPELINE_DESC {
@@ -64,6 +66,8 @@ template <> struct hash<MTL_GRAPHICS_PIPELINE_DESC> {
     state.add((size_t)v.GSStripTopology);
     state.add((size_t)v.SampleMask);
     state.add((size_t)v.GSPassthrough);
+    state.add((size_t)v.DepthBoundsTest);
+    state.add((size_t)v.DepthBoundsTestArray);
     state.add((size_t)v.SampleCount);
     state.add((size_t)v.NumColorAttachments);
     for (unsigned i = 0; i < v.NumColorAttachments; i++) {
@@ -133,7 +137,9 @@ template <> struct equal_to<MTL_GRAPHICS_PIPELINE_DESC> {
            (x.SampleCount == y.SampleCount) &&
            (x.IndexBufferFormat == y.IndexBufferFormat) &&
            (x.SampleMask == y.SampleMask) &&
-           (x.GSPassthrough == y.GSPassthrough);
+           (x.GSPassthrough == y.GSPassthrough) &&
+           (x.DepthBoundsTest == y.DepthBoundsTest) &&
+           (x.DepthBoundsTestArray == y.DepthBoundsTestArray);
   }
 };
 } // namespace std
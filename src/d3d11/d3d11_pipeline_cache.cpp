@@ -1,4 +1,5 @@
 #include "d3d11_pipeline_cache.hpp"
+#include "DXBCParser/DXBCUtils.h"
 #include "airconv_public.h"
 #include "d3d11_device.hpp"
 #include "d3d11_shader.hpp"
@@ -9,6 +10,7 @@
 #include "sha1/sha1_util.hpp"
 #include "../d3d10/d3d10_shader.hpp"
 #include "../d3d10/d3d10_input_layout.hpp"
+#include <algorithm>
 #include <cstring>
 #include <shared_mutex>
 
@@ -63,6 +65,9 @@ template <> struct task_trait<ThreadpoolWork *> {
   }
   bool get_done(ThreadpoolWork *task) { return task->GetIsDone(); }
   void set_done(ThreadpoolWork *task) { task->SetIsDone(true); }
+  void set_queued(ThreadpoolWork *task) { task->SetIsQueued(); }
+  bool get_queued(ThreadpoolWork *task) { return task->GetIsQueued(); }
+  bool try_dequeue(ThreadpoolWork *task) { return task->TryDequeue(); }
 };
 
 class PipelineCache : public MTLD3D11PipelineCacheBase {
@@ -73,13 +78,15 @@ class PipelineCache : public MTLD3D11PipelineCacheBase {
     Sha1Digest sha1_;
     MTL_SHADER_REFLECTION reflection_;
     MTL_SM50_SHADER_ARGUMENT *arguments_info_buffer;
+    uint32_t input_register_mask_;
     std::unordered_map<ShaderVariant, std::unique_ptr<CompiledShader>> variants;
 
   public:
     CachedSM50Shader(PipelineCache *cache, sm50_shader_t shader_transferred,
-                     const Sha1Digest &hash, MTL_SHADER_REFLECTION &reflection)
+                     const Sha1Digest &hash, MTL_SHADER_REFLECTION &reflection,
+                     uint32_t input_register_mask)
         : cache(cache), shader(shader_transferred), sha1_(hash),
-          reflection_(reflection) {
+          reflection_(reflection), input_register_mask_(input_register_mask) {
       if (reflection_.NumConstantBuffers + reflection_.NumArguments) {
         arguments_info_buffer = (MTL_SM50_SHADER_ARGUMENT *)malloc(
             sizeof(MTL_SM50_SHADER_ARGUMENT) *
@@ -112,7 +119,18 @@ class PipelineCache : public MTLD3D11PipelineCacheBase {
     virtual MTL_SM50_SHADER_ARGUMENT *arguments_info() {
       return arguments_info_buffer + reflection_.NumConstantBuffers;
     };
+    virtual uint32_t input_register_mask() { return input_register_mask_; }
     virtual CompiledShader *get_shader(ShaderVariant variant) {
+      std::visit(
+          [this](auto &v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, ShaderVariantTessellationVertexHull>)
+              cache->ProjectInputLayout(v.input_layout_handle, v.vertex_shader_handle->input_register_mask());
+            else if constexpr (requires { v.input_layout_handle; })
+              cache->ProjectInputLayout(v.input_layout_handle, input_register_mask_);
+          },
+          variant
+      );
       auto c = variants.insert({variant, nullptr});
       if (c.second) {
         c.first->second = std::visit(
@@ -186,8 +204,51 @@ class PipelineCache : public MTLD3D11PipelineCacheBase {
     std::vector<MTL_SHADER_INPUT_LAYOUT_ELEMENT_DESC> attributes_;
     Sha1Digest sha1_;
     uint32_t input_slot_mask_;
+    /* consumed register mask -> fetch layout, guarded by mutex_ia_ */
+    std::unordered_map<uint32_t, CachedInputLayout *> projections_;
   };
 
+  /**
+   * \brief Replaces an input layout with the fetch layout of a vertex shader
+   *
+   * The generated vertex fetch only depends on the elements whose register
+   * is consumed by the shader (and on the slot mask, which determines the
+   * vertex buffer table layout). Layouts that differ elsewhere, e.g. in
+   * elements another shader needs, map to the same fetch layout and thus
+   * to the same compiled variant.
+   */
+  void
+  ProjectInputLayout(ManagedInputLayout &layout, uint32_t register_mask) {
+    if (!layout)
+      return;
+    auto input_layout = static_cast<CachedInputLayout *>(layout);
+    std::lock_guard<dxmt::mutex> lock(mutex_ia_);
+    auto projection = input_layout->projections_.find(register_mask);
+    if (projection == input_layout->projections_.end()) {
+      MTL_INPUT_LAYOUT_DESC elements;
+      for (auto &element : input_layout->attributes_) {
+        if (register_mask & (1u << element.Index))
+          elements.push_back(element);
+      }
+      auto &fetch_layouts = fetch_layouts_[input_layout->input_slot_mask_];
+      auto fetch_layout = fetch_layouts.find(elements);
+      if (fetch_layout == fetch_layouts.end()) {
+        MTL_INPUT_LAYOUT_DESC key = elements;
+        fetch_layout =
+            fetch_layouts
+                .emplace(
+                    std::move(key),
+                    std::make_unique<CachedInputLayout>(std::move(elements), input_layout->input_slot_mask_)
+                )
+                .first;
+      } else {
+        ShaderCompileStatistics::fetch_layout_shared.fetch_add(1, std::memory_order_relaxed);
+      }
+      projection = input_layout->projections_.emplace(register_mask, fetch_layout->second.get()).first;
+    }
+    layout = projection->second;
+  }
+
   ShaderCache& scache_;
 
   task_scheduler<ThreadpoolWork *> scheduler_;
@@ -196,6 +257,9 @@ class PipelineCache : public MTLD3D11PipelineCacheBase {
   StateObjectCache<D3D11_BLEND_DESC1, IMTLD3D11BlendState> blend_states;
 
   std::unordered_map<MTL_INPUT_LAYOUT_DESC, std::unique_ptr<CachedInputLayout>> input_layouts;
+  /* input layouts restricted to the registers a vertex shader consumes, by slot mask */
+  std::unordered_map<uint32_t, std::unordered_map<MTL_INPUT_LAYOUT_DESC, std::unique_ptr<CachedInputLayout>>>
+      fetch_layouts_;
   dxmt::mutex mutex_ia_;
 
   StateObjectCache<MTL_STREAM_OUTPUT_DESC, IMTLD3D11StreamOutputLayout>
@@ -235,7 +299,19 @@ class PipelineCache : public MTLD3D11PipelineCacheBase {
       SM50FreeError(err);
       return nullptr;
     }
-    auto shader = std::make_unique<CachedSM50Shader>(this, sm50, sha1, reflection);
+    // registers fed by the input assembler, everything if unknown
+    uint32_t input_register_mask = ~0u;
+    microsoft::CSignatureParser parser;
+    if (SUCCEEDED(microsoft::DXBCGetInputSignature(pBytecode, &parser))) {
+      const microsoft::D3D11_SIGNATURE_PARAMETER *pParameters;
+      auto num_parameters = parser.GetParameters(&pParameters);
+      input_register_mask = 0;
+      for (unsigned i = 0; i < num_parameters; i++) {
+        if (pParameters[i].SystemValue == microsoft::D3D10_SB_NAME_UNDEFINED)
+          input_register_mask |= 1u << pParameters[i].Register;
+      }
+    }
+    auto shader = std::make_unique<CachedSM50Shader>(this, sm50, sha1, reflection, input_register_mask);
     {
       std::unique_lock<std::shared_mutex> lock(mutex_shares);
       auto result = shaders_.find(sha1);
@@ -333,6 +409,8 @@ class PipelineCache : public MTLD3D11PipelineCacheBase {
       return hr;
     }
     buffer.resize(num_metal_ia_elements);
+    // element order doesn't affect vertex fetch
+    std::sort(buffer.begin(), buffer.end(), [](auto &a, auto &b) { return a.Index < b.Index; });
     if (!input_layouts.contains(buffer)) {
       uint32_t input_slot_mask = 0;
       for (auto &element : buffer) {
@@ -447,12 +525,21 @@ class PipelineCache : public MTLD3D11PipelineCacheBase {
     *ppPipeline = iter->second.get();
   }
 
+  void PromoteWork(ThreadpoolWork *pWork) override {
+    scheduler_.promote(pWork);
+  }
+
 public:
   PipelineCache(MTLD3D11Device *pDevice) :
       scache_(ShaderCache::getInstance(pDevice->GetDXMTDevice().metalVersion())),
       device(pDevice),
       blend_states(pDevice),
       so_layouts(pDevice) {};
+
+  ~PipelineCache() {
+    // cancel pending compilation before shaders and pipelines are released
+    scheduler_.shutdown();
+  }
 };
 
 std::unique_ptr<MTLD3D11PipelineCacheBase>
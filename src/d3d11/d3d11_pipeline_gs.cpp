@@ -20,6 +20,7 @@
 #include "airconv_public.h"
 #include "d3d11_device.hpp"
 #include "d3d11_pipeline.hpp"
+#include "dxmt_trace.hpp"
 #include "log/log.hpp"
 
 namespace dxmt {
@@ -54,7 +55,8 @@ public:
       PixelShader = pDesc->PixelShader->get_shader(ShaderVariantPixel{
           pDesc->SampleMask, pDesc->BlendState->IsDualSourceBlending(),
           depth_stencil_format == WMTPixelFormatInvalid,
-          unorm_output_reg_mask});
+          unorm_output_reg_mask, pDesc->DepthBoundsTest ? pDesc->SampleCount : 0u,
+          pDesc->DepthBoundsTest && pDesc->DepthBoundsTestArray});
       ps_valid_render_targets = pDesc->PixelShader->reflection().PSValidRenderTargets;
     } else {
       PixelShader = nullptr;
@@ -63,7 +65,11 @@ public:
   }
 
   void GetPipeline(MTL_COMPILED_GRAPHICS_PIPELINE *pPipeline) final {
-    ready_.wait(false, std::memory_order_acquire);
+    DXMT_TRACE_SCOPE("GetPipeline::wait");
+    if (!ready_.load(std::memory_order_acquire)) {
+      device_->PromotePipelineWork(this);
+      ready_.wait(false, std::memory_order_acquire);
+    }
     *pPipeline = {state_mesh_};
   }
 
@@ -131,7 +137,10 @@ public:
 
     info.raster_sample_count = SampleCount;
 
-    state_mesh_ = device_->GetMTLDevice().newRenderPipelineState(info, err);
+    {
+      DXMT_TRACE_SCOPE("newRenderPipelineState");
+      state_mesh_ = device_->GetMTLDevice().newRenderPipelineState(info, err);
+    }
 
     if (state_mesh_ == nullptr) {
       ERR("Failed to create mesh PSO: ", err.description().getUTF8String());
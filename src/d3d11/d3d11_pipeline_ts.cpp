@@ -21,6 +21,7 @@
 #include "d3d11_device.hpp"
 #include "d3d11_pipeline.hpp"
 #include "d3d11_shader.hpp"
+#include "dxmt_trace.hpp"
 #include "log/log.hpp"
 #include "thread.hpp"
 
@@ -74,7 +75,8 @@ public:
       PixelShader = pDesc->PixelShader->get_shader(ShaderVariantPixel{
           pDesc->SampleMask, pDesc->BlendState->IsDualSourceBlending(),
           depth_stencil_format == WMTPixelFormatInvalid,
-          unorm_output_reg_mask});
+          unorm_output_reg_mask, pDesc->DepthBoundsTest ? pDesc->SampleCount : 0u,
+          pDesc->DepthBoundsTest && pDesc->DepthBoundsTestArray});
       ps_valid_render_targets = pDesc->PixelShader->reflection().PSValidRenderTargets;
     } else {
       PixelShader = nullptr;
@@ -83,7 +85,11 @@ public:
   }
 
   void GetPipeline(MTL_COMPILED_TESSELLATION_MESH_PIPELINE *pPipeline) final {
-    ready_.wait(false, std::memory_order_acquire);
+    DXMT_TRACE_SCOPE("GetPipeline::wait");
+    if (!ready_.load(std::memory_order_acquire)) {
+      device_->PromotePipelineWork(this);
+      ready_.wait(false, std::memory_order_acquire);
+    }
     *pPipeline = {state_rasterization_, hull_reflection.NumOutputElement,
                   hull_reflection.ThreadsPerPatch};
   }
@@ -165,8 +171,11 @@ public:
 
     {
       std::lock_guard<dxmt::mutex> lock(ts_global_mutex);
-      state_rasterization_ =
-          device_->GetMTLDevice().newRenderPipelineState(info, err);
+      {
+        DXMT_TRACE_SCOPE("newRenderPipelineState");
+        state_rasterization_ =
+            device_->GetMTLDevice().newRenderPipelineState(info, err);
+      }
     }
     if (state_rasterization_ == nullptr) {
       ERR("Failed to create tessellation raster PSO: ",
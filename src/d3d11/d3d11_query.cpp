@@ -8,8 +8,9 @@ class OcclusionQuery : public MTLD3DQueryBase<MTLD3D11OcclusionQuery> {
 
   QueryState state_ = QueryState::Signaled;
 
-  Rc<VisibilityResultQuery> query_ = new VisibilityResultQuery();
+  Rc<VisibilityResultQuery> query_ = VisibilityResultQuery::allocate();
   uint64_t accumulated_value_ = 0;
+  uint64_t end_pass_id_ = ~0ull;
 
   virtual UINT STDMETHODCALLTYPE
   GetDataSize() override {
@@ -27,8 +28,10 @@ class OcclusionQuery : public MTLD3DQueryBase<MTLD3D11OcclusionQuery> {
       } else {
         *((uint64_t *)data) = accumulated_value_;
       }
-      query_ = new VisibilityResultQuery();
-      state_ = QueryState::Signaled;
+      if (state_ != QueryState::Signaled) {
+        query_ = VisibilityResultQuery::allocate();
+        state_ = QueryState::Signaled;
+      }
       return S_OK;
     }
     return S_FALSE;
@@ -43,7 +46,7 @@ class OcclusionQuery : public MTLD3DQueryBase<MTLD3D11OcclusionQuery> {
     if (state_ == QueryState::Issued) {
       // discard previous issued query
       state_ = QueryState::Building;
-      query_ = new VisibilityResultQuery();
+      query_ = VisibilityResultQuery::allocate();
       return query_.ptr();
     }
     // FIXME: it's effectively ignoring  Begin() after Begin()
@@ -51,7 +54,7 @@ class OcclusionQuery : public MTLD3DQueryBase<MTLD3D11OcclusionQuery> {
   };
 
   virtual VisibilityResultQuery *
-  End() override {
+  End(uint64_t pass_id) override {
     if (state_ == QueryState::Signaled) {
       // ignore  a single End()
       accumulated_value_ = 0;
@@ -62,14 +65,26 @@ class OcclusionQuery : public MTLD3DQueryBase<MTLD3D11OcclusionQuery> {
       return nullptr;
     }
     state_ = QueryState::Issued;
+    end_pass_id_ = pass_id;
     return query_.ptr();
   };
 
   virtual void DoDeferredQuery(VisibilityResultQuery *deferred_query) override{
     accumulated_value_ = 0;
     state_ = QueryState::Issued;
+    end_pass_id_ = ~0ull;
     query_ = deferred_query;
   };
+
+  virtual VisibilityResultQuery *
+  Predicate(uint64_t *value, uint64_t *pass_id) override {
+    if (state_ == QueryState::Signaled) {
+      *value = accumulated_value_;
+      return nullptr;
+    }
+    *pass_id = end_pass_id_;
+    return query_.ptr();
+  };
 };
 
 HRESULT
@@ -160,12 +160,58 @@ private:
   uint64_t should_be_signaled_at = 0;
 };
 
+/**
+Signaled like an event query. The result is resolved once: timestamps are
+disjoint if the timestamp epoch has changed between Begin() and End()
+*/
+class MTLD3D11TimestampDisjointQuery : public MTLD3D11EventQueryImpl<D3D11_QUERY_DATA_TIMESTAMP_DISJOINT> {
+public:
+  MTLD3D11TimestampDisjointQuery(MTLD3D11Device *pDevice, const D3D11_QUERY_DESC1 *desc)
+      : MTLD3D11EventQueryImpl<D3D11_QUERY_DATA_TIMESTAMP_DISJOINT>(pDevice, desc) {}
+
+  void Begin(uint64_t epoch) { begin_epoch = epoch; }
+
+  void End(uint64_t epoch) { end_epoch = epoch; }
+
+  void Issue(uint64_t current_seq_id) override {
+    MTLD3D11EventQueryImpl<D3D11_QUERY_DATA_TIMESTAMP_DISJOINT>::Issue(current_seq_id);
+    resolved = false;
+  }
+
+  template <typename Resolver>
+  D3D11_QUERY_DATA_TIMESTAMP_DISJOINT &
+  GetResult(Resolver &&resolver) {
+    if (!resolved) {
+      result = resolver(begin_epoch, end_epoch);
+      resolved = true;
+    }
+    return result;
+  }
+
+private:
+  // unknown if not begun on the immediate context
+  uint64_t begin_epoch = ~0ull;
+  uint64_t end_epoch = ~0ull;
+  bool resolved = false;
+  D3D11_QUERY_DATA_TIMESTAMP_DISJOINT result = {};
+};
+
 class MTLD3D11OcclusionQuery : public ID3D11Query1 {
 public:
   virtual HRESULT GetData(void *data) = 0;
   virtual VisibilityResultQuery *Begin() = 0;
-  virtual VisibilityResultQuery *End() = 0;
+  /**
+   * \param pass_id render pass of immediate context where the query ends
+   */
+  virtual VisibilityResultQuery *End(uint64_t pass_id) = 0;
   virtual void DoDeferredQuery(VisibilityResultQuery *deferred_query) = 0;
+  /**
+   * \brief Gets the query used as a predicate
+   *
+   * Returns \c nullptr and writes \p value if the result is already known,
+   * otherwise \p pass_id is set to where the query ends.
+   */
+  virtual VisibilityResultQuery *Predicate(uint64_t *value, uint64_t *pass_id) = 0;
 };
 
 HRESULT CreateOcclusionQuery(MTLD3D11Device *pDevice,
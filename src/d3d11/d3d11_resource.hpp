@@ -2,6 +2,7 @@
 #include "dxmt_buffer.hpp"
 #include "dxmt_dynamic.hpp"
 #include "dxmt_staging.hpp"
+#include "dxmt_staging_layout.hpp"
 #include "dxmt_texture.hpp"
 #include "d3d11_device_child.hpp"
 #include "com/com_pointer.hpp"
@@ -3,6 +3,8 @@
 #include "airconv_public.h"
 #include "config/config.hpp"
 #include "d3d11_input_layout.hpp"
+#include "dxmt_statistics.hpp"
+#include "dxmt_trace.hpp"
 #include "sha1/sha1_util.hpp"
 #include <mutex>
 
@@ -67,12 +69,23 @@ public:
         lib_data = nullptr;
         break;
       }
+      ShaderCompileStatistics::cache_hit.fetch_add(1, std::memory_order_relaxed);
       break;
     }
 
     if (!lib_data) {
       SM50_COMPILED_BITCODE bitcode;
-      sm50_bitcode_t compile_result = proc(func_name.c_str(), &sm50_common);
+      sm50_bitcode_t compile_result;
+      {
+        DXMT_TRACE_SCOPE("SM50Compile");
+        auto t0 = clock::now();
+        compile_result = proc(func_name.c_str(), &sm50_common);
+        ShaderCompileStatistics::compiled.fetch_add(1, std::memory_order_relaxed);
+        ShaderCompileStatistics::compile_time_us.fetch_add(
+            std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - t0).count(),
+            std::memory_order_relaxed
+        );
+      }
 
       if (!compile_result)
         return this;
@@ -172,6 +185,8 @@ CreateVariantShader(MTLD3D11Device *pDevice, ManagedShader shader,
   h.update(variant.unorm_output_reg_mask);
   h.update(variant.dual_source_blending);
   h.update(variant.disable_depth_output);
+  h.update(variant.depth_bounds_test_sample_count);
+  h.update(variant.depth_bounds_test_array);
   auto variant_digest = h.final();
   std::string func_name = "ps_" + shader->sha1().string().substr(0, 8) + "_" + variant_digest.string();
 
@@ -183,6 +198,8 @@ CreateVariantShader(MTLD3D11Device *pDevice, ManagedShader shader,
     data.dual_source_blending = variant.dual_source_blending;
     data.disable_depth_output = variant.disable_depth_output;
     data.unorm_output_reg_mask = variant.unorm_output_reg_mask;
+    data.depth_bounds_test_sample_count = variant.depth_bounds_test_sample_count;
+    data.depth_bounds_test_array = variant.depth_bounds_test_array;
 
     sm50_bitcode_t compile_result = nullptr;
     sm50_error_t sm50_err = nullptr;
@@ -7,6 +7,7 @@
 #include "d3d11_input_layout.hpp"
 #include "sha1/sha1_util.hpp"
 #include "log/log.hpp"
+#include <atomic>
 #include <variant>
 
 struct MTL_COMPILED_SHADER {
@@ -104,11 +105,15 @@ struct ShaderVariantPixel {
   bool dual_source_blending;
   bool disable_depth_output;
   uint32_t unorm_output_reg_mask;
+  uint32_t depth_bounds_test_sample_count;
+  bool depth_bounds_test_array;
   bool operator==(const this_type &rhs) const {
     return sample_mask == rhs.sample_mask &&
            dual_source_blending == rhs.dual_source_blending &&
            disable_depth_output == rhs.disable_depth_output &&
-           unorm_output_reg_mask == rhs.unorm_output_reg_mask;
+           unorm_output_reg_mask == rhs.unorm_output_reg_mask &&
+           depth_bounds_test_sample_count == rhs.depth_bounds_test_sample_count &&
+           depth_bounds_test_array == rhs.depth_bounds_test_array;
   }
 };
 
@@ -191,6 +196,13 @@ public:
   virtual ThreadpoolWork *RunThreadpoolWork() = 0;
   virtual bool GetIsDone() = 0;
   virtual void SetIsDone(bool state) = 0;
+
+  void SetIsQueued() { queued_.store(true, std::memory_order_release); }
+  bool GetIsQueued() { return queued_.load(std::memory_order_acquire); }
+  bool TryDequeue() { return queued_.exchange(false, std::memory_order_acq_rel); }
+
+private:
+  std::atomic_bool queued_ = false;
 };
 
 class CompiledShader : public ThreadpoolWork {
@@ -202,6 +214,20 @@ public:
   virtual bool GetShader(MTL_COMPILED_SHADER *pShaderData) = 0;
 };
 
+/**
+ * \brief Process-wide shader variant counters, for statistics
+ *
+ * \c fetch_layout_shared counts input layout / vertex shader combinations
+ * that resolved to an existing fetch layout, i.e. that reuse the variants
+ * compiled for it instead of compiling their own.
+ */
+struct ShaderCompileStatistics {
+  static inline std::atomic_uint64_t compiled = {0};
+  static inline std::atomic_uint64_t compile_time_us = {0};
+  static inline std::atomic_uint64_t cache_hit = {0};
+  static inline std::atomic_uint64_t fetch_layout_shared = {0};
+};
+
 class Shader {
 public:
   virtual ~Shader() {};
@@ -211,6 +237,8 @@ public:
   virtual MTL_SHADER_REFLECTION &reflection() = 0;
   virtual MTL_SM50_SHADER_ARGUMENT *constant_buffers_info() = 0;
   virtual MTL_SM50_SHADER_ARGUMENT *arguments_info() = 0;
+  /* registers of the input signature fed by the input assembler */
+  virtual uint32_t input_register_mask() = 0;
   virtual CompiledShader *get_shader(ShaderVariant variant) = 0;
   virtual const Sha1Digest& sha1() = 0;
   virtual void dump() = 0;
@@ -547,6 +547,10 @@ public:
     return desc_.DepthEnable || desc_.StencilEnable;
   }
 
+  virtual bool IsDepthWriteEnabled() {
+    return desc_.DepthEnable && desc_.DepthWriteMask != D3D11_DEPTH_WRITE_MASK_ZERO;
+  }
+
 private:
   const D3D11_DEPTH_STENCIL_DESC desc_;
   MTLD3D10DepthStencilState d3d10_;
@@ -569,16 +573,17 @@ HRESULT StateObjectCache<D3D11_DEPTH_STENCIL_DESC, IMTLD3D11DepthStencilState>::
   if (!ppDepthStencilState)
     return S_FALSE;
 
+  StateObjectStatistics::requested.fetch_add(1, std::memory_order_relaxed);
+
   if (cache.contains(*pDesc)) {
     cache.at(*pDesc)->QueryInterface(IID_PPV_ARGS(ppDepthStencilState));
     return S_OK;
   }
 
-  WMTDepthStencilInfo info;
+  // zeroed so that disabled stencil faces compare equal
+  WMTDepthStencilInfo info{};
   info.depth_compare_function = WMTCompareFunctionAlways;
   info.depth_write_enabled = false;
-  info.front_stencil.enabled = false;
-  info.back_stencil.enabled = false;
   if (pDesc->DepthEnable) {
     info.depth_compare_function = kCompareFunctionMap[pDesc->DepthFunc];
     info.depth_write_enabled = pDesc->DepthWriteMask == D3D11_DEPTH_WRITE_MASK_ALL;
@@ -613,41 +618,24 @@ HRESULT StateObjectCache<D3D11_DEPTH_STENCIL_DESC, IMTLD3D11DepthStencilState>::
     }
   }
 
-  auto state_default = device->GetMTLDevice().newDepthStencilState(info);
+  auto get_state = [&](const WMTDepthStencilInfo &key) {
+    return metal_cache.get(key, [&]() { return device->GetMTLDevice().newDepthStencilState(key); });
+  };
 
-  if (pDesc->StencilEnable) {
-    info.front_stencil.enabled = false;
-    info.back_stencil.enabled = false;
-    auto stencil_effective_disabled = device->GetMTLDevice().newDepthStencilState(info);
-    if (pDesc->DepthEnable) {
-      info.depth_compare_function = WMTCompareFunctionAlways;
-      info.depth_write_enabled = false;
-      auto depthstencil_effective_disabled = device->GetMTLDevice().newDepthStencilState(info);
-      cache.emplace(*pDesc,
-                    std::make_unique<MTLD3D11DepthStencilState>(
-                        device, state_default, stencil_effective_disabled,
-                        depthstencil_effective_disabled, *pDesc));
-    } else {
-      // stencil_effective_disabled has no depth either...
-      cache.emplace(*pDesc,
-                    std::make_unique<MTLD3D11DepthStencilState>(
-                        device, state_default, stencil_effective_disabled,
-                        stencil_effective_disabled, *pDesc));
-    }
-  } else {
-    if (pDesc->DepthEnable) {
-      info.depth_compare_function = WMTCompareFunctionAlways;
-      info.depth_write_enabled = false;
-      auto depth_effective_disabled = device->GetMTLDevice().newDepthStencilState(info);
-      cache.emplace(*pDesc, std::make_unique<MTLD3D11DepthStencilState>(
-                                device, state_default, state_default,
-                                depth_effective_disabled, *pDesc));
-    } else {
-      cache.emplace(*pDesc, std::make_unique<MTLD3D11DepthStencilState>(
-                                device, state_default, state_default,
-                                state_default, *pDesc));
-    }
-  }
+  auto state_default = get_state(info);
+
+  info.front_stencil = {};
+  info.back_stencil = {};
+  auto stencil_disabled = get_state(info);
+
+  info.depth_compare_function = WMTCompareFunctionAlways;
+  info.depth_write_enabled = false;
+  auto depthstencil_disabled = get_state(info);
+
+  cache.emplace(*pDesc, std::make_unique<MTLD3D11DepthStencilState>(
+                            device, state_default, stencil_disabled,
+                            depthstencil_disabled, *pDesc));
+  StateObjectStatistics::unique.fetch_add(1, std::memory_order_relaxed);
   cache.at(*pDesc)->QueryInterface(IID_PPV_ARGS(ppDepthStencilState));
   return S_OK;
 }
@@ -666,6 +654,8 @@ HRESULT StateObjectCache<D3D11_RASTERIZER_DESC2, IMTLD3D11RasterizerState>::
   if (!ppRasterizerState)
     return S_FALSE;
 
+  StateObjectStatistics::requested.fetch_add(1, std::memory_order_relaxed);
+
   if (cache.contains(*pRasterizerDesc)) {
     cache.at(*pRasterizerDesc)->QueryInterface(IID_PPV_ARGS(ppRasterizerState));
     return S_OK;
@@ -673,6 +663,7 @@ HRESULT StateObjectCache<D3D11_RASTERIZER_DESC2, IMTLD3D11RasterizerState>::
 
   cache.emplace(*pRasterizerDesc, std::make_unique<MTLD3D11RasterizerState>(
                                       device, pRasterizerDesc));
+  StateObjectStatistics::unique.fetch_add(1, std::memory_order_relaxed);
   cache.at(*pRasterizerDesc)->QueryInterface(IID_PPV_ARGS(ppRasterizerState));
 
   return S_OK;
@@ -697,12 +688,15 @@ StateObjectCache<D3D11_SAMPLER_DESC, D3D11SamplerState>::CreateStateObject(
   if (!ppSamplerState)
     return S_FALSE;
 
+  StateObjectStatistics::requested.fetch_add(1, std::memory_order_relaxed);
+
   if (cache.contains(*pSamplerDesc)) {
     cache.at(*pSamplerDesc)->QueryInterface(__uuidof(ID3D11SamplerState), (void **)ppSamplerState);
     return S_OK;
   }
 
-  WMTSamplerInfo info;
+  // zeroed so that it can be used as a cache key, see below
+  WMTSamplerInfo info{};
 
   info.lod_average = false;
   info.mip_filter = WMTSamplerMipFilterNotMipmapped;
@@ -779,7 +773,13 @@ StateObjectCache<D3D11_SAMPLER_DESC, D3D11SamplerState>::CreateStateObject(
   info.support_argument_buffers = true;
   info.normalized_coords = true;
 
-  auto sampler = Sampler::createSampler(device->GetMTLDevice(), info, desc.MipLODBias);
+  // descriptors only differing in fields Metal ignores share a sampler
+  SamplerStateKey key{};
+  key.info = info;
+  key.lod_bias = desc.MipLODBias;
+  auto sampler = metal_cache.get(key, [&]() {
+    return Sampler::createSampler(device->GetMTLDevice(), info, desc.MipLODBias);
+  });
 
   if (!sampler) {
     ERR("CreateSamplerState: failed to create sampler");
@@ -787,6 +787,7 @@ StateObjectCache<D3D11_SAMPLER_DESC, D3D11SamplerState>::CreateStateObject(
   }
 
   cache.emplace(*pSamplerDesc, std::make_unique<MTLD3D11SamplerState>(device, std::move(sampler), desc));
+  StateObjectStatistics::unique.fetch_add(1, std::memory_order_relaxed);
   cache.at(*pSamplerDesc)->QueryInterface(__uuidof(ID3D11SamplerState), (void **)ppSamplerState);
 
   return S_OK;
@@ -820,6 +821,8 @@ StateObjectCache<D3D11_BLEND_DESC1, IMTLD3D11BlendState>::CreateStateObject(
   desc_normalized.IndependentBlendEnable =
       bool(desc_normalized.IndependentBlendEnable);
 
+  StateObjectStatistics::requested.fetch_add(1, std::memory_order_relaxed);
+
   if (cache.contains(desc_normalized)) {
     cache.at(desc_normalized)->QueryInterface(IID_PPV_ARGS(ppBlendState));
     return S_OK;
@@ -827,6 +830,7 @@ StateObjectCache<D3D11_BLEND_DESC1, IMTLD3D11BlendState>::CreateStateObject(
 
   cache.emplace(desc_normalized,
                 std::make_unique<MTLD3D11BlendState>(device, desc_normalized));
+  StateObjectStatistics::unique.fetch_add(1, std::memory_order_relaxed);
   cache.at(desc_normalized)->QueryInterface(IID_PPV_ARGS(ppBlendState));
 
   return S_OK;
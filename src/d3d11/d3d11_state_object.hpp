@@ -21,6 +21,7 @@ DEFINE_COM_INTERFACE("b01aaffa-b4d3-478a-91be-6195f215aaba",
     : public ID3D11DepthStencilState {
   virtual WMT::DepthStencilState GetDepthStencilState(uint32_t planar_flags) = 0;
   virtual bool IsEnabled() = 0;
+  virtual bool IsDepthWriteEnabled() = 0;
 };
 
 DEFINE_COM_INTERFACE("279a1d66-2fc1-460c-a0a7-a7a5f2b7a48f",
@@ -33,9 +34,7 @@ DEFINE_COM_INTERFACE("279a1d66-2fc1-460c-a0a7-a7a5f2b7a48f",
 namespace std {
 template <> struct hash<D3D11_SAMPLER_DESC> {
   size_t operator()(const D3D11_SAMPLER_DESC &v) const noexcept {
-    constexpr size_t binsize = sizeof(v);
-    return std::hash<string_view>{}(
-        {reinterpret_cast<const char *>(&v), binsize});
+    return dxmt::HashBytes(&v, sizeof(v));
   };
 };
 
@@ -116,9 +115,7 @@ template <> struct equal_to<D3D11_BLEND_DESC1> {
 };
 template <> struct hash<D3D11_RASTERIZER_DESC2> {
   size_t operator()(const D3D11_RASTERIZER_DESC2 &v) const noexcept {
-    constexpr size_t binsize = sizeof(v);
-    return std::hash<string_view>{}(
-        {reinterpret_cast<const char *>(&v), binsize});
+    return dxmt::HashBytes(&v, sizeof(v));
   };
 };
 
@@ -133,9 +130,7 @@ template <> struct equal_to<D3D11_RASTERIZER_DESC2> {
 
 template <> struct hash<D3D11_DEPTH_STENCIL_DESC> {
   size_t operator()(const D3D11_DEPTH_STENCIL_DESC &v) const noexcept {
-    constexpr size_t binsize = sizeof(v);
-    return std::hash<string_view>{}(
-        {reinterpret_cast<const char *>(&v), binsize});
+    return dxmt::HashBytes(&v, sizeof(v));
   };
 };
 
@@ -156,6 +151,64 @@ public:
   virtual Rc<Sampler> sampler() = 0;
 };
 
+/**
+ * \brief Process-wide state object counters, for statistics
+ *
+ * \c requested counts successful Create*State calls, \c unique the
+ * D3D11 objects actually created. Metal objects derived from them are
+ * counted separately since equivalent descriptors share them.
+ */
+struct StateObjectStatistics {
+  static inline std::atomic_uint64_t requested = {0};
+  static inline std::atomic_uint64_t unique = {0};
+  static inline std::atomic_uint64_t metal_created = {0};
+  static inline std::atomic_uint64_t metal_shared = {0};
+};
+
+/**
+ * \brief Cache of Metal objects keyed by their canonical descriptor
+ *
+ * Keys must be zero-initialized before being filled so that fields
+ * Metal ignores and padding compare equal.
+ */
+template <typename Key, typename Value> class DerivedStateCache {
+public:
+  template <typename Create>
+  Value
+  get(const Key &key, Create &&create) {
+    auto it = cache_.find(key);
+    if (it != cache_.end()) {
+      StateObjectStatistics::metal_shared.fetch_add(1, std::memory_order_relaxed);
+      return it->second;
+    }
+    Value value = create();
+    if (!value)
+      return value;
+    StateObjectStatistics::metal_created.fetch_add(1, std::memory_order_relaxed);
+    cache_.emplace(key, value);
+    return value;
+  }
+
+private:
+  std::unordered_map<Key, Value, BytewiseHash<Key>, BytewiseEqual<Key>> cache_;
+};
+
+struct SamplerStateKey {
+  WMTSamplerInfo info;
+  float lod_bias;
+  uint32_t reserved;
+};
+
+template <typename DESC> struct MetalStateCache {};
+
+template <>
+struct MetalStateCache<D3D11_SAMPLER_DESC>
+    : DerivedStateCache<SamplerStateKey, Rc<Sampler>> {};
+
+template <>
+struct MetalStateCache<D3D11_DEPTH_STENCIL_DESC>
+    : DerivedStateCache<WMTDepthStencilInfo, WMT::Reference<WMT::DepthStencilState>> {};
+
 template <typename DESC, typename Object> class StateObjectCache {
 public:
   StateObjectCache(MTLD3D11Device *device) : device(device) {};
@@ -164,6 +217,7 @@ public:
 private:
   MTLD3D11Device *device;
   std::unordered_map<DESC, std::unique_ptr<ManagedDeviceChild<Object>>> cache;
+  MetalStateCache<DESC> metal_cache;
   dxmt::mutex mutex_cache;
 };
 
@@ -8,11 +8,14 @@
 #include "d3d11_context.hpp"
 #include "dxmt_context.hpp"
 #include "dxmt_hud_state.hpp"
+#include "dxmt_memory_budget.hpp"
 #include "dxmt_statistics.hpp"
 #include "dxmt_presenter.hpp"
 #include "log/log.hpp"
 #include "d3d11_resource.hpp"
 #include "d3d11_device.hpp"
+#include "d3d11_shader.hpp"
+#include "d3d11_state_object.hpp"
 #include "util_cpu_fence.hpp"
 #include "util_env.hpp"
 #include "util_string.hpp"
@@ -144,7 +147,9 @@ public:
 
     presenter = Rc(new Presenter(pDevice->GetMTLDevice(), layer_weak_,
                                  pDevice->GetDXMTDevice().queue().cmd_library,
-                                 scale_factor, desc_.SampleDesc.Count));
+                                 scale_factor, desc_.SampleDesc.Count,
+                                 desc_.SwapEffect == DXGI_SWAP_EFFECT_DISCARD ||
+                                     desc_.SwapEffect == DXGI_SWAP_EFFECT_FLIP_DISCARD));
 
     frame_latency = kSwapchainLatency;
     present_semaphore_ = CreateSemaphore(nullptr, frame_latency,
@@ -720,8 +725,13 @@ public:
 
   SyncFrameState SyncFrame(uint64_t current_frame_id) {
     if (frame_latency_fence_) {
-      if (current_frame_id > frame_latency)
-        frame_latency_fence_->wait(current_frame_id - frame_latency);
+      uint32_t latency = frame_latency;
+      // the adaptive latency controller may want a shallower queue than the app
+      auto &cmd_queue = device_->GetDXMTDevice().queue();
+      if (cmd_queue.AdaptiveLatencyEnabled())
+        latency = std::min(latency, cmd_queue.GetEffectiveLatency());
+      if (current_frame_id > latency)
+        frame_latency_fence_->wait(current_frame_id - latency);
       return SyncFrameState(current_frame_id, frame_latency_fence_.get());
     }
     return SyncFrameState();
@@ -856,6 +866,14 @@ public:
         std::min(average.sync_interval.count() / 1000000.0, 99.9), std::min(statistics.max().event_stall, 99u),
         std::min(average.present_latency_interval.count() / 1000000.0, 99.9), frame.latency
     ));
+    hud.printLine(std::format(
+        "Readback: {:3} ready {:3} stalled", std::min(frame.readback_ready, 999u),
+        std::min(frame.readback_stalled, 999u)
+    ));
+    hud.printLine(std::format(
+        "GPU: {:4.1f}/{:4.1f}ms", std::min(average.gpu_busy_interval.count() / 1000000.0, 99.9),
+        std::min(average.present_interval.count() / 1000000.0, 99.9)
+    ));
     hud.printLine(std::format(
         "Encode: {:4.1f}+{:4.1f}+{:4.1f}={:4.1f}", std::min(average.encode_prepare_interval.count() / 1000000.0, 99.9),
         std::min((average.encode_flush_interval - average.drawable_blocking_interval).count() / 1000000.0, 99.9),
@@ -867,6 +885,44 @@ public:
         std::min(frame.render_pass_optimized, 999u),
         std::min(frame.clear_pass_count - frame.clear_pass_optimized, 999u), std::min(frame.clear_pass_optimized, 99u)
     ));
+    hud.printLine(std::format(
+        "ArgTable:{:5}+{:<5} {:6}KB", std::min(frame.argument_table_encoded, 99999u),
+        std::min(frame.argument_table_reused, 99999u), std::min(frame.argument_table_bytes >> 10, uint64_t(999999))
+    ));
+    hud.printLine(std::format(
+        "Heap:{:5}MB {:5}MB pooled {:3} reused", std::min(frame.heap_bytes_live >> 20, uint64_t(99999)),
+        std::min(frame.heap_bytes_pooled >> 20, uint64_t(99999)), std::min(frame.heap_blocks_recycled, 999u)
+    ));
+    auto &budget = MemoryBudget::instance();
+    hud.printLine(std::format(
+        "Memory:{:5}MB buf {:5}MB tex /{:6}MB{}",
+        std::min(budget.usage(MemoryCategory::Buffer) >> 20, uint64_t(99999)),
+        std::min(budget.usage(MemoryCategory::Texture) >> 20, uint64_t(99999)),
+        std::min(budget.budget() >> 20, uint64_t(999999)), budget.underPressure() ? " !" : ""
+    ));
+    hud.printLine(std::format("TexView:{:5} created", std::min(frame.texture_view_created, 99999u)));
+    hud.printLine(std::format(
+        "Init:{:3} batches {:6}KB elided {:3} merged", std::min(frame.init_batches, 999u),
+        std::min(frame.init_bytes_elided >> 10, uint64_t(999999)), std::min(frame.init_clears_merged, 999u)
+    ));
+    hud.printLine(std::format(
+        "Present: {}", frame.present_dropped  ? "dropped"
+                       : frame.present_direct ? "direct"
+                                              : "blit"
+    ));
+    hud.printLine(std::format(
+        "StateObj:{:6}/{:<6} MTL:{:5}",
+        std::min(StateObjectStatistics::unique.load(std::memory_order_relaxed), uint64_t(999999)),
+        std::min(StateObjectStatistics::requested.load(std::memory_order_relaxed), uint64_t(999999)),
+        std::min(StateObjectStatistics::metal_created.load(std::memory_order_relaxed), uint64_t(99999))
+    ));
+    hud.printLine(std::format(
+        "Compile:{:5} {:6}ms Hit:{:5} Shared:{:5}",
+        std::min(ShaderCompileStatistics::compiled.load(std::memory_order_relaxed), uint64_t(99999)),
+        std::min(ShaderCompileStatistics::compile_time_us.load(std::memory_order_relaxed) / 1000, uint64_t(999999)),
+        std::min(ShaderCompileStatistics::cache_hit.load(std::memory_order_relaxed), uint64_t(99999)),
+        std::min(ShaderCompileStatistics::fetch_layout_shared.load(std::memory_order_relaxed), uint64_t(99999))
+    ));
     {
       /* scaler info */
       auto &info = frame.last_scaler_info;
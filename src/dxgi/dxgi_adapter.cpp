@@ -8,6 +8,8 @@
 #include "dxgi_object.hpp"
 #include "d3d10_1.h"
 #include "Metal.hpp"
+#include "thread.hpp"
+#include <unordered_map>
 
 namespace dxmt {
 
@@ -236,7 +238,8 @@ public:
       return E_INVALIDARG;
 
     // we don't actually care about MemorySegmentGroup
-    pVideoMemoryInfo->Budget = device_.recommendedMaxWorkingSetSize();
+    pVideoMemoryInfo->Budget =
+        options_.memoryBudget ? options_.memoryBudget : device_.recommendedMaxWorkingSetSize();
     pVideoMemoryInfo->CurrentUsage = device_.currentAllocatedSize();
     pVideoMemoryInfo->AvailableForReservation = 0;
     pVideoMemoryInfo->CurrentReservation =
@@ -260,23 +263,42 @@ public:
 
   HRESULT STDMETHODCALLTYPE RegisterVideoMemoryBudgetChangeNotificationEvent(
       HANDLE event, DWORD *cookie) override {
-    assert(0 && "TODO");
+    if (!event || !cookie)
+      return E_INVALIDARG;
+
+    std::lock_guard<dxmt::mutex> lock(budget_event_mutex_);
+    DWORD value = ++budget_event_cookie_;
+    budget_events_.insert({value, event});
+    *cookie = value;
+    // the application is expected to query the budget it starts with
+    SetEvent(event);
+    return S_OK;
   }
 
   void STDMETHODCALLTYPE
   UnregisterVideoMemoryBudgetChangeNotification(DWORD cookie) override {
-    assert(0 && "TODO");
+    std::lock_guard<dxmt::mutex> lock(budget_event_mutex_);
+    budget_events_.erase(cookie);
   }
 
   WMT::Device STDMETHODCALLTYPE GetMTLDevice() final { return device_; }
   D3DKMT_HANDLE STDMETHODCALLTYPE GetLocalD3DKMT() final { return local_kmt_; }
 
+  void STDMETHODCALLTYPE NotifyVideoMemoryBudgetChange() final {
+    std::lock_guard<dxmt::mutex> lock(budget_event_mutex_);
+    for (auto &[cookie, event] : budget_events_)
+      SetEvent(event);
+  }
+
 private:
   WMT::Reference<WMT::Device> device_;
   D3DKMT_HANDLE local_kmt_ = 0;
   Com<IDXGIFactory> factory_;
   DxgiOptions options_;
   uint64_t mem_reserved_[2] = {0, 0};
+  dxmt::mutex budget_event_mutex_;
+  DWORD budget_event_cookie_ = 0;
+  std::unordered_map<DWORD, HANDLE> budget_events_;
 };
 
 Com<IMTLDXGIAdapter> CreateAdapter(WMT::Device Device,
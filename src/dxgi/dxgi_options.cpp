@@ -1,4 +1,5 @@
 #include "dxgi_options.hpp"
+#include <algorithm>
 
 namespace dxmt {
 
@@ -33,6 +34,7 @@ DxgiOptions::DxgiOptions(const Config &config) {
   this->customDeviceDesc =
       config.getOption<std::string>("dxgi.customDeviceDesc", "");
   this->forceSDR = config.getOption<bool>("dxgi.forceSDR", false);
+  this->memoryBudget = uint64_t(std::max(config.getOption<int32_t>("dxgi.memoryBudget", 0), 0)) << 20;
 }
 
 } // namespace dxmt
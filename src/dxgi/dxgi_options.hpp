@@ -20,6 +20,10 @@ struct DxgiOptions {
   int32_t customDeviceId;
   std::string customDeviceDesc;
   bool forceSDR;
+
+  /// Video memory budget reported to the application in bytes,
+  /// 0 to report the working set recommended by Metal.
+  uint64_t memoryBudget;
 };
 
 } // namespace dxmt
\ No newline at end of file
@@ -56,6 +56,11 @@ public:
     return dirty.get(slot);
   };
 
+  constexpr uint64_t
+  dirty_qword(size_t index) const noexcept {
+    return dirty.qword(index);
+  }
+
   constexpr bool
   any_dirty() const noexcept {
     return dirty.any();
@@ -122,6 +127,20 @@ public:
     dirty.set(slot, true);
   };
 
+  /**
+  mark bound slots whose element satisfies the predicate as dirty,
+  useful when the resource behind an element has been renamed
+  */
+  template <typename Predicate>
+  inline void
+  set_dirty_if(Predicate &&pred) {
+    for (auto it = begin(); it != end(); ++it) {
+      const auto &[slot, element] = *it;
+      if (pred(element))
+        dirty.set(slot, true);
+    }
+  };
+
   /**
   try to bind element at specific slot, and return a reference to the
   corresponding element storage it also tells if a replacement does happen
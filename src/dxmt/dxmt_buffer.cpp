@@ -1,5 +1,7 @@
 #include "dxmt_buffer.hpp"
+#include "dxmt_dynamic.hpp"
 #include "dxmt_format.hpp"
+#include "dxmt_memory_budget.hpp"
 #include "thread.hpp"
 #include "util_likely.hpp"
 #include "util_math.hpp"
@@ -30,9 +32,30 @@ BufferAllocation::BufferAllocation(WMT::Device device, const WMTBufferInfo &info
   obj_ = device.newBuffer(info_);
   gpuAddress_ = info_.gpu_address;
   mappedMemory_ = info_.memory.get_accessible_or_null();
+  MemoryBudget::instance().track(MemoryCategory::Buffer, info_.length);
+};
+
+BufferAllocation::BufferAllocation(
+    WMT::Buffer shared, const WMTBufferInfo &info, uint32_t granularity, Flags<BufferAllocationFlag> flags
+) :
+    info_(info),
+    flags_(flags) {
+  flags_.set(BufferAllocationFlag::SharedRing);
+  // every granule of the shared buffer is a suballocation
+  suballocation_size_ = granularity;
+  suballocation_count_ = info_.length / granularity;
+  fenceTrackers.resize(1);
+  obj_ = shared;
+  gpuAddress_ = info_.gpu_address;
+  mappedMemory_ = info_.memory.get_accessible_or_null();
 };
 
 BufferAllocation::~BufferAllocation() {
+  if (ring_)
+    ring_->release(ring_suballocation_, 0);
+  // the shared buffer is accounted by the ring
+  if (!flags_.test(BufferAllocationFlag::SharedRing))
+    MemoryBudget::instance().track(MemoryCategory::Buffer, -int64_t(info_.length));
   if (placed_buffer) {
     wsi::aligned_free(placed_buffer);
     placed_buffer = nullptr;
@@ -96,7 +119,8 @@ Buffer::prepareAllocationViews(BufferAllocation *allocation) {
     info.options = allocation->info_.options;
     auto usage = WMTTextureUsageShaderRead;
     if (!allocation->flags().test(BufferAllocationFlag::GpuReadonly) &&
-       ( allocation->flags().test(BufferAllocationFlag::GpuManaged) ||  allocation->flags().test(BufferAllocationFlag::GpuPrivate))) {
+       ( allocation->flags().test(BufferAllocationFlag::GpuManaged) ||  allocation->flags().test(BufferAllocationFlag::GpuPrivate) ||
+         allocation->flags().test(BufferAllocationFlag::CpuMappable))) {
       usage |= WMTTextureUsageShaderWrite;
       if (format == WMTPixelFormatR32Uint || format == WMTPixelFormatR32Sint ||
           (format == WMTPixelFormatRG32Uint && device_.supportsFamily(WMTGPUFamilyApple8))) {
@@ -147,6 +171,18 @@ Buffer::allocate(Flags<BufferAllocationFlag> flags) {
   return new BufferAllocation(device_, info, flags);
 };
 
+Rc<Buffer> const &
+Buffer::filledSizeCounter() {
+  if (unlikely(!filled_size_counter_)) {
+    filled_size_counter_ = new Buffer(sizeof(uint32_t), device_);
+    auto allocation = filled_size_counter_->allocate({});
+    uint32_t zero = 0;
+    allocation->updateContents(0, &zero, sizeof(zero));
+    filled_size_counter_->rename(std::move(allocation));
+  }
+  return filled_size_counter_;
+}
+
 Rc<BufferAllocation>
 Buffer::rename(Rc<BufferAllocation> &&newAllocation) {
   Rc<BufferAllocation> old = std::move(current_);
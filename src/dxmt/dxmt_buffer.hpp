@@ -22,6 +22,10 @@ enum class BufferAllocationFlag : uint32_t {
   /* will allocate at least one page of memory and try to suballocate from that */
   SuballocateFromOnePage = 5,
   CpuPlaced = 6,
+  /* a view into a buffer shared with other allocations, see DynamicBufferRing */
+  SharedRing = 7,
+  /* default usage with cpu access, mapped in place; gpu accesses are recorded by seq id */
+  CpuMappable = 8,
 };
 
 typedef uint64_t BufferViewKey;
@@ -31,6 +35,7 @@ struct BufferViewDescriptor {
 };
 
 class Buffer;
+class DynamicBufferRing;
 
 struct BufferView {
   WMT::Reference<WMT::Texture> texture;
@@ -46,6 +51,7 @@ struct BufferView {
 
 class BufferAllocation : public Allocation {
   friend class Buffer;
+  friend class DynamicBufferRing;
 
 public:
 
@@ -93,6 +99,39 @@ public:
     return current_suballocation_;
   }
 
+  /**
+   * \brief Records a GPU access of a \c CpuMappable allocation
+   *
+   * Called by the encoder thread.
+   */
+  void
+  recordGpuAccess(uint64_t seq_id, int flags) noexcept {
+    if (flags & ResourceAccess::Write)
+      last_gpu_write_.store(seq_id, std::memory_order_relaxed);
+    last_gpu_access_.store(seq_id, std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief The last command chunk that writes to this allocation
+   *
+   * Only valid once all chunks submitted so far have been encoded.
+   */
+  uint64_t
+  lastGpuWrite() const noexcept {
+    return last_gpu_write_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t
+  lastGpuAccess() const noexcept {
+    return last_gpu_access_.load(std::memory_order_relaxed);
+  }
+
+  GenericAccessTracker &
+  currentFenceTracker() {
+    // a ring view is tracked as a whole
+    return fenceTrackers[flags_.test(BufferAllocationFlag::SharedRing) ? 0 : current_suballocation_];
+  }
+
   void
   updateContents(uint64_t offset, const void *data, uint64_t length, uint32_t suballocation = 0) noexcept {
     if (likely(mappedMemory_ != nullptr && !flags_.test(BufferAllocationFlag::GpuManaged))) {
@@ -107,6 +146,7 @@ public:
 
 private:
   BufferAllocation(WMT::Device device, const WMTBufferInfo &info, Flags<BufferAllocationFlag> flags);
+  BufferAllocation(WMT::Buffer shared, const WMTBufferInfo &info, uint32_t granularity, Flags<BufferAllocationFlag> flags);
   ~BufferAllocation();
 
   BufferAllocation(const BufferAllocation &) = delete;
@@ -124,6 +164,11 @@ private:
   uint32_t suballocation_count_ = 1;
 
   void * placed_buffer = nullptr;
+  std::atomic<uint64_t> last_gpu_write_ = 0;
+  std::atomic<uint64_t> last_gpu_access_ = 0;
+  /* set if the current name of a destroyed buffer is in a shared ring */
+  DynamicBufferRing *ring_ = nullptr;
+  uint32_t ring_suballocation_ = 0;
 };
 
 class Buffer {
@@ -158,6 +203,26 @@ public:
     return length_;
   };
 
+  /**
+  Byte count of stream output written to this buffer (D3D's BufferFilledSize),
+  it's only accessed by GPU. Created on first use, must be called from encoder thread.
+  */
+  Rc<Buffer> const &filledSizeCounter();
+
+  /**
+  Last command chunk of the immediate context that has recorded a command or
+  binding referencing this buffer. Only accessed by the application thread.
+  */
+  uint64_t
+  lastRecordedUse() const {
+    return last_recorded_use_;
+  }
+
+  void
+  recordUse(uint64_t seq_id) {
+    last_recorded_use_ = seq_id;
+  }
+
   WMTPixelFormat pixelFormat(BufferViewKey view) const {
     return viewDescriptors_[view].format;
   }
@@ -172,6 +237,8 @@ private:
   std::atomic<uint32_t> refcount_ = {0u};
 
   std::vector<BufferViewDescriptor> viewDescriptors_;
+  Rc<Buffer> filled_size_counter_;
+  uint64_t last_recorded_use_ = 0;
   dxmt::mutex mutex_;
   WMT::Device device_;
 };
@@ -60,6 +60,55 @@ EmulatedCommandContext::EmulatedCommandContext(WMT::Device device, InternalComma
     ts_marshal_pipeline.rasterization_enabled = false;
     ts_draw_arguments_marshal = device.newRenderPipelineState(ts_marshal_pipeline, error);
   }
+
+  auto so_arguments_marshal_vs = library.newFunction("so_arguments_marshal");
+  {
+    WMTRenderPipelineInfo so_marshal_pipeline;
+    WMT::InitializeRenderPipelineInfo(so_marshal_pipeline);
+    so_marshal_pipeline.vertex_function = so_arguments_marshal_vs;
+    so_marshal_pipeline.rasterization_enabled = false;
+    so_arguments_marshal = device.newRenderPipelineState(so_marshal_pipeline, error);
+  }
+
+  auto predicate_arguments_marshal_vs = library.newFunction("predicate_arguments_marshal");
+  {
+    WMTRenderPipelineInfo predicate_marshal_pipeline;
+    WMT::InitializeRenderPipelineInfo(predicate_marshal_pipeline);
+    predicate_marshal_pipeline.vertex_function = predicate_arguments_marshal_vs;
+    predicate_marshal_pipeline.rasterization_enabled = false;
+    predicate_arguments_marshal = device.newRenderPipelineState(predicate_marshal_pipeline, error);
+  }
+
+  CREATE_PIPELINE(predicate_arguments_marshal_cs);
+}
+
+void
+EmulatedCommandContext::MarshalPredicateArguments(
+    WMT::ComputeCommandEncoder encoder, WMT::Buffer commands, uint32_t commands_offset, WMT::Buffer visibility_results
+) {
+  struct wmtcmd_compute_setpso setpso;
+  setpso.type = WMTComputeCommandSetPSO;
+  setpso.pso = predicate_arguments_marshal_cs_pipeline;
+  setpso.threadgroup_size = {1, 1, 1};
+  struct wmtcmd_compute_setbuffer setcommands;
+  setcommands.type = WMTComputeCommandSetBuffer;
+  setcommands.buffer = commands;
+  setcommands.offset = commands_offset;
+  setcommands.index = 0;
+  struct wmtcmd_compute_setbuffer setvisibility;
+  setvisibility.type = WMTComputeCommandSetBuffer;
+  setvisibility.buffer = visibility_results;
+  setvisibility.offset = 0;
+  setvisibility.index = 1;
+  struct wmtcmd_compute_dispatch dispatch;
+  dispatch.type = WMTComputeCommandDispatchThreads;
+  dispatch.size = {1, 1, 1};
+  setpso.next.set(&setcommands);
+  setcommands.next.set(&setvisibility);
+  setvisibility.next.set(&dispatch);
+  dispatch.next.set(nullptr);
+  encoder.encodeCommands((const wmtcmd_compute_nop *)&setpso);
+  encoder.memoryBarrier(WMTBarrierScopeBuffers);
 }
 
 void
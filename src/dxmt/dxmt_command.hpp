@@ -171,6 +171,31 @@ public:
     encoder.setVertexBuffer({}, 0, 1);
   }
 
+  void
+  MarshalStreamOutputArguments(WMT::RenderCommandEncoder encoder, WMT::Buffer commands, uint32_t commands_offset) {
+    encoder.setRenderPipelineState(so_arguments_marshal);
+    encoder.setVertexBuffer(commands, commands_offset, 0);
+    encoder.drawPrimitives(WMTPrimitiveTypePoint, 0, 1);
+    encoder.setVertexBuffer({}, 0, 0);
+  }
+
+  void
+  MarshalPredicateArguments(
+      WMT::RenderCommandEncoder encoder, WMT::Buffer commands, uint32_t commands_offset, WMT::Buffer visibility_results
+  ) {
+    encoder.setRenderPipelineState(predicate_arguments_marshal);
+    encoder.setVertexBuffer(commands, commands_offset, 0);
+    encoder.setVertexBuffer(visibility_results, 0, 1);
+    encoder.drawPrimitives(WMTPrimitiveTypePoint, 0, 1);
+    encoder.setVertexBuffer({}, 0, 0);
+    encoder.setVertexBuffer({}, 0, 1);
+  }
+
+  void MarshalPredicateArguments(
+      WMT::ComputeCommandEncoder encoder, WMT::Buffer commands, uint32_t commands_offset,
+      WMT::Buffer visibility_results
+  );
+
 private:
   void setComputePipelineState(WMT::ComputePipelineState state, const WMTSize &threadgroup_size);
 
@@ -199,6 +224,9 @@ private:
 
   WMT::Reference<WMT::RenderPipelineState> gs_draw_arguments_marshal;
   WMT::Reference<WMT::RenderPipelineState> ts_draw_arguments_marshal;
+  WMT::Reference<WMT::RenderPipelineState> so_arguments_marshal;
+  WMT::Reference<WMT::RenderPipelineState> predicate_arguments_marshal;
+  WMT::Reference<WMT::ComputePipelineState> predicate_arguments_marshal_cs_pipeline;
 };
 
 class ClearRenderTargetContext {
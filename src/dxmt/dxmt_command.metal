@@ -383,6 +383,13 @@ struct DXMTDispatchArguments {
   uint z;
 };
 
+struct DXMTDrawArguments {
+  uint vertex_count;
+  uint instance_count;
+  uint vertex_start;
+  uint base_instance;
+};
+
 struct DXMTTSDispatchMarshal {
   constant uint2& draw_arguments; // (vertex|index_count, instance_count)
   device DXMTDispatchArguments& dispatch_arguments_out;
@@ -455,6 +462,114 @@ struct DXMTGSDispatchMarshal {
   };
 }
 
+struct DXMTPredicateMarshal {
+  constant uint* arguments;
+  device uint* arguments_out;
+  uint inline_arguments[5];
+  uint argument_count;
+  uint use_inline_arguments;
+  uint visibility_begin;
+  uint visibility_end;
+  uint predicate_value;
+  uint end_of_command;
+};
+
+/* copies draw/dispatch arguments, the first one (vertex|index|threadgroup count) is zeroed if predicate fails */
+void predicate_arguments_marshal_impl(
+    constant DXMTPredicateMarshal* tasks,
+    device const ulong* visibility_results
+) {
+  uint index = 0;
+  for(;;) {
+    constant DXMTPredicateMarshal& task = tasks[index];
+
+    ulong samples = 0;
+    for (uint i = task.visibility_begin; i < task.visibility_end; i++)
+      samples += visibility_results[i];
+
+    for (uint i = 0; i < task.argument_count; i++)
+      task.arguments_out[i] = task.use_inline_arguments ? task.inline_arguments[i] : task.arguments[i];
+    if ((samples != 0) == (task.predicate_value != 0))
+      task.arguments_out[0] = 0;
+
+    if (task.end_of_command)
+      break;
+    index++;
+  };
+}
+
+[[vertex]] void predicate_arguments_marshal(
+    constant DXMTPredicateMarshal* tasks [[buffer(0)]],
+    device const ulong* visibility_results [[buffer(1)]]
+) {
+  predicate_arguments_marshal_impl(tasks, visibility_results);
+}
+
+[[kernel]] void predicate_arguments_marshal_cs(
+    constant DXMTPredicateMarshal* tasks [[buffer(0)]],
+    device const ulong* visibility_results [[buffer(1)]]
+) {
+  predicate_arguments_marshal_impl(tasks, visibility_results);
+}
+
+struct DXMTStreamOutputMarshal {
+  constant uint* arguments;
+  device uint& filled_size;
+  device DXMTDrawArguments& arguments_out;
+  uint kind;
+  uint value;
+  uint stride;
+  uint limit;
+  uint end_of_command;
+};
+
+enum DXMTStreamOutputMarshalKind : uint {
+  kStreamOutputMarshalReset = 0,
+  kStreamOutputMarshalAdvance = 1,
+  kStreamOutputMarshalAdvanceIndirect = 2,
+  kStreamOutputMarshalDrawAuto = 3,
+};
+
+/* maintains filled size of stream output targets, and generates DrawAuto arguments from it */
+[[vertex]] void so_arguments_marshal(
+    constant DXMTStreamOutputMarshal* tasks [[buffer(0)]]
+) {
+  uint index = 0;
+  for(;;) {
+    constant DXMTStreamOutputMarshal& task = tasks[index];
+
+    switch (task.kind) {
+    case kStreamOutputMarshalReset:
+      task.filled_size = task.value;
+      break;
+    case kStreamOutputMarshalAdvance:
+      task.filled_size = min(ulong(task.filled_size) + ulong(task.value) * task.stride, ulong(task.limit));
+      break;
+    case kStreamOutputMarshalAdvanceIndirect:
+      /* vertex|index count per instance, then instance count */
+      task.filled_size = min(
+        ulong(task.filled_size) + ulong(task.arguments[0]) * task.arguments[1] * task.stride, ulong(task.limit)
+      );
+      break;
+    case kStreamOutputMarshalDrawAuto: {
+      uint filled_size = task.filled_size;
+      device DXMTDrawArguments& output = task.arguments_out;
+      output.vertex_count = filled_size > task.value ? (filled_size - task.value) / task.stride : 0;
+      output.instance_count = 1;
+      output.vertex_start = 0;
+      output.base_instance = 0;
+      break;
+    }
+    default:
+      break;
+    }
+
+    if (task.end_of_command)
+      break;
+    index++;
+  };
+}
+
 struct depth_stencil_out {
   float depth [[depth(any)]];
   uint stencil [[stencil]]; 
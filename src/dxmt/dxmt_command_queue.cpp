@@ -1,5 +1,7 @@
 #include "dxmt_command_queue.hpp"
 #include "Metal.hpp"
+#include "config/config.hpp"
+#include "dxmt_memory_budget.hpp"
 #include "dxmt_statistics.hpp"
 #include "util_env.hpp"
 #include "util_win32_compat.h"
@@ -15,6 +17,7 @@ CommandChunk::allocate_cpu_heap(size_t size, size_t alignment) {
 }
 
 CommandQueue::CommandQueue(WMT::Device device) :
+    dynamic_buffer_ring_(device),
     encodeThread([this]() { this->EncodingThread(); }),
     finishThread([this]() { this->WaitForFinishThread(); }),
     device(device),
@@ -41,6 +44,14 @@ CommandQueue::CommandQueue(WMT::Device device) :
     chunk.reset();
   };
   event = device.newSharedEvent();
+  CalibrateTimestamps();
+
+  latency_controller_.setEnabled(Config::getInstance().getOption<bool>("dxmt.adaptiveFrameLatency", false));
+
+  auto simulated_budget = Config::getInstance().getOption<int32_t>("dxgi.memoryBudget", 0);
+  MemoryBudget::instance().initBudget(
+      simulated_budget > 0 ? uint64_t(simulated_budget) << 20 : device.recommendedMaxWorkingSetSize()
+  );
 
   std::string env = env::getEnvVar("DXMT_CAPTURE_FRAME");
 
@@ -67,6 +78,7 @@ CommandQueue::~CommandQueue() {
     chunk.reset();
   };
   event_listener_thread.join();
+  Tracer::dump();
   TRACE("Destructed command queue");
 }
 
@@ -85,7 +97,10 @@ CommandQueue::CommitCurrentChunk() {
   ready_for_encode.notify_one();
 
   auto t0 = clock::now();
-  chunk_ongoing.wait(kCommandChunkCount - 1, std::memory_order_acquire);
+  {
+    DXMT_TRACE_SCOPE("CommitCurrentChunk::wait", chunk_id);
+    chunk_ongoing.wait(kCommandChunkCount - 1, std::memory_order_acquire);
+  }
   chunk_ongoing.fetch_add(1, std::memory_order_relaxed);
   auto t1 = clock::now();
   statistics.commit_interval += (t1 - t0);
@@ -95,10 +110,14 @@ CommandQueue::CommitCurrentChunk() {
 #endif
 
   cpu_command_allocator.free_blocks(cpu_coherent.signaledValue());
+
+  if (UpdateMemoryBudget() && budget_change_listener_)
+    budget_change_listener_();
 }
 
 void
 CommandQueue::CommitChunkInternal(CommandChunk &chunk, uint64_t seq) {
+  DXMT_TRACE_SCOPE("CommitChunkInternal", seq);
 
   auto pool = WMT::MakeAutoreleasePool();
 
@@ -141,13 +160,15 @@ CommandQueue::CommitChunkInternal(CommandChunk &chunk, uint64_t seq) {
   cmdbuf.commit();
 
   ready_for_commit.fetch_add(1, std::memory_order_release);
-  ready_for_commit.notify_one();
+  // the finish thread and WaitEncoded() may both wait on it
+  ready_for_commit.notify_all();
 }
 
 uint32_t
 CommandQueue::EncodingThread() {
 #if ASYNC_ENCODING
   env::setThreadName("dxmt-encode-thread");
+  Tracer::setThreadName("dxmt-encode-thread");
   SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
   uint64_t internal_seq = 1;
   while (!stopped.load()) {
@@ -167,14 +188,17 @@ CommandQueue::EncodingThread() {
 uint32_t
 CommandQueue::WaitForFinishThread() {
   env::setThreadName("dxmt-finish-thread");
+  Tracer::setThreadName("dxmt-finish-thread");
   SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
   uint64_t internal_seq = 1;
+  GpuBusyTracker gpu_busy_tracker;
   while (!stopped.load()) {
     ready_for_commit.wait(internal_seq, std::memory_order_acquire);
     if (stopped.load())
       break;
     auto &chunk = chunks[internal_seq % kCommandChunkCount];
     if (chunk.attached_cmdbuf.status() <= WMTCommandBufferStatusScheduled) {
+      DXMT_TRACE_SCOPE("waitUntilCompleted", internal_seq);
       chunk.attached_cmdbuf.waitUntilCompleted();
     }
     if (chunk.attached_cmdbuf.status() == WMTCommandBufferStatusError) {
@@ -186,6 +210,9 @@ CommandQueue::WaitForFinishThread() {
       }
     }
 
+    auto gpu_busy = gpu_busy_tracker.add(chunk.attached_cmdbuf.gpuStartTime(), chunk.attached_cmdbuf.gpuEndTime());
+    statistics.at(chunk.frame_).gpu_busy_interval += std::chrono::nanoseconds(gpu_busy);
+
     if (chunk.signal_frame_latency_fence_ != ~0ull)
       frame_latency_fence_.signal(chunk.signal_frame_latency_fence_);
 
@@ -197,6 +224,7 @@ CommandQueue::WaitForFinishThread() {
     staging_allocator.free_blocks(internal_seq);
     copy_temp_allocator.free_blocks(internal_seq);
     argbuf_allocator.free_blocks(internal_seq);
+    reftracker_storage_allocator.free_blocks(internal_seq);
 
     internal_seq++;
   }
@@ -204,6 +232,63 @@ CommandQueue::WaitForFinishThread() {
   return 0;
 }
 
+void
+CommandQueue::CollectResourceStatistics(FrameStatistics &statistics) {
+  RingBumpStatistics heaps[] = {
+      staging_allocator.statistics(),           copy_temp_allocator.statistics(),
+      argbuf_allocator.statistics(),            initializer.heapStatistics(),
+      cpu_command_allocator.statistics(),       reftracker_storage_allocator.statistics(),
+  };
+  uint64_t blocks_recycled = 0;
+  for (auto &heap : heaps) {
+    statistics.heap_bytes_live += heap.bytes_live;
+    statistics.heap_bytes_pooled += heap.bytes_pooled;
+    blocks_recycled += heap.blocks_recycled;
+  }
+  statistics.heap_blocks_recycled = blocks_recycled - heap_blocks_recycled_;
+  heap_blocks_recycled_ = blocks_recycled;
+
+  auto texture_view_created = TextureView::createdCount();
+  statistics.texture_view_created = texture_view_created - texture_view_created_;
+  texture_view_created_ = texture_view_created;
+
+  auto initializer_statistics = initializer.statistics();
+  statistics.init_bytes_elided = initializer_statistics.bytes_elided - initializer_statistics_.bytes_elided;
+  statistics.init_batches = initializer_statistics.batches - initializer_statistics_.batches;
+  statistics.init_clears_merged = initializer_statistics.clears_merged - initializer_statistics_.clears_merged;
+  initializer_statistics_ = initializer_statistics;
+}
+
+bool
+CommandQueue::UpdateMemoryBudget() {
+  // host heaps are left out, they are not video memory
+  RingBumpStatistics heaps[] = {
+      staging_allocator.statistics(),
+      copy_temp_allocator.statistics(),
+      argbuf_allocator.statistics(),
+      initializer.heapStatistics(),
+  };
+  uint64_t video_memory_bytes = 0;
+  for (auto &heap : heaps)
+    video_memory_bytes += heap.bytes_live + heap.bytes_pooled;
+
+  auto &budget = MemoryBudget::instance();
+  budget.set(MemoryCategory::Heap, video_memory_bytes);
+  budget.update();
+  // another queue may have observed the change first
+  auto generation = budget.generation();
+  bool changed = generation != budget_generation_;
+  budget_generation_ = generation;
+  if (budget.underPressure()) {
+    // host heaps are not trimmed, they are not video memory and not all of them are thread-safe
+    staging_allocator.trim();
+    copy_temp_allocator.trim();
+    argbuf_allocator.trim();
+    initializer.trimHeap();
+  }
+  return changed;
+}
+
 void CommandQueue::Retain(uint64_t seq, Allocation* allocation) {
   auto &chunk = chunks[seq % kCommandChunkCount];
   auto &tracker = chunk.ref_tracker;
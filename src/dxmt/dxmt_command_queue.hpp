@@ -6,10 +6,13 @@
 #include "dxmt_command.hpp"
 #include "dxmt_command_list.hpp"
 #include "dxmt_context.hpp"
+#include "dxmt_dynamic.hpp"
+#include "dxmt_frame_latency.hpp"
 #include "dxmt_occlusion_query.hpp"
 #include "dxmt_resource_initializer.hpp"
 #include "dxmt_ring_bump_allocator.hpp"
 #include "dxmt_statistics.hpp"
+#include "dxmt_trace.hpp"
 #include "log/log.hpp"
 #include "thread.hpp"
 #include "util_cpu_fence.hpp"
@@ -17,6 +20,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <functional>
 #include <span>
 
 namespace dxmt {
@@ -91,12 +95,16 @@ public:
       chunk_id,
       frame_
     );
+    DXMT_TRACE_SCOPE("CommandChunk::encode", chunk_id);
     auto& statistics = enc.currentFrameStatistics();
     auto t0 = clock::now();
     list_enc.execute(enc);
     attached_cmdbuf = cmdbuf;
     auto t1 = clock::now();
-    readback = enc.flushCommands(cmdbuf, chunk_id, chunk_event_id);
+    {
+      DXMT_TRACE_SCOPE("flushCommands", chunk_id);
+      readback = enc.flushCommands(cmdbuf, chunk_id, chunk_event_id);
+    }
     auto t2 = clock::now();
     statistics.encode_prepare_interval += (t1 - t0);
     statistics.encode_flush_interval += (t2 - t1);
@@ -147,10 +155,15 @@ private:
   CpuFence frame_latency_fence_;
   std::atomic_bool stopped;
 
+  // outlives the chunks, which may hold the last reference to a ring name
+  DynamicBufferRing dynamic_buffer_ring_;
   std::array<CommandChunk, kCommandChunkCount> chunks;
   uint64_t encoder_seq = 1;
   uint64_t frame_count = 0;
   uint32_t max_latency_ = 3;
+  uint32_t effective_latency_ = 3;
+  FrameLatencyController latency_controller_;
+  clock::time_point last_present_boundary_{};
 
   dxmt::thread encodeThread;
   dxmt::thread finishThread;
@@ -171,7 +184,26 @@ private:
   RingBumpState<StagingBufferBlockAllocator, kCommandChunkGPUHeapSize> argbuf_allocator;
   RingBumpState<HostBufferBlockAllocator, kCommandChunkCPUHeapSize, dxmt::null_mutex> cpu_command_allocator;
   RingBumpState<HostBufferBlockAllocator, 0x1000 /* 4kB */> reftracker_storage_allocator;
+  uint64_t heap_blocks_recycled_ = 0;
+  uint64_t texture_view_created_ = 0;
+  ResourceInitializerStatistics initializer_statistics_;
   CaptureState capture_state;
+  TimestampCalibration timestamp_calibration_;
+
+  void CollectResourceStatistics(FrameStatistics &statistics);
+
+  /**
+   * \brief Reevaluates memory pressure, trims idle heaps under pressure
+   *
+   * Called whenever a command chunk is committed, so that applications
+   * which never present are covered as well.
+   *
+   * \return Whether the pressure state has changed since the last call
+   */
+  bool UpdateMemoryBudget();
+
+  std::function<void()> budget_change_listener_;
+  uint64_t budget_generation_ = 0;
 
 public:
   InternalCommandLibrary cmd_library;
@@ -236,27 +268,123 @@ public:
     return statistics.at(frame_count);
   }
 
+  /**
+  Samples the GPU and CPU clock, returns the current timestamp epoch.
+  Timestamps taken in different epochs are disjoint.
+  */
+  uint64_t
+  CalibrateTimestamps() {
+    uint64_t cpu_timestamp, gpu_timestamp;
+    device.sampleTimestamps(cpu_timestamp, gpu_timestamp);
+    return timestamp_calibration_.calibrate(cpu_timestamp, gpu_timestamp);
+  }
+
+  uint64_t
+  TimestampFrequency() {
+    if (!argument_encoding_ctx.timestampInGpuTicks())
+      return TimestampCalibration::kDefaultFrequency;
+    return timestamp_calibration_.frequency();
+  }
+
+  bool
+  TimestampDisjoint(uint64_t begin_epoch, uint64_t end_epoch) {
+    if (!argument_encoding_ctx.timestampInGpuTicks())
+      return false;
+    return begin_epoch != end_epoch;
+  }
+
   void
   PresentBoundary() {
+    DXMT_TRACE_SCOPE("PresentBoundary", frame_count + 1);
+    CalibrateTimestamps();
+    CollectResourceStatistics(statistics.at(frame_count));
+    auto now = clock::now();
+    if (last_present_boundary_.time_since_epoch().count())
+      statistics.at(frame_count).present_interval = now - last_present_boundary_;
+    last_present_boundary_ = now;
     statistics.compute(frame_count);
     frame_count++;
     statistics.at(frame_count).reset();
-    // After present N-th frame (N starts from 1), wait for (N - max_latency)-th frame to finish rendering 
-    if (likely(frame_count > max_latency_)) {
+    uint32_t latency = latency_controller_.enabled() ? effective_latency_ : max_latency_;
+    // After present N-th frame (N starts from 1), wait for (N - latency)-th frame to finish rendering 
+    if (likely(frame_count > latency)) {
       auto t0 = clock::now();
-      frame_latency_fence_.wait(frame_count - max_latency_);
+      frame_latency_fence_.wait(frame_count - latency);
       auto t1 = clock::now();
       statistics.at(frame_count).present_latency_interval += (t1 - t0);
+      // the waited frame has completed, so its GPU time is final
+      if (latency_controller_.enabled() && latency < kFrameStatisticsCount)
+        effective_latency_ = latency_controller_.update(statistics.at(frame_count - latency), latency, max_latency_);
     }
-    statistics.at(frame_count).latency = max_latency_;
+    statistics.at(frame_count).latency = latency;
   }
 
   uint32_t GetMaxLatency() { return max_latency_; }
 
-  void SetMaxLatency(uint32_t value) { max_latency_ = value; };
+  void SetMaxLatency(uint32_t value) {
+    max_latency_ = value;
+    effective_latency_ = value;
+  };
+
+  /**
+   * \brief Frame latency currently in effect
+   *
+   * Same as \c GetMaxLatency() unless the adaptive latency controller is
+   * enabled, in which case it's never above it.
+   */
+  uint32_t
+  GetEffectiveLatency() {
+    return latency_controller_.enabled() ? effective_latency_ : max_latency_;
+  }
+
+  bool
+  AdaptiveLatencyEnabled() {
+    return latency_controller_.enabled();
+  }
+
+  DynamicBufferRing &
+  GetDynamicBufferRing() {
+    return dynamic_buffer_ring_;
+  }
+
+  /**
+   * \brief Sets the callback invoked when the memory pressure state changes
+   *
+   * It's invoked on the thread committing command chunks, it should signal
+   * the budget change notification events of the adapter.
+   */
+  void
+  SetMemoryBudgetListener(std::function<void()> &&listener) {
+    budget_change_listener_ = std::move(listener);
+  }
+
+  /**
+   * \brief Whether a committed command chunk has been encoded
+   */
+  bool
+  IsEncoded(uint64_t seq) {
+    return ready_for_commit.load(std::memory_order_acquire) > seq;
+  }
+
+  /**
+   * \brief Waits until a committed command chunk is encoded
+   *
+   * After that, GPU accesses recorded by the encoder thread for that chunk
+   * and every earlier one are visible.
+   */
+  void
+  WaitEncoded(uint64_t seq) {
+    DXMT_TRACE_SCOPE("WaitEncoded", seq);
+    auto encoded = ready_for_commit.load(std::memory_order_acquire);
+    while (encoded <= seq) {
+      ready_for_commit.wait(encoded, std::memory_order_acquire);
+      encoded = ready_for_commit.load(std::memory_order_acquire);
+    }
+  }
 
   void
   WaitCPUFence(uint64_t seq) {
+    DXMT_TRACE_SCOPE("WaitCPUFence", seq);
     cpu_coherent.wait(seq);
   };
 
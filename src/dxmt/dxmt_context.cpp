@@ -5,8 +5,10 @@
 #include "dxmt_format.hpp"
 #include "dxmt_occlusion_query.hpp"
 #include "dxmt_presenter.hpp"
+#include "dxmt_trace.hpp"
 #include "wsi_platform.hpp"
 #include <cstdint>
+#include <cstring>
 #include <cfloat>
 
 namespace dxmt {
@@ -19,6 +21,7 @@ ArgumentEncodingContext::ArgumentEncodingContext(CommandQueue &queue, WMT::Devic
     mv_scale_cmd(device, lib, *this),
     tile_barrier_cmd(device, lib, *this),
     timestamp_state_(device),
+    visibility_result_heap_pool_(device),
     device_(device),
     queue_(queue) {
   dummy_sampler_info_.support_argument_buffers = true;
@@ -103,52 +106,69 @@ ArgumentEncodingContext::encodeVertexBuffers(uint32_t slot_mask, uint64_t offset
 
 template void ArgumentEncodingContext::encodeConstantBuffers<PipelineStage::Vertex, PipelineKind::Ordinary>(
     const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers,
-    uint64_t argument_buffer_offset
+    uint64_t argument_buffer_offset, uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeConstantBuffers<PipelineStage::Pixel, PipelineKind::Ordinary>(
     const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers,
-    uint64_t argument_buffer_offset
+    uint64_t argument_buffer_offset, uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeConstantBuffers<PipelineStage::Vertex, PipelineKind::Tessellation>(
     const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers,
-    uint64_t argument_buffer_offset
+    uint64_t argument_buffer_offset, uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeConstantBuffers<PipelineStage::Pixel, PipelineKind::Tessellation>(
     const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers,
-    uint64_t argument_buffer_offset
+    uint64_t argument_buffer_offset, uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeConstantBuffers<PipelineStage::Hull, PipelineKind::Tessellation>(
     const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers,
-    uint64_t argument_buffer_offset
+    uint64_t argument_buffer_offset, uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeConstantBuffers<PipelineStage::Domain, PipelineKind::Tessellation>(
     const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers,
-    uint64_t argument_buffer_offset
+    uint64_t argument_buffer_offset, uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeConstantBuffers<PipelineStage::Compute, PipelineKind::Ordinary>(
     const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers,
-    uint64_t argument_buffer_offset
+    uint64_t argument_buffer_offset, uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeConstantBuffers<PipelineStage::Vertex, PipelineKind::Geometry>(
     const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers,
-    uint64_t argument_buffer_offset
+    uint64_t argument_buffer_offset, uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeConstantBuffers<PipelineStage::Geometry, PipelineKind::Geometry>(
     const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers,
-    uint64_t argument_buffer_offset
+    uint64_t argument_buffer_offset, uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeConstantBuffers<PipelineStage::Pixel, PipelineKind::Geometry>(
     const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers,
-    uint64_t argument_buffer_offset
+    uint64_t argument_buffer_offset, uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 
 template <PipelineStage stage, PipelineKind kind>
 void
-ArgumentEncodingContext::encodeConstantBuffers(const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT * constant_buffers, uint64_t offset) {
+ArgumentEncodingContext::encodeConstantBuffers(
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers, uint64_t offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
+) {
   uint64_t *encoded_buffer = getMappedArgumentBuffer<uint64_t, stage == PipelineStage::Compute>(offset);
+  bool incremental = base_offset != kArgumentTableNoBase;
+
+  if (incremental) {
+    memcpy(
+        encoded_buffer, getMappedArgumentBuffer<uint64_t, stage == PipelineStage::Compute>(base_offset),
+        reflection->NumConstantBuffers << 3
+    );
+  }
+
+  auto &statistics = currentFrameStatistics();
+  statistics.argument_table_encoded++;
+  statistics.argument_table_bytes += reflection->NumConstantBuffers << 3;
 
   for (unsigned i = 0; i < reflection->NumConstantBuffers; i++) {
     auto &arg = constant_buffers[i];
+    if (incremental && !(dirty_mask.constant_buffer & (1ull << arg.SM50BindingSlot)))
+      continue;
     auto slot = 14 * unsigned(stage) + arg.SM50BindingSlot;
     switch (arg.Type) {
     case SM50BindingType::ConstantBuffer: {
@@ -170,67 +190,48 @@ ArgumentEncodingContext::encodeConstantBuffers(const MTL_SHADER_REFLECTION *refl
     }
   }
 
-  /* kConstantBufferTableBinding = 29 */
-  if constexpr (stage == PipelineStage::Compute) {
-    auto &cmd = encodeComputeCommand<wmtcmd_compute_setbufferoffset>();
-    cmd.type = WMTComputeCommandSetBufferOffset;
-    cmd.offset = getFinalArgumentBufferOffset<true>(offset);
-    cmd.index = 29;
-  } else {
-    auto &cmd = encodeRenderCommand<wmtcmd_render_setbufferoffset>();
-    cmd.offset = getFinalArgumentBufferOffset(offset);
-    cmd.index = 29;
-    if constexpr (stage == PipelineStage::Vertex) {
-      if constexpr (kind == PipelineKind::Geometry)
-        cmd.type = WMTRenderCommandSetObjectBufferOffset;
-      else if constexpr (kind == PipelineKind::Tessellation) {
-        cmd.type = WMTRenderCommandSetObjectBufferOffset;
-        cmd.index = 27;
-      } else
-        cmd.type = WMTRenderCommandSetVertexBufferOffset;
-    } else if constexpr (stage == PipelineStage::Pixel) {
-      cmd.type = WMTRenderCommandSetFragmentBufferOffset;
-    } else if constexpr (stage == PipelineStage::Hull) {
-      cmd.type = WMTRenderCommandSetObjectBufferOffset;
-    } else if constexpr (stage == PipelineStage::Domain) {
-      cmd.type = WMTRenderCommandSetMeshBufferOffset;
-    } else if constexpr (stage == PipelineStage::Geometry) {
-      cmd.type = WMTRenderCommandSetMeshBufferOffset;
-    } else {
-      assert(0 && "Not implemented or unreachable");
-    }
-  }
+  setArgumentTableOffset<stage, kind, true>(offset);
 };
 
 template void ArgumentEncodingContext::encodeShaderResources<PipelineStage::Vertex, PipelineKind::Ordinary>(
-    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeShaderResources<PipelineStage::Pixel, PipelineKind::Ordinary>(
-    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeShaderResources<PipelineStage::Vertex, PipelineKind::Tessellation>(
-    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeShaderResources<PipelineStage::Pixel, PipelineKind::Tessellation>(
-    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeShaderResources<PipelineStage::Hull, PipelineKind::Tessellation>(
-    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeShaderResources<PipelineStage::Domain, PipelineKind::Tessellation>(
-    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeShaderResources<PipelineStage::Compute, PipelineKind::Ordinary>(
-    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeShaderResources<PipelineStage::Vertex, PipelineKind::Geometry>(
-    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeShaderResources<PipelineStage::Geometry, PipelineKind::Geometry>(
-    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 template void ArgumentEncodingContext::encodeShaderResources<PipelineStage::Pixel, PipelineKind::Geometry>(
-    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t argument_buffer_offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 );
 
 inline uint64_t
@@ -241,10 +242,23 @@ TextureMetadata(uint32_t array_length, float min_lod) {
 template <PipelineStage stage, PipelineKind kind>
 void
 ArgumentEncodingContext::encodeShaderResources(
-    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t offset
+    const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments, uint64_t offset,
+    uint64_t base_offset, const ArgumentTableDirtyMask &dirty_mask
 ) {
   auto BindingCount = reflection->NumArguments;
   uint64_t *encoded_buffer = getMappedArgumentBuffer<uint64_t, stage == PipelineStage::Compute>(offset);
+  bool incremental = base_offset != kArgumentTableNoBase;
+
+  if (incremental) {
+    memcpy(
+        encoded_buffer, getMappedArgumentBuffer<uint64_t, stage == PipelineStage::Compute>(base_offset),
+        reflection->ArgumentTableQwords << 3
+    );
+  }
+
+  auto &statistics = currentFrameStatistics();
+  statistics.argument_table_encoded++;
+  statistics.argument_table_bytes += reflection->ArgumentTableQwords << 3;
 
   auto &UAVBindingSet = stage == PipelineStage::Compute ? cs_uav_ : om_uav_;
 
@@ -255,6 +269,8 @@ ArgumentEncodingContext::encodeShaderResources(
       DXMT_UNREACHABLE
     }
     case SM50BindingType::Sampler: {
+      if (incremental && !(dirty_mask.sampler & (1ull << arg.SM50BindingSlot)))
+        break;
       auto slot = 16 * unsigned(stage) + arg.SM50BindingSlot;
       auto &sampler = sampler_[slot].sampler;
       if (!sampler) {
@@ -269,6 +285,11 @@ ArgumentEncodingContext::encodeShaderResources(
       break;
     }
     case SM50BindingType::SRV: {
+      if (incremental) {
+        uint64_t srv_dirty = arg.SM50BindingSlot < 64 ? dirty_mask.srv_lo : dirty_mask.srv_hi;
+        if (!(srv_dirty & (1ull << (arg.SM50BindingSlot & 63))))
+          break;
+      }
       auto slot = 128 * unsigned(stage) + arg.SM50BindingSlot;
       auto &srv = resview_[slot];
 
@@ -359,35 +380,7 @@ ArgumentEncodingContext::encodeShaderResources(
     }
   }
 
-  if constexpr (stage == PipelineStage::Compute) {
-    auto &cmd = encodeComputeCommand<wmtcmd_compute_setbufferoffset>();
-    cmd.type = WMTComputeCommandSetBufferOffset;
-    cmd.offset = getFinalArgumentBufferOffset<true>(offset);
-    cmd.index = 30;
-  } else {
-    auto &cmd = encodeRenderCommand<wmtcmd_render_setbufferoffset>();
-    cmd.offset = getFinalArgumentBufferOffset(offset);
-    cmd.index = 30;
-    if constexpr (stage == PipelineStage::Vertex) {
-      if constexpr (kind == PipelineKind::Geometry)
-        cmd.type = WMTRenderCommandSetObjectBufferOffset;
-      else if constexpr (kind == PipelineKind::Tessellation) {
-        cmd.type = WMTRenderCommandSetObjectBufferOffset;
-        cmd.index = 28;
-      } else
-        cmd.type = WMTRenderCommandSetVertexBufferOffset;
-    } else if constexpr (stage == PipelineStage::Pixel) {
-      cmd.type = WMTRenderCommandSetFragmentBufferOffset;
-    } else if constexpr (stage == PipelineStage::Hull) {
-      cmd.type = WMTRenderCommandSetObjectBufferOffset;
-    } else if constexpr (stage == PipelineStage::Domain) {
-      cmd.type = WMTRenderCommandSetMeshBufferOffset;
-    } else if constexpr (stage == PipelineStage::Geometry) {
-      cmd.type = WMTRenderCommandSetMeshBufferOffset;
-    } else {
-      assert(0 && "Not implemented or unreachable");
-    }
-  }
+  setArgumentTableOffset<stage, kind, false>(offset);
 }
 
 void
@@ -703,10 +696,150 @@ ArgumentEncodingContext::bumpVisibilityResultOffset() {
     } else {
       cmd.mode = WMTVisibilityResultModeCounting;
       cmd.offset = offset << 3;
+      if (offset >= visibility_result_writers_.size())
+        visibility_result_writers_.resize(offset + 1);
+      visibility_result_writers_[offset] = render_encoder->id;
     }
   }
 }
 
+Predication
+ArgumentEncodingContext::checkPredicate(bool deferrable) {
+  if (!predicate_)
+    return predicate_skip_ ? Predication::Skip : Predication::Pass;
+  uint64_t value;
+  if (predicate_->getValue(&value))
+    return bool(value) == predicate_value_ ? Predication::Skip : Predication::Pass;
+  uint64_t begin, end;
+  // results must be written by previous encoders of this command buffer
+  if (deferrable && predicate_->getResultRange(seq_id_, begin, end) &&
+      (encoder_current->type != EncoderType::Render || end <= vro_state_.encoderStartOffset()))
+    return Predication::Deferred;
+  setCompatibilityFlag(FeatureCompatibility::UnsupportedPredication);
+  return Predication::Pass;
+}
+
+AllocatedTempBufferSlice
+ArgumentEncodingContext::encodePredicatedArguments(
+    const std::array<uint32_t, 5> &arguments, uint32_t argument_count
+) {
+  return encodePredicatedArguments({}, 0, argument_count, arguments);
+}
+
+AllocatedTempBufferSlice
+ArgumentEncodingContext::encodePredicatedArguments(
+    WMT::Buffer arguments, uint64_t arguments_va, uint32_t argument_count
+) {
+  return encodePredicatedArguments(arguments, arguments_va, argument_count, {});
+}
+
+AllocatedTempBufferSlice
+ArgumentEncodingContext::encodePredicatedArguments(
+    WMT::Buffer arguments, uint64_t arguments_va, uint32_t argument_count,
+    const std::array<uint32_t, 5> &inline_arguments
+) {
+  uint64_t begin, end;
+  predicate_->getResultRange(seq_id_, begin, end);
+  auto arguments_out = allocateTempBuffer1(argument_count * sizeof(uint32_t), 4);
+  PredicateArgumentsMarshal task{
+      arguments,
+      arguments_va,
+      inline_arguments,
+      argument_count,
+      arguments_out.gpu_buffer,
+      arguments_out.gpu_address + arguments_out.offset,
+      uint32_t(begin),
+      uint32_t(end),
+      predicate_value_
+  };
+
+  // wait for fragment stage of encoders that have written the results
+  FenceSet *wait_fences;
+  EncoderId id;
+  if (encoder_current->type == EncoderType::Render) {
+    auto encoder = static_cast<RenderEncoderData *>(encoder_current);
+    encoder->predicate_marshal_tasks.push_back(std::move(task));
+    wait_fences = &encoder->fence_wait_vertex;
+    id = encoder->encoder_id_vertex;
+  } else {
+    assert(encoder_current->type == EncoderType::Compute);
+    auto encoder = static_cast<ComputeEncoderData *>(encoder_current);
+    encoder->predicate_marshal_tasks.push_back(std::move(task));
+    wait_fences = &encoder->fence_wait;
+    id = encoder->id;
+  }
+  for (auto offset = begin; offset < end; offset++) {
+    auto writer = visibility_result_writers_[offset];
+    if (id - writer < kLane)
+      wait_fences->set(writer);
+  }
+  return arguments_out;
+}
+
+std::pair<WMT::Buffer, uint64_t>
+ArgumentEncodingContext::encodePredicateMarshalTasks(const std::vector<PredicateArgumentsMarshal> &tasks) {
+  struct PREDICATE_MARSHAL_TASK {
+    uint64_t arguments;
+    uint64_t arguments_out;
+    uint32_t inline_arguments[5];
+    uint32_t argument_count;
+    uint32_t use_inline_arguments;
+    uint32_t visibility_begin;
+    uint32_t visibility_end;
+    uint32_t predicate_value;
+    uint32_t end_of_command;
+  };
+  auto task_count = tasks.size();
+  auto [mapped_task_data, task_data_buffer, task_data_buffer_offset] =
+      queue_.AllocateArgumentBuffer(seq_id_, sizeof(PREDICATE_MARSHAL_TASK) * task_count);
+  auto tasks_data = (PREDICATE_MARSHAL_TASK *)mapped_task_data;
+  for (unsigned i = 0; i < task_count; i++) {
+    auto &task = tasks[i];
+    tasks_data[i].arguments = task.arguments_va;
+    tasks_data[i].arguments_out = task.arguments_out_va;
+    std::copy(task.inline_arguments.begin(), task.inline_arguments.end(), tasks_data[i].inline_arguments);
+    tasks_data[i].argument_count = task.argument_count;
+    tasks_data[i].use_inline_arguments = !task.arguments;
+    tasks_data[i].visibility_begin = task.visibility_begin;
+    tasks_data[i].visibility_end = task.visibility_end;
+    tasks_data[i].predicate_value = task.predicate_value;
+    tasks_data[i].end_of_command = 0;
+  }
+  tasks_data[task_count - 1].end_of_command = 1;
+  return {task_data_buffer, task_data_buffer_offset};
+}
+
+void
+ArgumentEncodingContext::encodeStreamOutputMarshal(
+    StreamOutputMarshalKind kind, Rc<Buffer> const &target, uint32_t value, uint32_t stride,
+    WMT::Buffer arguments, uint64_t arguments_va
+) {
+  assert(encoder_current->type == EncoderType::Render);
+  auto encoder = static_cast<RenderEncoderData *>(encoder_current);
+  auto &counter = target->filledSizeCounter();
+  auto [allocation, offset] = access<PipelineStage::Vertex>(counter, 0, sizeof(uint32_t), ResourceAccess::Write);
+  uint32_t limit = std::min<uint64_t>(target->length(), UINT32_MAX);
+  encoder->so_marshal_tasks.push_back(
+      {kind, arguments, arguments_va, allocation->buffer(), allocation->gpuAddress() + offset, {}, 0, value, stride,
+       limit}
+  );
+}
+
+AllocatedTempBufferSlice
+ArgumentEncodingContext::encodeDrawAutoArguments(Rc<Buffer> const &source, uint32_t offset, uint32_t stride) {
+  assert(encoder_current->type == EncoderType::Render);
+  auto encoder = static_cast<RenderEncoderData *>(encoder_current);
+  auto &counter = source->filledSizeCounter();
+  auto [allocation, counter_offset] =
+      access<PipelineStage::Vertex>(counter, 0, sizeof(uint32_t), ResourceAccess::Read);
+  auto arguments_out = allocateTempBuffer1(sizeof(uint32_t) * 4, 4);
+  encoder->so_marshal_tasks.push_back(
+      {StreamOutputMarshalKind::DrawAuto, {}, 0, allocation->buffer(), allocation->gpuAddress() + counter_offset,
+       arguments_out.gpu_buffer, arguments_out.gpu_address + arguments_out.offset, offset, stride, 0}
+  );
+  return arguments_out;
+}
+
 FrameStatistics&
 ArgumentEncodingContext::currentFrameStatistics() {
   return queue_.statistics.at(frame_id_);
@@ -720,10 +853,13 @@ ArgumentEncodingContext::sampleTimestamp(Rc<TimestampQuery> &&query) {
     static_cast<SampleTimestampData *>(encoder_last)->queries.push_back(std::move(query));
     return;
   }
+  auto readback_index = timestamp_state_.addQuery(query.ptr(), frame_id_);
+  if (readback_index == ~0ull)
+    return;
   auto encoder_info = allocate<SampleTimestampData>();
   encoder_info->type = EncoderType::SampleTimestamp;
   encoder_info->id = ~0ull;
-  encoder_info->readback_index = timestamp_state_.addQuery(query.ptr());
+  encoder_info->readback_index = readback_index;
   encoder_info->queries = {};
   encoder_info->queries.push_back(std::move(query));
 
@@ -828,9 +964,10 @@ ArgumentEncodingContext::flushCommands(WMT::CommandBuffer cmdbuf, uint64_t seqId
 
   QueryReadbacks readbacks{};
 
+  visibility_result_writers_.clear();
   if (auto count = vro_state_.reset()) {
     readbacks.visibility = std::make_unique<VisibilityResultReadback>(
-        device_, seqId, count, pending_queries_
+        visibility_result_heap_pool_, seqId, count, pending_queries_
     );
   }
   std::erase_if(pending_queries_, [=](auto &query) -> bool { return query->queryEndAt() == seqId; });
@@ -893,6 +1030,21 @@ ArgumentEncodingContext::flushCommands(WMT::CommandBuffer cmdbuf, uint64_t seqId
         assert(readbacks.visibility);
         render_pass_info.visibility_buffer = readbacks.visibility->visibility_result_heap;
       }
+      if (auto present = data->present_target) {
+        auto &color_data = data->colors[data->present_attachment];
+        auto format = color_data.attachment->allocation->descriptor->pixelFormat(color_data.attachment->key);
+        if (color_data.load_action != WMTLoadActionLoad &&
+            present->presenter->canRenderToDrawable(present->backbuffer, format, present->metadata)) {
+          auto t0 = clock::now();
+          present->drawable = present->presenter->acquireDrawable();
+          present->drawable_acquired = true;
+          currentFrameStatistics().drawable_blocking_interval += (clock::now() - t0);
+          if (present->drawable) {
+            render_pass_info.colors[data->present_attachment].texture = present->drawable.texture();
+            present->direct = true;
+          }
+        }
+      }
       auto gpu_buffer_ = data->allocated_argbuf;
       auto encoder = cmdbuf.renderCommandEncoder(render_pass_info);
       data->fence_wait.forEach(
@@ -917,6 +1069,57 @@ ArgumentEncodingContext::flushCommands(WMT::CommandBuffer cmdbuf, uint64_t seqId
         encoder.setMeshBuffer(gpu_buffer_, 0, 29);
         encoder.setMeshBuffer(gpu_buffer_, 0, 30);
       }
+      if (data->predicate_marshal_tasks.size()) {
+        auto [task_data_buffer, task_data_buffer_offset] =
+            encodePredicateMarshalTasks(data->predicate_marshal_tasks);
+        for (auto &task : data->predicate_marshal_tasks) {
+          if (task.arguments)
+            encoder.useResource(task.arguments, WMTResourceUsageRead, WMTRenderStageVertex);
+          encoder.useResource(task.arguments_out_buffer, WMTResourceUsageWrite, WMTRenderStageVertex);
+        }
+        emulated_cmd.MarshalPredicateArguments(
+            encoder, task_data_buffer, task_data_buffer_offset, readbacks.visibility->visibility_result_heap
+        );
+      }
+      if (data->so_marshal_tasks.size()) {
+        // stream output of predicated draws advances by predicated arguments
+        if (data->predicate_marshal_tasks.size())
+          encoder.memoryBarrier(WMTBarrierScopeBuffers, WMTRenderStageVertex, WMTRenderStageVertex);
+        auto task_count = data->so_marshal_tasks.size();
+        struct SO_MARSHAL_TASK {
+          uint64_t arguments;
+          uint64_t filled_size;
+          uint64_t arguments_out;
+          uint32_t kind;
+          uint32_t value;
+          uint32_t stride;
+          uint32_t limit;
+          uint32_t end_of_command;
+        };
+        auto [mapped_task_data, task_data_buffer, task_data_buffer_offset] =
+            queue_.AllocateArgumentBuffer(seq_id_, sizeof(SO_MARSHAL_TASK) * task_count);
+        auto tasks_data = (SO_MARSHAL_TASK *)mapped_task_data;
+        for (unsigned i = 0; i < task_count; i++) {
+          auto &task = data->so_marshal_tasks[i];
+          tasks_data[i].arguments = task.arguments_va;
+          tasks_data[i].filled_size = task.filled_size_va;
+          tasks_data[i].arguments_out = task.arguments_out_va;
+          tasks_data[i].kind = uint32_t(task.kind);
+          tasks_data[i].value = task.value;
+          tasks_data[i].stride = task.stride;
+          tasks_data[i].limit = task.limit;
+          tasks_data[i].end_of_command = 0;
+          if (task.arguments)
+            encoder.useResource(task.arguments, WMTResourceUsageRead, WMTRenderStageVertex);
+          encoder.useResource(
+              task.filled_size_buffer, WMTResourceUsage(WMTResourceUsageRead | WMTResourceUsageWrite), WMTRenderStageVertex
+          );
+          if (task.arguments_out_buffer)
+            encoder.useResource(task.arguments_out_buffer, WMTResourceUsageWrite, WMTRenderStageVertex);
+        }
+        tasks_data[task_count - 1].end_of_command = 1;
+        emulated_cmd.MarshalStreamOutputArguments(encoder, task_data_buffer, task_data_buffer_offset);
+      }
       if (data->gs_arg_marshal_tasks.size()) {
         auto task_count = data->gs_arg_marshal_tasks.size();
         struct GS_MARSHAL_TASK {
@@ -969,7 +1172,8 @@ ArgumentEncodingContext::flushCommands(WMT::CommandBuffer cmdbuf, uint64_t seqId
         tasks_data[task_count - 1].end_of_command = 1;
         emulated_cmd.MarshalTSDispatchArguments(encoder, task_data_buffer, task_data_buffer_offset);
       }
-      if (data->gs_arg_marshal_tasks.size() > 0 || data->ts_arg_marshal_tasks.size() > 0) {
+      if (data->gs_arg_marshal_tasks.size() > 0 || data->ts_arg_marshal_tasks.size() > 0 ||
+          data->predicate_marshal_tasks.size() > 0 || data->so_marshal_tasks.size() > 0) {
         encoder.memoryBarrier(
             WMTBarrierScopeBuffers, WMTRenderStageVertex,
             WMTRenderStageVertex | WMTRenderStageMesh | WMTRenderStageObject
@@ -981,6 +1185,12 @@ ArgumentEncodingContext::flushCommands(WMT::CommandBuffer cmdbuf, uint64_t seqId
           [&](auto id) { encoder.updateFence(fence_pool_[id], WMTRenderStageFragment); },
           [&](auto id) { encoder.updateFence(fence_pool_[id], WMTRenderStagePreRaster); }
       );
+      if (data->present_target && data->present_target->direct) {
+        // the present pass is elided, later writers of the backbuffer wait on this pass instead
+        data->present_target->fence_update.forEach([&](auto id) {
+          encoder.updateFence(fence_pool_[id], WMTRenderStageFragment);
+        });
+      }
       encoder.endEncoding();
       data->~RenderEncoderData();
       break;
@@ -998,6 +1208,18 @@ ArgumentEncodingContext::flushCommands(WMT::CommandBuffer cmdbuf, uint64_t seqId
       encoder.encodeCommands((const wmtcmd_compute_nop *)&setcmd);
       setcmd.index = 30;
       encoder.encodeCommands((const wmtcmd_compute_nop *)&setcmd);
+      if (data->predicate_marshal_tasks.size()) {
+        auto [task_data_buffer, task_data_buffer_offset] =
+            encodePredicateMarshalTasks(data->predicate_marshal_tasks);
+        for (auto &task : data->predicate_marshal_tasks) {
+          if (task.arguments)
+            encoder.useResource(task.arguments, WMTResourceUsageRead);
+          encoder.useResource(task.arguments_out_buffer, WMTResourceUsageWrite);
+        }
+        emulated_cmd.MarshalPredicateArguments(
+            encoder, task_data_buffer, task_data_buffer_offset, readbacks.visibility->visibility_result_heap
+        );
+      }
       encoder.encodeCommands(&data->cmd_head);
       data->fence_update.forEach([&](auto id) { encoder.updateFence(fence_pool_[id]); });
       encoder.endEncoding();
@@ -1016,22 +1238,39 @@ ArgumentEncodingContext::flushCommands(WMT::CommandBuffer cmdbuf, uint64_t seqId
     }
     case EncoderType::Present: {
       auto data = static_cast<PresentData *>(current);
-      auto t0 = clock::now();
-      auto drawable = data->presenter->encodeCommands(
-          cmdbuf, data->backbuffer, data->metadata,
-          [&](WMT::RenderCommandEncoder encoder) {
-            data->fence_wait.forEach([&](auto id) { encoder.waitForFence(fence_pool_[id], WMTRenderStageFragment); });
-          },
-          [&](WMT::RenderCommandEncoder encoder) {
-            data->fence_update.forEach([&](auto id) { encoder.updateFence(fence_pool_[id], WMTRenderStageFragment); });
-          }
-      );
-      auto t1 = clock::now();
-      currentFrameStatistics().drawable_blocking_interval += (t1 - t0);
+      DXMT_TRACE_SCOPE("EncodePresent", frame_id_);
+      if (!data->drawable_acquired) {
+        auto t0 = clock::now();
+        data->drawable = data->presenter->acquireDrawable();
+        currentFrameStatistics().drawable_blocking_interval += (clock::now() - t0);
+      }
+      if (!data->drawable) {
+        currentFrameStatistics().present_dropped++;
+        // later encoders may still wait on the fences the present pass would have updated
+        auto encoder = cmdbuf.blitCommandEncoder();
+        data->fence_wait.forEach([&](auto id) { encoder.waitForFence(fence_pool_[id]); });
+        data->fence_update.forEach([&](auto id) { encoder.updateFence(fence_pool_[id]); });
+        encoder.endEncoding();
+        data->~PresentData();
+        break;
+      }
+      if (data->direct) {
+        currentFrameStatistics().present_direct++;
+      } else {
+        data->presenter->encodeCommands(
+            cmdbuf, data->drawable, data->backbuffer, data->metadata,
+            [&](WMT::RenderCommandEncoder encoder) {
+              data->fence_wait.forEach([&](auto id) { encoder.waitForFence(fence_pool_[id], WMTRenderStageFragment); });
+            },
+            [&](WMT::RenderCommandEncoder encoder) {
+              data->fence_update.forEach([&](auto id) { encoder.updateFence(fence_pool_[id], WMTRenderStageFragment); });
+            }
+        );
+      }
       if (data->after > 0)
-        cmdbuf.presentDrawableAfterMinimumDuration(drawable, data->after);
+        cmdbuf.presentDrawableAfterMinimumDuration(data->drawable, data->after);
       else
-        cmdbuf.presentDrawable(drawable);
+        cmdbuf.presentDrawable(data->drawable);
       data->~PresentData();
       break;
     }
@@ -1147,13 +1386,7 @@ ArgumentEncodingContext::flushCommands(WMT::CommandBuffer cmdbuf, uint64_t seqId
     case EncoderType::SampleTimestamp: {
       auto data = static_cast<SampleTimestampData *>(current);
       if (auto readback = readbacks.timestamp.get(); readback->sampleBuffer()) {
-
-        /**
-        Since Metal driver may change the execution order of encoders, implement a "barrier" to prevent that
-        FIXME: Not an elegant implementation, should get rid of it when fence-based synchronization is done
-        */
-        barrierOnQueue(cmdbuf);
-
+        // no queue barrier: the sample may be taken slightly out of order, but never stalls the queue
         WMTSampleBufferAttachmentInfo sample_buffer_info{};
         sample_buffer_info.sample_buffer = readback->sampleBuffer();
         sample_buffer_info.start_of_encoder_sample_index = data->readback_index;
@@ -1302,6 +1535,18 @@ ArgumentEncodingContext::checkEncoderRelation(EncoderData *former, EncoderData *
         return DXMT_ENCODER_LIST_OP_SWAP; // carry on (RENDER -> RESOLVE -> RESOLVE -> ...)
       }
     }
+    if (former->type == EncoderType::Render && latter->type == EncoderType::Present) {
+      auto render = reinterpret_cast<RenderEncoderData *>(former);
+      auto present = reinterpret_cast<PresentData *>(latter);
+      // whether the drawable can be used is decided when encoding, since the
+      // load action may still change if an earlier pass is merged into this one
+      auto index = isPresentSignatureMatched(render, present);
+      if (index >= 0) {
+        render->present_target = present;
+        render->present_attachment = index;
+      }
+      return DXMT_ENCODER_LIST_OP_SYNCHRONIZE;
+    }
     return hasDataDependency(latter, former) ? DXMT_ENCODER_LIST_OP_SYNCHRONIZE : DXMT_ENCODER_LIST_OP_SWAP;
   }
 
@@ -1344,8 +1589,22 @@ ArgumentEncodingContext::checkEncoderRelation(EncoderData *former, EncoderData *
         r1->ts_arg_marshal_tasks.end(),
         std::back_inserter(r0->ts_arg_marshal_tasks)
       );
+      // order matters: filled size counters are updated in sequence
+      std::move(
+        r1->so_marshal_tasks.begin(),
+        r1->so_marshal_tasks.end(),
+        std::back_inserter(r0->so_marshal_tasks)
+      );
+      // r1 doesn't wait for r0 (checked above), so its predicates don't read results of r0
+      std::move(
+        r1->predicate_marshal_tasks.begin(),
+        r1->predicate_marshal_tasks.end(),
+        std::back_inserter(r0->predicate_marshal_tasks)
+      );
       r1->gs_arg_marshal_tasks = std::move(r0->gs_arg_marshal_tasks);
       r1->ts_arg_marshal_tasks = std::move(r0->ts_arg_marshal_tasks);
+      r1->so_marshal_tasks = std::move(r0->so_marshal_tasks);
+      r1->predicate_marshal_tasks = std::move(r0->predicate_marshal_tasks);
       r1->use_visibility_result = r0->use_visibility_result || r1->use_visibility_result;
 
       r1->fence_update.merge(r0->fence_update);
@@ -1520,4 +1779,23 @@ ArgumentEncodingContext::isResolveSignatureMatched(RenderEncoderData *render, Re
   return ret;
 }
 
+int
+ArgumentEncodingContext::isPresentSignatureMatched(RenderEncoderData *render, PresentData *present) {
+  if (render->render_target_array_length > 1)
+    return -1;
+  for (unsigned i = 0; i < render->render_target_count; i++) {
+    auto &color = render->colors[i];
+    if (!color.attachment)
+      continue;
+    if (color.attachment->allocation->texture().handle != present->backbuffer.handle)
+      continue;
+    if (color.store_action != WMTStoreActionStore || color.resolve_attachment)
+      return -1;
+    if (color.level != 0 || color.slice != 0 || color.depth_plane != 0)
+      return -1;
+    return i;
+  }
+  return -1;
+}
+
 } // namespace dxmt
\ No newline at end of file
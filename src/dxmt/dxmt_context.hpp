@@ -49,6 +49,15 @@ constexpr unsigned kSRVBindings = 128;
 constexpr unsigned kUAVBindings = 64;
 constexpr unsigned kVertexBufferSlots = 32;
 
+constexpr uint64_t kArgumentTableNoBase = ~0ull;
+
+struct ArgumentTableDirtyMask {
+  uint64_t constant_buffer = 0;
+  uint64_t sampler = 0;
+  uint64_t srv_lo = 0;
+  uint64_t srv_hi = 0;
+};
+
 struct VertexBufferBinding {
   Rc<Buffer> buffer;
   unsigned offset;
@@ -122,6 +131,48 @@ struct TSDispatchArgumentsMarshal {
   uint32_t patch_per_group;
 };
 
+struct PredicateArgumentsMarshal {
+  WMT::Reference<WMT::Buffer> arguments;
+  uint64_t arguments_va;
+  std::array<uint32_t, 5> inline_arguments;
+  uint32_t argument_count;
+  WMT::Buffer arguments_out_buffer;
+  uint64_t arguments_out_va;
+  uint32_t visibility_begin;
+  uint32_t visibility_end;
+  bool predicate_value;
+};
+
+enum class StreamOutputMarshalKind : uint32_t {
+  Reset = 0,
+  Advance = 1,
+  AdvanceIndirect = 2,
+  DrawAuto = 3,
+};
+
+struct StreamOutputArgumentsMarshal {
+  StreamOutputMarshalKind kind;
+  WMT::Reference<WMT::Buffer> arguments;
+  uint64_t arguments_va;
+  WMT::Buffer filled_size_buffer;
+  uint64_t filled_size_va;
+  WMT::Buffer arguments_out_buffer;
+  uint64_t arguments_out_va;
+  uint32_t value;
+  uint32_t stride;
+  uint32_t limit;
+};
+
+enum class Predication {
+  Pass,
+  Skip,
+  /**
+  The result is not available yet, the call should be encoded as an indirect
+  call with arguments from \c encodePredicatedArguments()
+  */
+  Deferred,
+};
+
 struct RenderEncoderColorAttachmentData {
   TextureViewRef attachment;
   enum WMTLoadAction load_action;
@@ -156,6 +207,8 @@ struct RenderEncoderStencilAttachmentData {
   uint8_t clear_stencil;
 };
 
+struct PresentData;
+
 struct RenderEncoderData : EncoderData {
   std::array<RenderEncoderColorAttachmentData, 8> colors;
   RenderEncoderDepthAttachmentData depth;
@@ -166,6 +219,8 @@ struct RenderEncoderData : EncoderData {
   uint32_t render_target_width;
   std::vector<GSDispatchArgumentsMarshal> gs_arg_marshal_tasks;
   std::vector<TSDispatchArgumentsMarshal> ts_arg_marshal_tasks;
+  std::vector<StreamOutputArgumentsMarshal> so_marshal_tasks;
+  std::vector<PredicateArgumentsMarshal> predicate_marshal_tasks;
   wmtcmd_render_nop cmd_head;
   wmtcmd_base *cmd_tail;
   WMT::Buffer allocated_argbuf;
@@ -182,9 +237,16 @@ struct RenderEncoderData : EncoderData {
   bool use_geometry = 0;
   TileBarrierPSOKey tile_barrier_pso_key = {};
   WMT::RenderPipelineState last_pso = {};
+  /**
+   * the present that immediately consumes one of the color attachments, see
+   * \c ArgumentEncodingContext::checkEncoderRelation
+   */
+  PresentData *present_target = nullptr;
+  uint8_t present_attachment = 0;
 };
 
 struct ComputeEncoderData : EncoderData {
+  std::vector<PredicateArgumentsMarshal> predicate_marshal_tasks;
   wmtcmd_compute_nop cmd_head;
   wmtcmd_base *cmd_tail;
   WMT::Buffer allocated_argbuf;
@@ -223,6 +285,16 @@ struct PresentData : EncoderData {
   Rc<Presenter> presenter;
   double after;
   DXMTPresentMetadata metadata;
+  /**
+   * taken early if the preceding render pass may be encoded into it
+   */
+  WMT::Reference<WMT::MetalDrawable> drawable = {};
+  bool drawable_acquired = false;
+  /**
+   * set when the preceding render pass has been encoded into the drawable
+   * directly, so there is nothing left to blit
+   */
+  bool direct = false;
 };
 
 struct SpatialUpscaleData : EncoderData {
@@ -307,15 +379,28 @@ class ArgumentEncodingContext {
 private:
   template <PipelineStage stage> void track(GenericAccessTracker &tracker, int flags);
 
+  AllocatedTempBufferSlice encodePredicatedArguments(
+      WMT::Buffer arguments, uint64_t arguments_va, uint32_t argument_count,
+      const std::array<uint32_t, 5> &inline_arguments
+  );
+
+  std::pair<WMT::Buffer, uint64_t> encodePredicateMarshalTasks(const std::vector<PredicateArgumentsMarshal> &tasks);
+
+  void encodeStreamOutputMarshal(
+      StreamOutputMarshalKind kind, Rc<Buffer> const &target, uint32_t value, uint32_t stride,
+      WMT::Buffer arguments = {}, uint64_t arguments_va = 0
+  );
+
 public:
   template <PipelineStage stage>
   void
   trackBuffer(BufferAllocation *allocation, int flags) {
     retainAllocation(allocation);
+    if (allocation->flags().test(BufferAllocationFlag::CpuMappable))
+      allocation->recordGpuAccess(seq_id_, flags);
     if (allocation->flags().test(BufferAllocationFlag::GpuReadonly))
       return;
-    auto &tracker = allocation->fenceTrackers[allocation->currentSuballocation()];
-    track<stage>(tracker, flags);
+    track<stage>(allocation->currentFenceTracker(), flags);
   }
 
 public:
@@ -464,20 +549,126 @@ public:
     resview_ = {{}};
     om_uav_ = {{}};
     cs_uav_ = {{}};
+    predicate_ = {};
+    predicate_skip_ = false;
+  }
+
+  void
+  setPredicate(Rc<VisibilityResultQuery> &&query, bool value) {
+    predicate_ = std::move(query);
+    predicate_value_ = value;
+    predicate_skip_ = false;
+  }
+
+  /**
+  Set a predicate whose result is already known
+  */
+  void
+  setPredicate(bool skip) {
+    predicate_ = {};
+    predicate_skip_ = skip;
+  }
+
+  /**
+  Evaluates current predicate for a draw or dispatch. If \p deferrable is
+  false (e.g. emulated geometry and tessellation draws), an unavailable
+  result is treated as passed.
+  */
+  Predication checkPredicate(bool deferrable = true);
+
+  /**
+  Queues arguments of a predicated call to be copied into a temporary buffer
+  at the beginning of current encoder, with the first argument zeroed if the
+  predicate fails. Returns the slice to be used as indirect arguments.
+  */
+  AllocatedTempBufferSlice
+  encodePredicatedArguments(const std::array<uint32_t, 5> &arguments, uint32_t argument_count);
+  AllocatedTempBufferSlice
+  encodePredicatedArguments(WMT::Buffer arguments, uint64_t arguments_va, uint32_t argument_count);
+
+  /**
+  Filled size of stream output targets is maintained on GPU, in order, at the
+  beginning of current render encoder. \p stride is the stride of vertices
+  written to \p target. Filled size never advances past the end of \p target.
+  The indirect variant reads vertex (or index) count and instance count from
+  \p arguments.
+  */
+  void
+  resetStreamOutputFilledSize(Rc<Buffer> const &target, uint32_t offset) {
+    encodeStreamOutputMarshal(StreamOutputMarshalKind::Reset, target, offset, 0);
   }
+  void
+  advanceStreamOutputFilledSize(Rc<Buffer> const &target, uint32_t stride, uint32_t vertex_count) {
+    encodeStreamOutputMarshal(StreamOutputMarshalKind::Advance, target, vertex_count, stride);
+  }
+  void
+  advanceStreamOutputFilledSize(
+      Rc<Buffer> const &target, uint32_t stride, WMT::Buffer arguments, uint64_t arguments_va
+  ) {
+    encodeStreamOutputMarshal(StreamOutputMarshalKind::AdvanceIndirect, target, 0, stride, arguments, arguments_va);
+  }
+
+  /**
+  Returns a slice of draw arguments of DrawAuto, the vertex count is
+  (filled size of \p source - \p offset) / \p stride
+  */
+  AllocatedTempBufferSlice encodeDrawAutoArguments(Rc<Buffer> const &source, uint32_t offset, uint32_t stride);
 
   template <PipelineKind kind> void encodeVertexBuffers(uint32_t ia_slot_mask, uint64_t argument_buffer_offset);
+  /**
+  If base_offset is not kArgumentTableNoBase, it's the offset of the table
+  previously encoded for the same shader in current encoder: the table is
+  copied from there and only slots in dirty_mask are encoded again
+   */
   template <PipelineStage stage, PipelineKind kind>
   void encodeConstantBuffers(
       const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *constant_buffers,
-      uint64_t argument_buffer_offset
+      uint64_t argument_buffer_offset, uint64_t base_offset = kArgumentTableNoBase,
+      const ArgumentTableDirtyMask &dirty_mask = {}
   );
   template <PipelineStage stage, PipelineKind kind>
   void encodeShaderResources(
       const MTL_SHADER_REFLECTION *reflection, const MTL_SM50_SHADER_ARGUMENT *arguments,
-      uint64_t argument_buffer_offset
+      uint64_t argument_buffer_offset, uint64_t base_offset = kArgumentTableNoBase,
+      const ArgumentTableDirtyMask &dirty_mask = {}
   );
 
+  /* kConstantBufferTableBinding = 29, kArgumentBufferBinding = 30 */
+  template <PipelineStage stage, PipelineKind kind, bool ConstantBufferTable>
+  void
+  setArgumentTableOffset(uint64_t offset) {
+    uint32_t index = ConstantBufferTable ? 29 : 30;
+    if constexpr (stage == PipelineStage::Compute) {
+      auto &cmd = encodeComputeCommand<wmtcmd_compute_setbufferoffset>();
+      cmd.type = WMTComputeCommandSetBufferOffset;
+      cmd.offset = getFinalArgumentBufferOffset<true>(offset);
+      cmd.index = index;
+    } else {
+      auto &cmd = encodeRenderCommand<wmtcmd_render_setbufferoffset>();
+      cmd.offset = getFinalArgumentBufferOffset(offset);
+      cmd.index = index;
+      if constexpr (stage == PipelineStage::Vertex) {
+        if constexpr (kind == PipelineKind::Geometry)
+          cmd.type = WMTRenderCommandSetObjectBufferOffset;
+        else if constexpr (kind == PipelineKind::Tessellation) {
+          cmd.type = WMTRenderCommandSetObjectBufferOffset;
+          cmd.index = ConstantBufferTable ? 27 : 28;
+        } else
+          cmd.type = WMTRenderCommandSetVertexBufferOffset;
+      } else if constexpr (stage == PipelineStage::Pixel) {
+        cmd.type = WMTRenderCommandSetFragmentBufferOffset;
+      } else if constexpr (stage == PipelineStage::Hull) {
+        cmd.type = WMTRenderCommandSetObjectBufferOffset;
+      } else if constexpr (stage == PipelineStage::Domain) {
+        cmd.type = WMTRenderCommandSetMeshBufferOffset;
+      } else if constexpr (stage == PipelineStage::Geometry) {
+        cmd.type = WMTRenderCommandSetMeshBufferOffset;
+      } else {
+        assert(0 && "Not implemented or unreachable");
+      }
+    }
+  }
+
   void retainAllocation(Allocation* allocation);
 
   template <PipelineStage stage, PipelineKind kind>
@@ -708,6 +899,11 @@ public:
 
   uint64_t currentFrameId() {return frame_id_;}
 
+  bool
+  timestampInGpuTicks() const {
+    return timestamp_state_.useSampleBuffer();
+  }
+
   CommandQueue& queue() { return queue_;}
 
   void
@@ -783,6 +979,7 @@ private:
     TextureViewRef dst{};
   };
   ResolveSignatureMatchResult isResolveSignatureMatched(RenderEncoderData *former, ResolveEncoderData *latter);
+  int isPresentSignatureMatched(RenderEncoderData *former, PresentData *latter);
 
   std::array<VertexBufferBinding, kVertexBufferSlots> vbuf_;
   Rc<Buffer> ibuf_;
@@ -839,8 +1036,13 @@ private:
   VisibilityResultOffsetBumpState vro_state_;
   std::vector<Rc<VisibilityResultQuery>> pending_queries_;
   unsigned active_visibility_query_count_ = 0;
+  std::vector<EncoderId> visibility_result_writers_;
+  Rc<VisibilityResultQuery> predicate_;
+  bool predicate_value_ = false;
+  bool predicate_skip_ = false;
   Flags<FeatureCompatibility> compatibility_flag_;
   TimestampQueryState timestamp_state_;
+  VisibilityResultHeapPool visibility_result_heap_pool_;
   std::vector<Rc<VisibilityResultQuery> *> deferred_visibility_query_stack_;
 
   WMT::Reference<WMT::Event> barrier_event_;
@@ -0,0 +1,110 @@
+#pragma once
+#include "thread.hpp"
+#include "util_env.hpp"
+#include <chrono>
+#include <functional>
+
+namespace dxmt {
+
+/**
+ * \brief Acquires drawables one present ahead on a dedicated thread
+ *
+ * Every \c request() is expected to be followed by exactly one \c acquire(),
+ * the thread keeps at most one drawable ready for pending requests. \c Drawable
+ * must be default-constructible, movable and convertible to \c bool, a null
+ * drawable from the source (e.g. after the layer's own timeout) is retried.
+ */
+template <typename Drawable> class DrawableAcquirer {
+public:
+  DrawableAcquirer(std::function<Drawable()> &&next_drawable, std::chrono::nanoseconds timeout) :
+      next_drawable_(std::move(next_drawable)),
+      timeout_(timeout) {
+    thread_ = dxmt::thread([this]() { threadFunc(); });
+  }
+
+  ~DrawableAcquirer() {
+    {
+      std::unique_lock<dxmt::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+  }
+
+  DrawableAcquirer(const DrawableAcquirer &) = delete;
+  DrawableAcquirer &operator=(const DrawableAcquirer &) = delete;
+
+  void
+  request() {
+    {
+      std::unique_lock<dxmt::mutex> lock(mutex_);
+      pending_++;
+    }
+    cond_.notify_all();
+  }
+
+  /**
+   * \brief Takes the drawable for the oldest pending request
+   *
+   * Returns a null drawable if none became available within the timeout. A
+   * drawable rejected by \p is_current is replaced, but only once.
+   */
+  template <typename Predicate>
+  Drawable
+  acquire(Predicate &&is_current) {
+    auto deadline = std::chrono::steady_clock::now() + timeout_;
+    bool retried = false;
+    std::unique_lock<dxmt::mutex> lock(mutex_);
+    while (true) {
+      while (!ready_) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+          pending_--;
+          return {};
+        }
+        cond_.wait_for(lock, deadline - now);
+      }
+      auto drawable = std::move(ready_);
+      ready_ = {};
+      if (!retried && !is_current(drawable)) {
+        retried = true;
+        cond_.notify_all();
+        continue;
+      }
+      pending_--;
+      cond_.notify_all();
+      return drawable;
+    }
+  }
+
+private:
+  void
+  threadFunc() {
+    env::setThreadName("dxmt-drawable-thread");
+    std::unique_lock<dxmt::mutex> lock(mutex_);
+    while (true) {
+      cond_.wait(lock, [this]() { return stop_ || (pending_ && !ready_); });
+      if (stop_)
+        break;
+      lock.unlock();
+      Drawable drawable = next_drawable_();
+      lock.lock();
+      if (drawable) {
+        ready_ = std::move(drawable);
+        cond_.notify_all();
+      }
+    }
+  }
+
+  std::function<Drawable()> next_drawable_;
+  std::chrono::nanoseconds timeout_;
+
+  dxmt::mutex mutex_;
+  dxmt::condition_variable cond_;
+  Drawable ready_ = {};
+  uint32_t pending_ = 0;
+  bool stop_ = false;
+  dxmt::thread thread_;
+};
+
+} // namespace dxmt
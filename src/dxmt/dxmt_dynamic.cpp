@@ -1,11 +1,89 @@
 #include "dxmt_dynamic.hpp"
+#include "dxmt_memory_budget.hpp"
 #include "dxmt_texture.hpp"
+#include "util_math.hpp"
+#include "wsi_platform.hpp"
 
 namespace dxmt {
-DynamicBuffer::DynamicBuffer(Buffer *buffer, Flags<BufferAllocationFlag> flags) :
+
+DynamicBufferRing::~DynamicBufferRing() {
+  if (buffer_)
+    MemoryBudget::instance().track(MemoryCategory::Buffer, -int64_t(kSize));
+  buffer_ = nullptr;
+  if (placed_buffer_) {
+    wsi::aligned_free(placed_buffer_);
+    placed_buffer_ = nullptr;
+  }
+}
+
+bool
+DynamicBufferRing::allocate(uint64_t current_seq_id, uint64_t coherent_seq_id, uint64_t length, uint32_t &suballocation) {
+  std::lock_guard<dxmt::mutex> lock(mutex_);
+  if (unlikely(!buffer_)) {
+    info_.options = WMTResourceHazardTrackingModeUntracked | WMTResourceCPUCacheModeWriteCombined |
+                    WMTResourceStorageModeShared;
+    info_.length = kSize;
+#ifdef __i386__
+    placed_buffer_ = wsi::aligned_malloc(kSize, DXMT_PAGE_SIZE);
+#endif
+    info_.memory.set(placed_buffer_);
+    buffer_ = device_.newBuffer(info_);
+    MemoryBudget::instance().track(MemoryCategory::Buffer, kSize);
+  }
+
+  length = align(length, kGranularity);
+  if (cursor_ + length > kChunkSize) {
+    uint32_t next = current_chunk_;
+    do {
+      next = (next + 1) % kChunkCount;
+      auto &chunk = chunks_[next];
+      if (!chunk.live && chunk.last_used_seq_id <= coherent_seq_id)
+        break;
+    } while (next != current_chunk_);
+    if (next == current_chunk_)
+      return false;
+    current_chunk_ = next;
+    cursor_ = 0;
+  }
+
+  auto &chunk = chunks_[current_chunk_];
+  chunk.live++;
+  chunk.last_used_seq_id = std::max(chunk.last_used_seq_id, current_seq_id);
+  suballocation = (current_chunk_ * kChunkSize + cursor_) / kGranularity;
+  cursor_ += length;
+  return true;
+}
+
+void
+DynamicBufferRing::release(uint32_t suballocation, uint64_t seq_id) {
+  std::lock_guard<dxmt::mutex> lock(mutex_);
+  auto &chunk = chunks_[suballocation * kGranularity / kChunkSize];
+  chunk.live--;
+  chunk.last_used_seq_id = std::max(chunk.last_used_seq_id, seq_id);
+}
+
+Rc<BufferAllocation>
+DynamicBufferRing::createAllocation(Flags<BufferAllocationFlag> flags) {
+  std::lock_guard<dxmt::mutex> lock(mutex_);
+  return new BufferAllocation(buffer_, info_, kGranularity, flags);
+}
+
+void
+DynamicBufferRing::releaseWithAllocation(BufferAllocation *allocation, uint32_t suballocation) {
+  allocation->ring_ = this;
+  allocation->ring_suballocation_ = suballocation;
+}
+
+DynamicBuffer::DynamicBuffer(Buffer *buffer, Flags<BufferAllocationFlag> flags, bool use_ring) :
     buffer(buffer),
     flags_(flags),
-    name_(buffer->current()) {}
+    name_(buffer->current()),
+    use_ring_(use_ring) {}
+
+DynamicBuffer::~DynamicBuffer() {
+  if (ring_name_.ptr() && name_.ptr() == ring_name_.ptr())
+    ring_->releaseWithAllocation(ring_name_.ptr(), name_suballocation_);
+}
 
 void
 DynamicBuffer::incRef() {
@@ -34,6 +112,11 @@ DynamicBuffer::allocate(uint64_t coherent_seq_id) {
     fifo.pop();
     break;
   }
+  // under memory pressure other retired names are released rather than kept
+  if (MemoryBudget::instance().underPressure()) {
+    while (!fifo.empty() && fifo.front().will_free_at <= coherent_seq_id)
+      fifo.pop();
+  }
   if (!ret.ptr())
     ret = buffer->allocate(flags_);
   return ret;
@@ -42,7 +125,9 @@ DynamicBuffer::allocate(uint64_t coherent_seq_id) {
 void
 DynamicBuffer::updateImmediateName(uint64_t current_seq_id, Rc<BufferAllocation> &&allocation, uint32_t suballocation, bool owned_by_command_list) {
   std::lock_guard<dxmt::mutex> lock(mutex_);
-  if (!owned_by_command_list_)
+  if (name_.ptr() == ring_name_.ptr())
+    ring_->release(name_suballocation_, current_seq_id);
+  else if (!owned_by_command_list_)
     fifo.push(QueueEntry{.allocation = std::move(name_), .will_free_at = current_seq_id});
   name_ = std::move(allocation);
   name_suballocation_ = suballocation;
@@ -64,12 +149,27 @@ DynamicBuffer::recycle(uint64_t current_seq_id, Rc<BufferAllocation> &&allocatio
 
 uint32_t
 DynamicBuffer::nextSuballocation() {
-  if (name_->hasSuballocatoin(name_suballocation_ + 1)) {
+  if (name_.ptr() != ring_name_.ptr() && name_->hasSuballocatoin(name_suballocation_ + 1)) {
     return ++name_suballocation_;
   }
   return 0;
 }
 
+bool
+DynamicBuffer::renameToRing(DynamicBufferRing &ring, uint64_t current_seq_id, uint64_t coherent_seq_id) {
+  if (!use_ring_)
+    return false;
+  uint32_t suballocation;
+  if (!ring.allocate(current_seq_id, coherent_seq_id, buffer->length(), suballocation))
+    return false;
+  if (!ring_name_.ptr()) {
+    ring_ = &ring;
+    ring_name_ = ring.createAllocation(flags_);
+  }
+  updateImmediateName(current_seq_id, Rc(ring_name_), suballocation, false);
+  return true;
+}
+
 DynamicLinearTexture::DynamicLinearTexture(Texture *texture, Flags<TextureAllocationFlag> flags) :
     texture(texture),
     flags_(flags),
@@ -102,6 +202,11 @@ DynamicLinearTexture::allocate(uint64_t coherent_seq_id) {
     fifo.pop();
     break;
   }
+  // under memory pressure other retired names are released rather than kept
+  if (MemoryBudget::instance().underPressure()) {
+    while (!fifo.empty() && fifo.front().will_free_at <= coherent_seq_id)
+      fifo.pop();
+  }
   if (!ret.ptr())
     ret = texture->allocate(flags_);
   return ret;
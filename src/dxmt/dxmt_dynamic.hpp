@@ -1,10 +1,80 @@
 #pragma once
 #include "dxmt_buffer.hpp"
 #include "dxmt_texture.hpp"
+#include <array>
 #include <queue>
 
 namespace dxmt {
 
+/**
+ * \brief Ring shared by small dynamic constant buffers
+ *
+ * A discard bumps a cursor inside the current chunk of the ring instead
+ * of renaming the buffer to a dedicated allocation. Unlike transient
+ * uploads, a name stays valid until the buffer is discarded again, so a
+ * chunk is only reused once every name in it has been replaced and the
+ * GPU is done with it. A few long-lived names pin their chunk, not the
+ * whole ring. The Metal buffer is created on first use.
+ */
+class DynamicBufferRing {
+public:
+  static constexpr uint64_t kSize = 0x400000; // 4MB
+  static constexpr uint32_t kChunkSize = 0x10000;
+  static constexpr uint32_t kGranularity = 256;
+  /* larger buffers keep their dedicated allocations */
+  static constexpr uint32_t kMaxBufferLength = 0x1000;
+
+  DynamicBufferRing(WMT::Device device) : device_(device) {}
+  ~DynamicBufferRing();
+
+  /**
+   * \brief Reserves space for one buffer name
+   *
+   * \param suballocation Offset of the reserved space, in granules
+   * \return false if the ring is full
+   */
+  bool allocate(uint64_t current_seq_id, uint64_t coherent_seq_id, uint64_t length, uint32_t &suballocation);
+
+  /**
+   * \brief Gives back a name once it has been replaced
+   *
+   * \param seq_id The last command chunk that may use it
+   */
+  void release(uint32_t suballocation, uint64_t seq_id);
+
+  /**
+   * \brief Creates an allocation that views the whole ring
+   *
+   * Each buffer owns one, a rename into the ring only changes its suballocation.
+   */
+  Rc<BufferAllocation> createAllocation(Flags<BufferAllocationFlag> flags);
+
+  /**
+   * \brief Releases the current name of a destroyed buffer
+   *
+   * Deferred to the destruction of its allocation, after which the GPU
+   * no longer references it.
+   */
+  void releaseWithAllocation(BufferAllocation *allocation, uint32_t suballocation);
+
+private:
+  static constexpr uint32_t kChunkCount = kSize / kChunkSize;
+
+  struct Chunk {
+    uint32_t live = 0;
+    uint64_t last_used_seq_id = 0;
+  };
+
+  dxmt::mutex mutex_;
+  WMT::Device device_;
+  WMT::Reference<WMT::Buffer> buffer_;
+  WMTBufferInfo info_;
+  void *placed_buffer_ = nullptr;
+  std::array<Chunk, kChunkCount> chunks_;
+  uint32_t current_chunk_ = 0;
+  uint32_t cursor_ = 0;
+};
+
 class DynamicBuffer {
 public:
   void incRef();
@@ -14,6 +84,12 @@ public:
   void updateImmediateName(uint64_t current_seq_id, Rc<BufferAllocation> &&allocation, uint32_t suballocation, bool owned_by_command_list);
   void recycle(uint64_t current_seq_id, Rc<BufferAllocation> &&allocation);
   uint32_t nextSuballocation();
+  /**
+   * \brief Renames the buffer into the shared ring
+   *
+   * \return false if the buffer doesn't use the ring or the ring is full
+   */
+  bool renameToRing(DynamicBufferRing &ring, uint64_t current_seq_id, uint64_t coherent_seq_id);
 
   Rc<BufferAllocation>
   immediateName() {
@@ -30,7 +106,8 @@ public:
     return name_->mappedMemory(name_suballocation_);
   }
 
-  DynamicBuffer(Buffer *buffer, Flags<BufferAllocationFlag> flags);
+  DynamicBuffer(Buffer *buffer, Flags<BufferAllocationFlag> flags, bool use_ring = false);
+  ~DynamicBuffer();
 
   struct QueueEntry {
     Rc<BufferAllocation> allocation;
@@ -50,6 +127,10 @@ private:
   Rc<BufferAllocation> name_;
   uint32_t name_suballocation_ = 0;
   bool owned_by_command_list_ = false;
+  bool use_ring_;
+  DynamicBufferRing *ring_ = nullptr;
+  /* never goes into the fifo, the ring reclaims its space */
+  Rc<BufferAllocation> ring_name_;
 };
 
 class DynamicLinearTexture {
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "dxmt_statistics.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace dxmt {
+
+/**
+ * \brief Accumulates the time the GPU spends on overlapping command buffers
+ *
+ * Command buffers of a queue may execute concurrently, so summing their
+ * individual intervals overstates how busy the GPU is. They are fed in
+ * completion order, which is also the order they start in, so only the
+ * part after the latest end seen so far is new.
+ */
+class GpuBusyTracker {
+public:
+  /**
+   * \return The part of [start, end) not covered by an earlier interval
+   */
+  uint64_t
+  add(uint64_t start, uint64_t end) {
+    start = std::max(start, last_end_);
+    last_end_ = std::max(last_end_, end);
+    return end > start ? end - start : 0;
+  }
+
+private:
+  uint64_t last_end_ = 0;
+};
+
+/**
+ * \brief Chooses the frame queue depth at runtime
+ *
+ * Aims at keeping the GPU just barely busy: when the GPU is saturated and
+ * the application is already waiting on it, a deeper queue only adds input
+ * lag, so the depth is reduced. When both the GPU idles and the application
+ * waits from time to time, the pipeline has bubbles that a deeper queue can
+ * absorb, so the depth is increased. A purely CPU-bound application is left
+ * alone since queueing more frames doesn't make it any faster.
+ *
+ * The decision is made over a window of completed frames, so the GPU time
+ * of every sampled frame is final.
+ */
+class FrameLatencyController {
+public:
+  static constexpr uint32_t kWindowSize = 32;
+  static constexpr double kSaturatedUtilization = 0.95;
+  static constexpr double kStarvedUtilization = 0.85;
+  static constexpr double kWaitingRatio = 0.05;
+
+  bool
+  enabled() const {
+    return enabled_;
+  }
+
+  void
+  setEnabled(bool enabled) {
+    enabled_ = enabled;
+  }
+
+  /**
+   * \brief Feeds the statistics of a completed frame
+   *
+   * \param frame Statistics of a frame whose command buffers have all completed
+   * \param current_latency Queue depth in effect
+   * \param max_latency Upper bound set by the application
+   * \return The queue depth to use from now on
+   */
+  uint32_t
+  update(const FrameStatistics &frame, uint32_t current_latency, uint32_t max_latency) {
+    current_latency = std::clamp(current_latency, 1u, std::max(max_latency, 1u));
+    if (frame.present_interval.count() == 0)
+      return current_latency;
+
+    interval_ += frame.present_interval;
+    gpu_busy_ += frame.gpu_busy_interval;
+    cpu_wait_ += frame.present_latency_interval;
+    if (++sampled_ < kWindowSize)
+      return current_latency;
+
+    double interval = interval_.count();
+    double utilization = gpu_busy_.count() / interval;
+    double waiting = cpu_wait_.count() / interval;
+    sampled_ = 0;
+    interval_ = {};
+    gpu_busy_ = {};
+    cpu_wait_ = {};
+
+    if (utilization >= kSaturatedUtilization && waiting >= kWaitingRatio && current_latency > 1)
+      return current_latency - 1;
+    if (utilization < kStarvedUtilization && waiting >= kWaitingRatio && current_latency < max_latency)
+      return current_latency + 1;
+    return current_latency;
+  }
+
+private:
+  bool enabled_ = false;
+  uint32_t sampled_ = 0;
+  clock::duration interval_{};
+  clock::duration gpu_busy_{};
+  clock::duration cpu_wait_{};
+};
+
+} // namespace dxmt
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace dxmt {
+
+enum class MemoryCategory : uint32_t {
+  Buffer,
+  Texture,
+  /* staging, upload, argument and initializer heaps */
+  Heap,
+};
+
+constexpr uint32_t kMemoryCategoryCount = 3;
+
+/**
+ * \brief Accounts memory owned by DXMT against a budget
+ *
+ * Buffer and texture allocations are accounted when they are created and
+ * destroyed, heaps are sampled whenever a command chunk is committed. The
+ * budget is the working set recommended by Metal, unless \c dxgi.memoryBudget
+ * simulates a smaller one.
+ *
+ * Pressure is entered past 90% of the budget and left below 80%, so that
+ * trimming doesn't flip the state back and forth on every frame. Under
+ * pressure, idle pools and retired allocations are released instead of
+ * being kept for reuse.
+ */
+class MemoryBudget {
+public:
+  static MemoryBudget &
+  instance() {
+    static MemoryBudget budget;
+    return budget;
+  }
+
+  void
+  track(MemoryCategory category, int64_t delta) {
+    usage_[uint32_t(category)].fetch_add(uint64_t(delta), std::memory_order_relaxed);
+  }
+
+  void
+  set(MemoryCategory category, uint64_t bytes) {
+    usage_[uint32_t(category)].store(bytes, std::memory_order_relaxed);
+  }
+
+  uint64_t
+  usage(MemoryCategory category) const {
+    return usage_[uint32_t(category)].load(std::memory_order_relaxed);
+  }
+
+  uint64_t
+  totalUsage() const {
+    uint64_t total = 0;
+    for (auto &usage : usage_)
+      total += usage.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  uint64_t
+  budget() const {
+    return budget_.load(std::memory_order_relaxed);
+  }
+
+  void
+  setBudget(uint64_t bytes) {
+    budget_.store(bytes, std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief Sets the budget unless one is set already
+   *
+   * Every device derives the same budget, the first one sticks.
+   */
+  void
+  initBudget(uint64_t bytes) {
+    uint64_t unset = 0;
+    budget_.compare_exchange_strong(unset, bytes, std::memory_order_relaxed);
+  }
+
+  bool
+  underPressure() const {
+    return pressure_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief Counts changes of the pressure state
+   *
+   * Every evaluator compares it against the value it saw last, since only
+   * one of them observes the change in \c update().
+   */
+  uint64_t
+  generation() const {
+    return generation_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief Reevaluates the pressure state against the budget
+   *
+   * \return Whether the state has changed since the last evaluation
+   */
+  bool
+  update() {
+    auto budget = this->budget();
+    if (!budget)
+      return false;
+    auto usage = totalUsage();
+    bool pressure = underPressure() ? usage * 10 > budget * 8 : usage * 10 > budget * 9;
+    if (pressure_.exchange(pressure, std::memory_order_relaxed) == pressure)
+      return false;
+    generation_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+private:
+  std::atomic<uint64_t> usage_[kMemoryCategoryCount] = {};
+  std::atomic<uint64_t> budget_ = 0;
+  std::atomic<bool> pressure_ = false;
+  std::atomic<uint64_t> generation_ = 0;
+};
+
+} // namespace dxmt
@@ -1,11 +1,17 @@
 #pragma once
 
 #include "Metal.hpp"
+#include "config/config.hpp"
+#include "dxmt_timestamp_calibration.hpp"
 #include "rc/util_rc_ptr.hpp"
+#include "thread.hpp"
 #include "wsi_platform.hpp"
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <vector>
 
@@ -18,6 +24,17 @@ public:
     assert(!current_data_is_dirty);
     assert(!~previous_offset);
     within_encoder = true;
+    encoder_start_offset = next_offset;
+  }
+
+  /**
+   * \brief First offset that can be written by current encoder
+   *
+   * Results below it are written by previous encoders.
+   */
+  uint64_t
+  encoderStartOffset() const {
+    return encoder_start_offset;
   }
 
   bool
@@ -77,10 +94,31 @@ private:
   bool current_data_is_dirty = false;
   uint64_t previous_offset = ~0uLL;
   uint64_t next_offset = 0;
+  uint64_t encoder_start_offset = 0;
 };
 
+/**
+ * \brief Occlusion query result, recycled through a pool
+ *
+ * Use \c allocate() instead of \c new, released objects are reset and reused.
+ */
 class VisibilityResultQuery {
 public:
+  static constexpr size_t kPoolCapacity = 4096;
+
+  static VisibilityResultQuery *
+  allocate() {
+    {
+      std::unique_lock<dxmt::mutex> lock(pool_mutex_);
+      if (!pool_.empty()) {
+        auto query = pool_.back();
+        pool_.pop_back();
+        return query;
+      }
+    }
+    return new VisibilityResultQuery();
+  }
+
   void
   incRef() {
     refcount_.fetch_add(1u, std::memory_order_acquire);
@@ -88,7 +126,7 @@ public:
   void
   decRef() {
     if (refcount_.fetch_sub(1u, std::memory_order_release) == 1u)
-      delete this;
+      recycle(this);
   }
 
   void
@@ -113,17 +151,29 @@ public:
     return seq_id_end;
   };
 
+  /**
+   * \brief Gets the result range if the query begins and ends in \p seqId
+   */
+  bool
+  getResultRange(uint64_t seqId, uint64_t &begin, uint64_t &end) {
+    if (seq_id_begin != seqId || seq_id_end != seqId)
+      return false;
+    begin = occlusion_counter_begin;
+    end = occlusion_counter_end;
+    return true;
+  }
+
+  /**
+   * \param prefixSum inclusive-exclusive prefix sum of results, \p numResults + 1 elements
+   */
   void
-  issue(uint64_t seqId, uint64_t const *readbackBuffer, unsigned numResults) {
+  issue(uint64_t seqId, uint64_t const *prefixSum, uint64_t numResults) {
     assert(seqId >= seq_id_begin);
     assert(seqId <= seq_id_end);
-    uint64_t const *start = seqId == seq_id_begin ? readbackBuffer + occlusion_counter_begin : readbackBuffer;
-    uint64_t const *end = seqId == seq_id_end ? readbackBuffer + occlusion_counter_end : readbackBuffer + numResults;
+    uint64_t start = seqId == seq_id_begin ? occlusion_counter_begin : 0;
+    uint64_t end = seqId == seq_id_end ? occlusion_counter_end : numResults;
     assert(start <= end);
-    while (start != end) {
-      accumulated_value_ += *start;
-      start++;
-    }
+    accumulated_value_ += prefixSum[end] - prefixSum[start];
     seq_id_issued = seqId;
   }
 
@@ -154,31 +204,138 @@ private:
   uint64_t occlusion_counter_end = ~0uLL;
   uint64_t seq_id_issued = 0;
   std::atomic<uint32_t> refcount_ = {0u};
+
+  static void
+  recycle(VisibilityResultQuery *query) {
+    query->reset();
+    {
+      std::unique_lock<dxmt::mutex> lock(pool_mutex_);
+      if (pool_.size() < kPoolCapacity) {
+        pool_.push_back(query);
+        return;
+      }
+    }
+    delete query;
+  }
+
+  static inline dxmt::mutex pool_mutex_;
+  static inline std::vector<VisibilityResultQuery *> pool_;
+};
+
+struct VisibilityResultHeap {
+  WMTBufferInfo info;
+  WMT::Reference<WMT::Buffer> buffer;
+  uint64_t capacity;
+
+  ~VisibilityResultHeap() {
+#ifdef __i386__
+    wsi::aligned_free(info.memory.get());
+#endif
+  }
+};
+
+/**
+ * \brief Recycles visibility result heaps
+ *
+ * New heaps are sized to cover the peak demand of recent command buffers.
+ * Released heaps much larger than that are destroyed, so the pool shrinks
+ * again after a burst of queries.
+ */
+class VisibilityResultHeapPool {
+public:
+  static constexpr uint64_t kMinimalCapacity = 256;
+  static constexpr uint64_t kDemandWindow = 64;
+  static constexpr size_t kMaxPooledHeaps = 8;
+
+  VisibilityResultHeapPool(WMT::Device device) : device_(device) {}
+
+  std::unique_ptr<VisibilityResultHeap>
+  acquire(uint64_t num_results) {
+    std::unique_ptr<VisibilityResultHeap> heap;
+    uint64_t capacity;
+    {
+      std::unique_lock<dxmt::mutex> lock(mutex_);
+      window_peak_ = std::max(window_peak_, num_results);
+      demand_ = std::max(demand_, num_results);
+      if (++window_count_ == kDemandWindow) {
+        demand_ = window_peak_;
+        window_peak_ = 0;
+        window_count_ = 0;
+      }
+      auto it = std::find_if(free_.begin(), free_.end(), [=](auto &heap) { return heap->capacity >= num_results; });
+      if (it != free_.end()) {
+        heap = std::move(*it);
+        free_.erase(it);
+      }
+      capacity = targetCapacity();
+    }
+    if (!heap) {
+      heap = std::make_unique<VisibilityResultHeap>();
+      heap->capacity = std::max(capacity, num_results);
+      heap->info.options = WMTResourceHazardTrackingModeUntracked;
+      heap->info.memory.set(nullptr);
+#ifdef __i386__
+      heap->info.memory.set(wsi::aligned_malloc(heap->capacity * sizeof(uint64_t), DXMT_PAGE_SIZE));
+#endif
+      heap->info.length = heap->capacity * sizeof(uint64_t);
+      heap->buffer = device_.newBuffer(heap->info);
+    } else {
+      // results of a previous command buffer
+      memset(heap->info.memory.get(), 0, num_results * sizeof(uint64_t));
+    }
+    return heap;
+  }
+
+  void
+  release(std::unique_ptr<VisibilityResultHeap> &&heap) {
+    std::unique_lock<dxmt::mutex> lock(mutex_);
+    if (heap->capacity > targetCapacity() * 2 || free_.size() >= kMaxPooledHeaps)
+      return;
+    free_.push_back(std::move(heap));
+  }
+
+private:
+  uint64_t
+  targetCapacity() const {
+    return std::bit_ceil(std::max(demand_, kMinimalCapacity));
+  }
+
+  WMT::Device device_;
+  dxmt::mutex mutex_;
+  std::vector<std::unique_ptr<VisibilityResultHeap>> free_;
+  uint64_t demand_ = 0;
+  uint64_t window_peak_ = 0;
+  uint64_t window_count_ = 0;
 };
 
 class VisibilityResultReadback {
 public:
   VisibilityResultReadback(
-      WMT::Device device, uint64_t seq_id, uint64_t num_results, std::vector<Rc<VisibilityResultQuery>> &queries
+      VisibilityResultHeapPool &pool, uint64_t seq_id, uint64_t num_results,
+      std::vector<Rc<VisibilityResultQuery>> &queries
   ) :
       seq_id(seq_id),
       num_results(num_results),
-      queries(queries) {
-        visibility_result_heap_info.options = WMTResourceHazardTrackingModeUntracked;
-        visibility_result_heap_info.memory.set(nullptr);
-#ifdef __i386__
-        visibility_result_heap_info.memory.set(wsi::aligned_malloc(num_results * sizeof(uint64_t), DXMT_PAGE_SIZE));
-#endif
-        visibility_result_heap_info.length = num_results * sizeof(uint64_t);
-        visibility_result_heap = device.newBuffer(visibility_result_heap_info);
-      }
+      queries(queries),
+      pool_(pool) {
+    heap_ = pool.acquire(num_results);
+    visibility_result_heap = heap_->buffer;
+  }
+
+  /**
+   * All queries of the command buffer are resolved at once, from a prefix sum of results
+   */
   ~VisibilityResultReadback() {
-    for (auto query : queries) {
-      query->issue(seq_id, (uint64_t *)visibility_result_heap_info.memory.get(), num_results);
+    // TODO: small_vector opt
+    std::vector<uint64_t> prefix_sum(num_results + 1);
+    auto results = (uint64_t const *)heap_->info.memory.get();
+    prefix_sum[0] = 0;
+    for (uint64_t i = 0; i < num_results; i++)
+      prefix_sum[i + 1] = prefix_sum[i] + results[i];
+    for (auto &query : queries) {
+      query->issue(seq_id, prefix_sum.data(), num_results);
     }
-#ifdef __i386__
-    wsi::aligned_free(visibility_result_heap_info.memory.get());
-#endif
+    pool_.release(std::move(heap_));
   }
 
   VisibilityResultReadback(const VisibilityResultReadback &) = delete;
@@ -187,8 +344,11 @@ public:
   uint64_t seq_id;
   uint64_t num_results;
   std::vector<Rc<VisibilityResultQuery>> queries;
-  WMTBufferInfo visibility_result_heap_info;
-  WMT::Reference<WMT::Buffer> visibility_result_heap;
+  WMT::Buffer visibility_result_heap;
+
+private:
+  VisibilityResultHeapPool &pool_;
+  std::unique_ptr<VisibilityResultHeap> heap_;
 };
 
 /**
@@ -228,51 +388,90 @@ private:
 
 using TimestampQueryList = std::vector<std::pair<Rc<TimestampQuery>, uint64_t>>;
 
-class TimestampReadbackSBuf {
+/**
+ * \brief Timestamp samples of a frame, shared by all command buffers that are in flight
+ *
+ * Resolved once the last command buffer sampling into it has completed. Without
+ * counter sampling support, command buffers fill their samples with `gpuEndTime`.
+ */
+class TimestampSampleBatch {
 public:
-  TimestampReadbackSBuf(
-      WMT::Device device, WMT::CommandBuffer cmdbuf, uint64_t num_samples, TimestampQueryList &&queries
-  ) :
-      queries_(std::move(queries)),
-      num_samples_(num_samples) {
-    sample_buffer_ = device.newCounterSampleBuffer(num_samples, true);
+  // 32kB, the largest counter sample buffer Metal allows
+  static constexpr uint64_t kCapacity = 4096;
+
+  TimestampSampleBatch(WMT::Device device, uint64_t frame_id, bool use_sample_buffer) : frame_id(frame_id) {
+    if (use_sample_buffer)
+      sample_buffer_ = device.newCounterSampleBuffer(kCapacity, true);
   }
 
-  ~TimestampReadbackSBuf() {
-    // TODO: small_vector opt
-    std::vector<uint64_t> results(num_samples_);
-    sample_buffer_.resolveCounterRange(0, num_samples_, results.data(), num_samples_ * sizeof(uint64_t));
-    for (const auto &[query, sample_index] : queries_) {
-      query->issue(results[sample_index]);
+  ~TimestampSampleBatch() {
+    if (!num_samples)
+      return;
+    results_.resize(num_samples);
+    if (sample_buffer_) {
+      sample_buffer_.resolveCounterRange(0, num_samples, results_.data(), num_samples * sizeof(uint64_t));
+      /**
+      Samples aren't guaranteed to be monotonic (MTLCounterErrorValue, or sampled on different GPU cores), but
+      a later issued query should still return a timestamp greater or equal to previous ones, see
+      `TimestampReadback`. Batches resolve in the order they're committed, on the finishing thread.
+      */
+      thread_local uint64_t latest_sample_on_finish_thread = 0;
+      for (auto &result : results_) {
+        if (result == ~0ull || result < latest_sample_on_finish_thread)
+          result = latest_sample_on_finish_thread;
+        else
+          latest_sample_on_finish_thread = result;
+      }
+    }
+    for (const auto &[query, sample_index] : queries) {
+      query->issue(results_[sample_index]);
     }
   }
 
-  TimestampReadbackSBuf(const TimestampReadbackSBuf &) = delete;
-  TimestampReadbackSBuf(TimestampReadbackSBuf &&) = delete;
+  TimestampSampleBatch(const TimestampSampleBatch &) = delete;
+  TimestampSampleBatch(TimestampSampleBatch &&) = delete;
 
   WMT::CounterSampleBuffer
   sampleBuffer() {
     return sample_buffer_;
   };
 
+  void
+  fill(uint64_t sample_start, uint64_t sample_end, uint64_t value) {
+    if (results_.size() < sample_end)
+      results_.resize(sample_end);
+    std::fill(results_.begin() + sample_start, results_.begin() + sample_end, value);
+  }
+
+  bool
+  full() const {
+    return num_samples == kCapacity;
+  }
+
+  uint64_t frame_id;
+  uint64_t num_samples = 0;
+  TimestampQueryList queries;
+
 private:
-  TimestampQueryList queries_;
   WMT::Reference<WMT::CounterSampleBuffer> sample_buffer_;
-  uint64_t num_samples_;
+  // TODO: small_vector opt
+  std::vector<uint64_t> results_;
 };
 
-class TimestampReadbackCBuf {
+class TimestampReadback {
 public:
-  TimestampReadbackCBuf(
-      WMT::Device device, WMT::CommandBuffer cmdbuf, uint64_t num_samples, TimestampQueryList &&queries
+  TimestampReadback(
+      std::shared_ptr<TimestampSampleBatch> &&batch, WMT::CommandBuffer cmdbuf, uint64_t sample_start,
+      uint64_t sample_end
   ) :
-      queries_(std::move(queries)),
-      num_samples_(num_samples),
-      cmdbuf_(cmdbuf) {}
-
-  ~TimestampReadbackCBuf() {
-    // TODO: small_vector opt
-    std::vector<uint64_t> results(num_samples_);
+      batch_(std::move(batch)),
+      cmdbuf_(cmdbuf),
+      sample_start_(sample_start),
+      sample_end_(sample_end) {}
+
+  ~TimestampReadback() {
+    if (batch_->sampleBuffer())
+      return;
     /**
     There is no implicit relationship between `gpuEndTime` and order of commit, but we still want a later issued query
     to return a timestamp greater or equal to previous ones, so check and use maximum.
@@ -282,59 +481,81 @@ public:
     */
     thread_local uint64_t latest_ts_on_finish_thread = 0;
     latest_ts_on_finish_thread = std::max(cmdbuf_.gpuEndTime(), latest_ts_on_finish_thread);
-    std::fill(results.begin(), results.end(), latest_ts_on_finish_thread);
-    for (const auto &[query, sample_index] : queries_) {
-      query->issue(results[sample_index]);
-    }
+    batch_->fill(sample_start_, sample_end_, latest_ts_on_finish_thread);
   }
 
-  TimestampReadbackCBuf(const TimestampReadbackCBuf &) = delete;
-  TimestampReadbackCBuf(TimestampReadbackCBuf &&) = delete;
+  TimestampReadback(const TimestampReadback &) = delete;
+  TimestampReadback(TimestampReadback &&) = delete;
 
   WMT::CounterSampleBuffer
   sampleBuffer() {
-    return {};
+    return batch_->sampleBuffer();
   };
 
 private:
-  TimestampQueryList queries_;
-  uint64_t num_samples_;
+  std::shared_ptr<TimestampSampleBatch> batch_;
   WMT::CommandBuffer cmdbuf_;
+  uint64_t sample_start_;
+  uint64_t sample_end_;
 };
 
-// compile-time: choose a timestamp impl: SBuf (sample buffer) or CBuf (command buffer `gpuEndTime`)
-using TimestampReadback = TimestampReadbackCBuf;
-
 class TimestampQueryState {
 public:
-  TimestampQueryState(WMT::Device device) : device_(device) {}
+  TimestampQueryState(WMT::Device device) : device_(device) {
+    // `gpuEndTime` of command buffers by default, counter sampling is opt-in
+    use_sample_buffer_ = Config::getInstance().getOption<bool>("dxmt.timestampSampleBuffer", false) &&
+                         device.newCounterSampleBuffer(1, true) != nullptr;
+  }
 
+  /**
+   * \returns index of the new sample, or \c ~0ull if the query is coalesced into the last sample
+   */
   uint64_t
-  addQuery(TimestampQuery *query) {
-    queries_.push_back({query, num_samples_});
-    return num_samples_++;
+  addQuery(TimestampQuery *query, uint64_t frame_id) {
+    if (!batch_) {
+      // keep sampling into the batch of this frame while it's still in flight
+      batch_ = in_flight_.lock();
+      if (!batch_ || batch_->frame_id != frame_id || batch_->full())
+        batch_ = std::make_shared<TimestampSampleBatch>(device_, frame_id, use_sample_buffer_);
+      sample_start_ = batch_->num_samples;
+    } else if (batch_->full()) {
+      // out of samples, share the last one
+      batch_->queries.push_back({query, batch_->num_samples - 1});
+      return ~0ull;
+    }
+    batch_->queries.push_back({query, batch_->num_samples});
+    return batch_->num_samples++;
   }
 
   void
   coalesceQuery(TimestampQuery *query) {
-    assert(num_samples_);
-    queries_.push_back({query, num_samples_ - 1});
+    assert(batch_ && batch_->num_samples);
+    batch_->queries.push_back({query, batch_->num_samples - 1});
   }
 
   std::unique_ptr<TimestampReadback>
   flush(WMT::CommandBuffer cmdbuf) {
-    if (num_samples_ == 0)
+    if (!batch_)
       return {};
 
-    auto ret = std::make_unique<TimestampReadback>(device_, cmdbuf, num_samples_, std::move(queries_));
-    num_samples_ = 0;
-    queries_ = {};
-    return ret;
+    in_flight_ = batch_;
+    uint64_t sample_end = batch_->num_samples;
+    return std::make_unique<TimestampReadback>(std::move(batch_), cmdbuf, sample_start_, sample_end);
+  }
+
+  /**
+   * \brief Whether timestamps are GPU ticks, rather than nanoseconds of CPU clock
+   */
+  bool
+  useSampleBuffer() const {
+    return use_sample_buffer_;
   }
 
 private:
-  uint64_t num_samples_ = 0;
-  TimestampQueryList queries_;
+  std::shared_ptr<TimestampSampleBatch> batch_;
+  std::weak_ptr<TimestampSampleBatch> in_flight_;
+  uint64_t sample_start_ = 0;
+  bool use_sample_buffer_;
   WMT::Device device_;
 };
 
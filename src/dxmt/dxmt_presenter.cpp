@@ -8,11 +8,16 @@
 
 namespace dxmt {
 
-Presenter::Presenter(WMT::Device device, WMT::MetalLayer layer, InternalCommandLibrary &lib, float scale_factor, uint8_t sample_count) :
+Presenter::Presenter(
+    WMT::Device device, WMT::MetalLayer layer, InternalCommandLibrary &lib, float scale_factor, uint8_t sample_count,
+    bool discard_backbuffer
+) :
     device_(device),
     layer_(layer),
     lib_(lib),
-    sample_count_(sample_count) {
+    sample_count_(sample_count),
+    discard_backbuffer_(discard_backbuffer),
+    drawable_acquirer_([this]() { return nextDrawable(); }, kDrawableAcquireTimeout) {
   layer_.getProps(layer_props_);
   layer_props_.device = device;
   layer_props_.opaque = true;
@@ -34,6 +39,24 @@ Presenter::Presenter(WMT::Device device, WMT::MetalLayer layer, InternalCommandL
   gamma_lut_texture_ = device.newTexture(texture_info);
 }
 
+WMT::Reference<WMT::MetalDrawable>
+Presenter::nextDrawable() {
+  auto pool = WMT::MakeAutoreleasePool();
+  WMT::Reference<WMT::MetalDrawable> drawable;
+  drawable = layer_.nextDrawable();
+  return drawable;
+}
+
+WMT::Reference<WMT::MetalDrawable>
+Presenter::acquireDrawable() {
+  return drawable_acquirer_.acquire([this](WMT::Reference<WMT::MetalDrawable> &drawable) {
+    // acquired before a resize took effect
+    auto texture = drawable.texture();
+    return texture.width() == (uint64_t)layer_props_.drawable_width &&
+           texture.height() == (uint64_t)layer_props_.drawable_height;
+  });
+}
+
 bool
 Presenter::changeLayerProperties(
     WMTPixelFormat format, WMTColorSpace colorspace, double width, double height, uint8_t sample_count
@@ -147,17 +170,31 @@ Presenter::synchronizeLayerProperties() {
   if (final_colorspace == WMTColorSpaceHDR_scRGB)
     metadata.edr_scale *= 0.8;
 
+  drawable_acquirer_.request();
+
   return {metadata, ++frame_requested_, this};
 }
 
-WMT::MetalDrawable
+bool
+Presenter::canRenderToDrawable(
+    WMT::Texture backbuffer, WMTPixelFormat attachment_format, const DXMTPresentMetadata &metadata
+) {
+  if (!discard_backbuffer_ || !identity_present_)
+    return false;
+  if (metadata.edr_scale != 1.0f)
+    return false;
+  if (attachment_format != layer_props_.pixel_format)
+    return false;
+  return backbuffer.width() == (uint64_t)layer_props_.drawable_width &&
+         backbuffer.height() == (uint64_t)layer_props_.drawable_height;
+}
+
+void
 Presenter::encodeCommands(
-    WMT::CommandBuffer cmdbuf, WMT::Texture backbuffer, DXMTPresentMetadata metadata,
+    WMT::CommandBuffer cmdbuf, WMT::MetalDrawable drawable, WMT::Texture backbuffer, DXMTPresentMetadata metadata,
     std::function<void(WMT::RenderCommandEncoder)> &&wait_fences,
     std::function<void(WMT::RenderCommandEncoder)> &&update_fences
 ) {
-  auto drawable = layer_.nextDrawable();
-
   WMTRenderPassInfo info;
   WMT::InitializeRenderPassInfo(info);
   info.colors[0].load_action = WMTLoadActionDontCare;
@@ -181,8 +218,6 @@ Presenter::encodeCommands(
   encoder.drawPrimitives(WMTPrimitiveTypeTriangle, 0, 3);
   update_fences(encoder);
   encoder.endEncoding();
-
-  return drawable;
 }
 
 constexpr uint32_t kPresentFCIndex_BackbufferSizeMatched = 0x100;
@@ -198,6 +233,9 @@ Presenter::buildRenderPipelineState(bool is_pq, bool with_hdr_metadata, bool is_
 
   auto library = lib_.getLibrary();
 
+  // matches the function constants that make fs_present_quad a plain read
+  identity_present_ = !is_pq && !with_hdr_metadata && !is_ms && !gamma_enable && !Is_sRGBVariant(source_format_);
+
   uint32_t true_data = true, false_data = false;
   WMTFunctionConstant constants[6];
   constants[0].data.set(&true_data);
@@ -1,10 +1,12 @@
 #pragma once
 #include "Metal.hpp"
 #include "dxmt_command.hpp"
+#include "dxmt_drawable_acquirer.hpp"
 #include "rc/util_rc.hpp"
 #include "util_cpu_fence.hpp"
 #include "winemetal.h"
 #include <atomic>
+#include <chrono>
 
 namespace dxmt {
 
@@ -16,6 +18,13 @@ struct DXMTPresentMetadata {
 
 constexpr uint32_t DXMT_GAMMA_CP_COUNT = 1024;
 
+/**
+ * How long the encode thread waits for a drawable before the present is
+ * dropped. Normally one is already acquired ahead of time, so this only
+ * matters when the compositor holds on to every drawable.
+ */
+constexpr std::chrono::milliseconds kDrawableAcquireTimeout{100};
+
 struct DXMTGammaRamp {
   float red[DXMT_GAMMA_CP_COUNT];
   float green[DXMT_GAMMA_CP_COUNT];
@@ -26,7 +35,8 @@ struct DXMTGammaRamp {
 class Presenter : public RcObject {
 public:
   Presenter(
-      WMT::Device device, WMT::MetalLayer layer, InternalCommandLibrary &lib, float scale_factor, uint8_t sample_count
+      WMT::Device device, WMT::MetalLayer layer, InternalCommandLibrary &lib, float scale_factor, uint8_t sample_count,
+      bool discard_backbuffer = false
   );
 
   bool changeLayerProperties(
@@ -65,8 +75,32 @@ public:
 
   PresentState synchronizeLayerProperties();
 
-  WMT::MetalDrawable encodeCommands(
-      WMT::CommandBuffer cmdbuf, WMT::Texture backbuffer, DXMTPresentMetadata metadata,
+  /**
+   * \brief Checks whether the present pass would be an identity copy
+   *
+   * If so, a render pass that fully overwrites the backbuffer right before
+   * present can render into the drawable instead. Only allowed when the
+   * backbuffer content is undefined after present (discard swap effects),
+   * since the backbuffer itself doesn't receive that pass.
+   */
+  bool canRenderToDrawable(WMT::Texture backbuffer, WMTPixelFormat attachment_format, const DXMTPresentMetadata &metadata);
+
+  /**
+   * \brief Takes the drawable for the next present
+   *
+   * Drawables are acquired on a dedicated thread, one present ahead, so
+   * this normally doesn't block. Returns a null reference if none became
+   * available within \c kDrawableAcquireTimeout, in which case the
+   * present should be dropped. Must be called exactly once per
+   * \c synchronizeLayerProperties().
+   */
+  WMT::Reference<WMT::MetalDrawable> acquireDrawable();
+
+  /**
+   * \brief Encodes the present pass into a drawable from \c acquireDrawable()
+   */
+  void encodeCommands(
+      WMT::CommandBuffer cmdbuf, WMT::MetalDrawable drawable, WMT::Texture backbuffer, DXMTPresentMetadata metadata,
       std::function<void(WMT::RenderCommandEncoder)> &&wait_fences,
       std::function<void(WMT::RenderCommandEncoder)> &&update_fences
   );
@@ -74,6 +108,8 @@ public:
 private:
   void buildRenderPipelineState(bool is_pq, bool with_hdr_metadata, bool is_ms, bool gamma_enable);
 
+  WMT::Reference<WMT::MetalDrawable> nextDrawable();
+
   WMT::Device device_;
   WMT::MetalLayer layer_;
   InternalCommandLibrary &lib_;
@@ -92,8 +128,12 @@ private:
   WMT::Reference<WMT::Texture> gamma_lut_texture_;
   WMT::Reference<WMT::RenderPipelineState> present_blit_;
   WMT::Reference<WMT::RenderPipelineState> present_scale_;
+  bool discard_backbuffer_;
+  bool identity_present_ = false;
   std::atomic_flag pso_valid = 0;
   uint64_t frame_requested_ = 0;
   CpuFence frame_presented_ = 0;
+
+  DrawableAcquirer<WMT::Reference<WMT::MetalDrawable>> drawable_acquirer_;
 };
 } // namespace dxmt
\ No newline at end of file
@@ -33,11 +33,12 @@ namespace dxmt {
   }
 
 #define ALLOC_CLEAR(info)                                                                                              \
-  WMTRenderPassInfo *info;                                                                                             \
-  if (!allocateClear(&info)) {                                                                                         \
+  ClearRenderPassInfo *info##_pass;                                                                                    \
+  if (!allocateClear(&info##_pass)) {                                                                                  \
     flushInternal();                                                                                                   \
     continue;                                                                                                          \
-  }
+  }                                                                                                                    \
+  WMTRenderPassInfo *info = &info##_pass->info;
 
 #define ALLOC_GPU(buffer, size)                                                                                        \
   WMT::Buffer buffer;                                                                                                  \
@@ -126,6 +127,11 @@ ResourceInitializer::initDepthStencilWithZero(
       info->stencil.slice = slice;
       info->stencil.level = level;
     }
+    info_pass->sample_count = texture->sampleCount();
+    info_pass->texel_size = MTLGetTexelSize(texture->pixelFormat());
+    info_pass->bytes = uint64_t(width_sub) * height_sub * texture->sampleCount() * info_pass->texel_size;
+    pending_clears_.insert({allocation, info_pass});
+    pending_clear_count_.fetch_add(1, std::memory_order_relaxed);
 
   } while (0);
 
@@ -153,6 +159,15 @@ ResourceInitializer::initRenderTargetWithZero(
     info->colors[0].store_action = WMTStoreActionStore;
     info->colors[0].slice = slice;
     info->colors[0].level = level;
+    info_pass->sample_count = texture->sampleCount();
+    info_pass->texel_size = MTLGetTexelSize(texture->pixelFormat());
+    info_pass->bytes = uint64_t(width_sub) * height_sub * std::max(1u, uint32_t(info->render_target_array_length)) *
+                       texture->sampleCount() * info_pass->texel_size;
+    // covers every depth slice of the level, not matched against views
+    if (texture->textureType() != WMTTextureType3D) {
+      pending_clears_.insert({allocation, info_pass});
+      pending_clear_count_.fetch_add(1, std::memory_order_relaxed);
+    }
 
   } while (0);
 
@@ -390,6 +405,7 @@ ResourceInitializer::flushInternal() {
   encode(cmdbuf);
   cmdbuf.encodeSignalEvent(upload_queue_event_, seq_id);
   cmdbuf.commit();
+  stats_.batches++;
   reset();
   cached_coherent_seq_id = upload_queue_event_.signaledValue();
   gpu_command_heap_allocator.free_blocks(cached_coherent_seq_id);
@@ -425,6 +441,61 @@ ResourceInitializer::reset() {
   blit_cmd_tail = (wmtcmd_base *)&blit_cmd_head;
 
   ref_tracker.clear();
+
+  pending_clears_.clear();
+  pending_clear_count_.store(0, std::memory_order_relaxed);
+}
+
+void
+ResourceInitializer::elideWithClear(TextureAllocation *allocation, TextureViewKey view, uint32_t planar) {
+  if (!pending_clear_count_.load(std::memory_order_relaxed))
+    return;
+
+  auto covered = [&](uint32_t level, uint32_t slice) {
+    return level >= view.mip_start && level < view.mip_end && slice >= view.array_start && slice < view.array_end;
+  };
+
+  std::lock_guard<dxmt::mutex> lock(mutex_);
+  auto [begin, end] = pending_clears_.equal_range(allocation);
+  for (auto itr = begin; itr != end;) {
+    auto pass = itr->second;
+    auto &info = pass->info;
+    if (info.colors[0].texture && covered(info.colors[0].level, info.colors[0].slice))
+      info.colors[0].texture = NULL_OBJECT_HANDLE;
+    if (info.depth.texture && (planar & 1) && covered(info.depth.level, info.depth.slice))
+      info.depth.texture = NULL_OBJECT_HANDLE;
+    if (info.stencil.texture && (planar & 2) && covered(info.stencil.level, info.stencil.slice))
+      info.stencil.texture = NULL_OBJECT_HANDLE;
+    if (info.colors[0].texture || info.depth.texture || info.stencil.texture) {
+      ++itr;
+      continue;
+    }
+    pass->elided = true;
+    stats_.bytes_elided += pass->bytes;
+    pending_clear_count_.fetch_sub(1, std::memory_order_relaxed);
+    itr = pending_clears_.erase(itr);
+  }
+}
+
+void
+ResourceInitializer::keepInitialization(TextureAllocation *allocation) {
+  if (!pending_clear_count_.load(std::memory_order_relaxed))
+    return;
+
+  std::lock_guard<dxmt::mutex> lock(mutex_);
+  auto [begin, end] = pending_clears_.equal_range(allocation);
+  pending_clear_count_.fetch_sub(std::distance(begin, end), std::memory_order_relaxed);
+  pending_clears_.erase(begin, end);
+}
+
+void
+ResourceInitializer::keepAllInitialization() {
+  if (!pending_clear_count_.load(std::memory_order_relaxed))
+    return;
+
+  std::lock_guard<dxmt::mutex> lock(mutex_);
+  pending_clears_.clear();
+  pending_clear_count_.store(0, std::memory_order_relaxed);
 }
 
 void
@@ -432,9 +503,26 @@ ResourceInitializer::encode(WMT::CommandBuffer cmdbuf) {
 
   auto clear_pass = clear_render_pass_head.next;
   while (clear_pass) {
-    auto r = cmdbuf.renderCommandEncoder(clear_pass->info);
-    r.endEncoding();
+    auto pass = clear_pass;
     clear_pass = clear_pass->next;
+    if (pass->elided)
+      continue;
+    // following color clears of the same size are attached to the same pass
+    if (pass->info.colors[0].texture) {
+      unsigned attachments = 1;
+      uint32_t pixel_size = pass->texel_size;
+      for (; clear_pass && attachments < 8; clear_pass = clear_pass->next) {
+        if (clear_pass->elided)
+          continue;
+        if (!mergeable(*pass, attachments, pixel_size, *clear_pass))
+          break;
+        pass->info.colors[attachments++] = clear_pass->info.colors[0];
+        pixel_size += clear_pass->texel_size;
+        stats_.clears_merged++;
+      }
+    }
+    auto r = cmdbuf.renderCommandEncoder(pass->info);
+    r.endEncoding();
   }
 
   if (blit_cmd_head.next.ptr) {
@@ -444,6 +532,31 @@ ResourceInitializer::encode(WMT::CommandBuffer cmdbuf) {
   }
 }
 
+// per-pixel render target storage in tile memory of Apple GPUs
+constexpr uint32_t kMaxRenderTargetPixelSize = 64;
+
+bool
+ResourceInitializer::mergeable(
+    const ClearRenderPassInfo &pass, unsigned attachments, uint32_t pixel_size, const ClearRenderPassInfo &next
+) {
+  auto &info = pass.info;
+  auto &next_info = next.info;
+  if (!next_info.colors[0].texture || next.sample_count != pass.sample_count)
+    return false;
+  if (pixel_size + next.texel_size > kMaxRenderTargetPixelSize)
+    return false;
+  if (next_info.render_target_width != info.render_target_width ||
+      next_info.render_target_height != info.render_target_height ||
+      next_info.render_target_array_length != info.render_target_array_length)
+    return false;
+  // don't attach two subresources of the same texture
+  for (unsigned i = 0; i < attachments; i++) {
+    if (info.colors[i].texture == next_info.colors[0].texture)
+      return false;
+  }
+  return true;
+}
+
 WMT::Buffer
 ResourceInitializer::allocateGpuHeap(size_t size, size_t &offset) {
   auto [block, offset_] = gpu_command_heap_allocator.allocate(
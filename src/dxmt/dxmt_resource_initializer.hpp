@@ -22,6 +22,8 @@
 #include "dxmt_context.hpp"
 #include "dxmt_ring_bump_allocator.hpp"
 #include "dxmt_texture.hpp"
+#include <atomic>
+#include <unordered_map>
 
 namespace dxmt {
 
@@ -32,6 +34,15 @@ constexpr size_t kResourceInitializerChunks = 2;
 
 static_assert(kResourceInitializerChunks > 1);
 
+struct ResourceInitializerStatistics {
+  /* bytes of zero initialization skipped because the first use overwrites them */
+  uint64_t bytes_elided = 0;
+  /* command buffers committed to the upload queue */
+  uint64_t batches = 0;
+  /* clears encoded into the render pass of a previous one */
+  uint64_t clears_merged = 0;
+};
+
 class ResourceInitializer {
 public:
   ResourceInitializer(WMT::Device device);
@@ -50,6 +61,38 @@ public:
       size_t row_pitch, size_t depth_pitch, uint32_t format_flags
   );
 
+  /**
+   * \brief Cancels pending zero initialization made redundant by a clear
+   *
+   * The contents of a resource created without initial data are undefined,
+   * if a full clear of a subresource is recorded before its initialization
+   * is flushed, the initialization is skipped, unless the texture has been
+   * used before the clear. \c planar selects the depth (1) and stencil (2)
+   * planes of a depth stencil texture.
+   */
+  void elideWithClear(TextureAllocation *allocation, TextureViewKey view, uint32_t planar);
+
+  /**
+   * \brief Keeps the pending zero initialization of a texture
+   *
+   * Must be called when the texture is used other than by a clear, e.g.
+   * bound to a draw or the source of a copy, a clear recorded after that can
+   * no longer stand in for the initialization.
+   */
+  void keepInitialization(TextureAllocation *allocation);
+
+  /**
+   * \brief Keeps every pending zero initialization
+   *
+   * For uses that can't be attributed to a texture, e.g. command lists.
+   */
+  void keepAllInitialization();
+
+  bool
+  hasPendingClears() {
+    return pending_clear_count_.load(std::memory_order_relaxed);
+  }
+
   /*
    * Flush pending works and return the event id to wait
    * 0 may be returned, meaning no work to wait
@@ -68,6 +111,22 @@ public:
     return upload_queue_event_;
   }
 
+  RingBumpStatistics
+  heapStatistics() {
+    return gpu_command_heap_allocator.statistics();
+  }
+
+  void
+  trimHeap() {
+    gpu_command_heap_allocator.trim();
+  }
+
+  ResourceInitializerStatistics
+  statistics() {
+    std::lock_guard<dxmt::mutex> lock(mutex_);
+    return stats_;
+  }
+
 private:
   uint64_t flushInternal();
 
@@ -79,6 +138,10 @@ private:
   struct ClearRenderPassInfo {
     WMTRenderPassInfo info;
     ClearRenderPassInfo *next;
+    uint64_t bytes;
+    uint32_t sample_count;
+    uint32_t texel_size;
+    bool elided;
   };
 
   bool
@@ -121,18 +184,25 @@ private:
   }
 
   bool
-  allocateClear(WMTRenderPassInfo **p) {
+  allocateClear(ClearRenderPassInfo **p) {
     if (auto ptr = allocateCpuHeap<ClearRenderPassInfo>()) {
       clear_render_pass_tail->next = ptr;
       clear_render_pass_tail = ptr;
       ptr->next = nullptr;
+      ptr->bytes = 0;
+      ptr->sample_count = 1;
+      ptr->elided = false;
       WMT::InitializeRenderPassInfo(ptr->info);
-      *p = &ptr->info;
+      *p = ptr;
       return true;
     }
     return false;
   }
 
+  bool mergeable(
+      const ClearRenderPassInfo &pass, unsigned attachments, uint32_t pixel_size, const ClearRenderPassInfo &next
+  );
+
   WMT::Buffer allocateGpuHeap(size_t size, size_t &offset);
 
   WMT::Buffer allocateZeroBuffer(size_t size);
@@ -159,6 +229,11 @@ private:
 
   ClearRenderPassInfo clear_render_pass_head;
   ClearRenderPassInfo *clear_render_pass_tail;
+  /* clears not flushed yet, they may still be elided */
+  std::unordered_multimap<TextureAllocation *, ClearRenderPassInfo *> pending_clears_;
+  std::atomic<uint32_t> pending_clear_count_ = 0;
+
+  ResourceInitializerStatistics stats_;
 
   AllocationRefTracking ref_tracker;
 };
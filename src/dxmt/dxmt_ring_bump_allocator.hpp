@@ -4,48 +4,176 @@
 #include "log/log.hpp"
 #include "thread.hpp"
 #include "util_math.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <deque>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <vector>
 
 namespace dxmt {
 
 constexpr size_t kStagingBlockSize = 0x2000000; // 32MB
 constexpr size_t kStagingBlockSizeForDeferredContext = 0x200000; // 2MB
-constexpr size_t kStagingBlockLifetime = 300;
+/* cursors cached per thread, an allocator first looks at the slot its id maps to */
+constexpr size_t kRingBumpCursorSlots = 4;
+/* a cursor reserves 1/16 of a block at once */
+constexpr size_t kRingBumpSpanShift = 4;
+/* demand peaks decay by 1/256 on every completion */
+constexpr size_t kRingBumpDecayShift = 8;
+
+struct RingBumpStatistics {
+  /* bytes of blocks that may still be used by GPU */
+  uint64_t bytes_live = 0;
+  /* bytes of retired blocks kept for reuse */
+  uint64_t bytes_pooled = 0;
+  uint64_t blocks_allocated = 0;
+  uint64_t blocks_recycled = 0;
+  uint64_t blocks_released = 0;
+  size_t block_size = 0;
+};
 
+/**
+ * \brief Ring of bump-allocated blocks
+ *
+ * Every thread bumps a cursor over a span it reserved from the active
+ * block, so the common path neither locks nor touches shared cache lines.
+ * Spans are reserved from the active block lock-free, \c mutex is only
+ * taken to open a new block or to retire blocks.
+ *
+ * A block is retired once the last sequence id it served is coherent.
+ * Blocks are sized by the demand observed between completions, and
+ * retired blocks are pooled as long as the recent peak needs them.
+ *
+ * The sequence id passed to \c allocate must not be coherent yet.
+ */
 template <typename Allocator, size_t BlockSize = kStagingBlockSize, class mutex = dxmt::mutex> class RingBumpState {
 
 public:
 
   static constexpr size_t block_size = BlockSize;
+  static constexpr size_t min_block_size = std::min(BlockSize, std::max(BlockSize >> 4, size_t(0x10000)));
+  static constexpr size_t max_block_size = BlockSize << 2;
 
-  RingBumpState(Allocator &&allocator) : allocator_(std::move(allocator)) {}
+  RingBumpState(Allocator &&allocator) : allocator_(std::move(allocator)) {
+    stats_.block_size = BlockSize;
+  }
 
   std::pair<typename Allocator::Block &, uint64_t>
   allocate(uint64_t seq_id, uint64_t coherent_id, size_t size, size_t alignment);
 
+  /**
+   * \brief Retires blocks no longer used by GPU
+   *
+   * Passing \c ~0ull releases every block, no allocation may happen
+   * concurrently in that case.
+   */
   void free_blocks(uint64_t coherent_id);
 
+  /**
+   * \brief Releases pooled blocks right away
+   *
+   * Blocks still in use are left alone, the pool refills on demand.
+   */
+  void trim();
+
+  RingBumpStatistics
+  statistics() {
+    std::lock_guard<mutex> lock(mutex_);
+    return stats_;
+  }
+
 private:
-  struct Allocation {
-    size_t allocated_size;
-    size_t total_size;
-    uint64_t last_used_seq_id;
-    uint64_t inc_time_to_live;
-    Allocator::Block block;
-  };
+  static constexpr uint32_t kLocked = 0x80000000;
+
+  struct Node {
+    std::optional<typename Allocator::Block> block;
+    size_t total_size = 0;
+    bool adhoc = false;
+    std::atomic<size_t> reserved = 0;
+    std::atomic<uint64_t> last_used_seq_id = 0;
+    /* transient users, kLocked is set while retired */
+    std::atomic<uint32_t> pins = kLocked;
+    std::atomic<uint32_t> generation = 0;
+
+    bool
+    pin(uint32_t expected_generation) {
+      auto prev = pins.fetch_add(1, std::memory_order_acquire);
+      if (likely(!(prev & kLocked)) && generation.load(std::memory_order_relaxed) == expected_generation)
+        return true;
+      pins.fetch_sub(1, std::memory_order_release);
+      return false;
+    }
 
-  Allocation &allocate_or_reuse_block(uint64_t seq_id, uint64_t coherent_id, size_t block_size);
+    void
+    unpin() {
+      pins.fetch_sub(1, std::memory_order_release);
+    }
 
-  std::pair<typename Allocator::Block &, uint64_t>
-  suballocate(Allocation &allocation, size_t size, size_t alignment) {
-    auto offset = align(allocation.allocated_size, alignment);
-    allocation.allocated_size = offset + size;
-    return {allocation.block, offset};
+    void
+    touch(uint64_t seq_id) {
+      auto last = last_used_seq_id.load(std::memory_order_relaxed);
+      while (last < seq_id && !last_used_seq_id.compare_exchange_weak(last, seq_id, std::memory_order_relaxed)) {
+      }
+    }
+
+    bool
+    reserve(size_t size, size_t alignment, size_t span, size_t &offset, size_t &end) {
+      auto current = reserved.load(std::memory_order_relaxed);
+      do {
+        offset = align(current, alignment);
+        if (offset + size > total_size)
+          return false;
+        end = std::min(total_size, offset + std::max(size, span));
+      } while (!reserved.compare_exchange_weak(current, end, std::memory_order_relaxed));
+      return true;
+    }
   };
 
-  std::queue<Allocation> fifo;
+  struct Cursor {
+    uint64_t owner = 0;
+    Node *node = nullptr;
+    uint32_t generation = 0;
+    uint64_t seq_id = 0;
+    size_t offset = 0;
+    size_t end = 0;
+  };
+
+  Cursor &find_cursor();
+
+  Node *open_block(Node *full, uint64_t seq_id, uint64_t coherent_id, size_t size);
+
+  Node *acquire_node(size_t size, bool adhoc);
+
+  void activate(Node *node, uint64_t seq_id);
+
+  void retire_blocks(uint64_t coherent_id);
+
+  void release(Node *node);
+
+  void adapt_and_trim();
+
+  static inline std::atomic<uint64_t> next_id_ = 1;
+  static inline thread_local Cursor cursors_[kRingBumpCursorSlots];
+
+  const uint64_t id_ = next_id_.fetch_add(1, std::memory_order_relaxed);
+  std::atomic<Node *> active_ = nullptr;
+  std::atomic<size_t> target_size_ = BlockSize;
+  std::atomic<uint64_t> bytes_reserved_ = 0;
+
   mutex mutex_;
+  /* nodes are never destroyed before the state, cursors may point to them */
+  std::deque<Node> nodes_;
+  std::vector<Node *> in_flight_;
+  std::vector<Node *> pool_;
+  std::vector<Node *> spare_;
+  uint64_t last_bytes_reserved_ = 0;
+  uint64_t demand_peak_ = 0;
+  /* highest bytes_live since last completion */
+  uint64_t live_high_ = 0;
+  uint64_t live_peak_ = 0;
+  RingBumpStatistics stats_;
   Allocator allocator_;
 };
 
@@ -166,76 +294,240 @@ template <typename Allocator, size_t BlockSize, class mutex>
 std::pair<typename Allocator::Block &, uint64_t>
 RingBumpState<Allocator, BlockSize, mutex>::allocate(
     uint64_t seq_id, uint64_t coherent_id, size_t size, size_t alignment
+) {
+  auto &cursor = find_cursor();
+  if (likely(cursor.owner == id_)) {
+    auto offset = align(cursor.offset, alignment);
+    if (likely(offset + size <= cursor.end)) {
+      auto node = cursor.node;
+      // the block has served a sequence not yet coherent, it can't be retired under us
+      if (likely(cursor.seq_id >= seq_id && node->generation.load(std::memory_order_relaxed) == cursor.generation)) {
+        cursor.offset = offset + size;
+        return {*node->block, offset};
+      }
+      if (node->pin(cursor.generation)) {
+        node->touch(seq_id);
+        node->unpin();
+        cursor.seq_id = seq_id;
+        cursor.offset = offset + size;
+        return {*node->block, offset};
+      }
+    }
+  }
+
+  Node *node = active_.load(std::memory_order_acquire);
+  while (true) {
+    if (node) {
+      auto generation = node->generation.load(std::memory_order_acquire);
+      if (node->pin(generation)) {
+        size_t offset, end;
+        auto span = target_size_.load(std::memory_order_relaxed) >> kRingBumpSpanShift;
+        if (node->reserve(size, alignment, span, offset, end)) {
+          node->touch(seq_id);
+          node->unpin();
+          bytes_reserved_.fetch_add(end - offset, std::memory_order_relaxed);
+          cursor = {id_, node, generation, seq_id, offset + size, end};
+          return {*node->block, offset};
+        }
+        node->unpin();
+      }
+    }
+    auto next = open_block(node, seq_id, coherent_id, size);
+    if (next->adhoc)
+      return {*next->block, 0};
+    node = next;
+  }
+};
+
+template <typename Allocator, size_t BlockSize, class mutex>
+RingBumpState<Allocator, BlockSize, mutex>::Cursor &
+RingBumpState<Allocator, BlockSize, mutex>::find_cursor() {
+  auto &home = cursors_[id_ % kRingBumpCursorSlots];
+  if (likely(home.owner == id_))
+    return home;
+  // allocators whose ids map to the same slot would otherwise evict each other's cursor on every
+  // allocation, and reserve a new span each time
+  Cursor *vacant = nullptr;
+  for (auto &cursor : cursors_) {
+    if (cursor.owner == id_)
+      return cursor;
+    if (!cursor.owner && !vacant)
+      vacant = &cursor;
+  }
+  return vacant ? *vacant : home;
+};
+
+template <typename Allocator, size_t BlockSize, class mutex>
+RingBumpState<Allocator, BlockSize, mutex>::Node *
+RingBumpState<Allocator, BlockSize, mutex>::open_block(
+    Node *full, uint64_t seq_id, uint64_t coherent_id, size_t size
 ) {
   std::lock_guard<mutex> lock(mutex_);
-  while (!fifo.empty()) {
-    auto &latest = fifo.back();
-    if ((align(latest.allocated_size, alignment) + size) > latest.total_size) {
-      break;
+  auto target_size = target_size_.load(std::memory_order_relaxed);
+  if (size > target_size) {
+    // in case required size is larger than block size
+    auto node = acquire_node(size, true);
+    activate(node, seq_id);
+    bytes_reserved_.fetch_add(size, std::memory_order_relaxed);
+    in_flight_.push_back(node);
+    return node;
+  }
+  auto active = active_.load(std::memory_order_relaxed);
+  if (active != full)
+    return active; // already replaced by another thread
+  if (active)
+    in_flight_.push_back(active);
+  if (pool_.empty())
+    retire_blocks(coherent_id);
+  auto node = acquire_node(target_size, false);
+  activate(node, seq_id);
+  active_.store(node, std::memory_order_release);
+  return node;
+};
+
+template <typename Allocator, size_t BlockSize, class mutex>
+RingBumpState<Allocator, BlockSize, mutex>::Node *
+RingBumpState<Allocator, BlockSize, mutex>::acquire_node(size_t size, bool adhoc) {
+  if (!adhoc && !pool_.empty()) {
+    auto node = pool_.back();
+    pool_.pop_back();
+    stats_.bytes_pooled -= node->total_size;
+    stats_.bytes_live += node->total_size;
+    stats_.blocks_recycled++;
+    live_high_ = std::max(live_high_, stats_.bytes_live);
+    return node;
+  }
+  Node *node;
+  if (spare_.empty()) {
+    node = &nodes_.emplace_back();
+  } else {
+    node = spare_.back();
+    spare_.pop_back();
+  }
+  node->block.emplace(allocator_.allocate(size));
+  node->total_size = size;
+  node->adhoc = adhoc;
+  stats_.bytes_live += size;
+  stats_.blocks_allocated++;
+  live_high_ = std::max(live_high_, stats_.bytes_live);
+  return node;
+};
+
+template <typename Allocator, size_t BlockSize, class mutex>
+void
+RingBumpState<Allocator, BlockSize, mutex>::activate(Node *node, uint64_t seq_id) {
+  // still locked: no cursor can observe the node until pins are cleared
+  node->reserved.store(node->adhoc ? node->total_size : 0, std::memory_order_relaxed);
+  node->last_used_seq_id.store(seq_id, std::memory_order_relaxed);
+  node->generation.fetch_add(1, std::memory_order_relaxed);
+  node->pins.fetch_and(~kLocked, std::memory_order_release);
+};
+
+template <typename Allocator, size_t BlockSize, class mutex>
+void
+RingBumpState<Allocator, BlockSize, mutex>::retire_blocks(uint64_t coherent_id) {
+  auto target_size = target_size_.load(std::memory_order_relaxed);
+  size_t kept = 0;
+  for (auto node : in_flight_) {
+    uint32_t unpinned = 0;
+    if (node->last_used_seq_id.load(std::memory_order_relaxed) > coherent_id ||
+        !node->pins.compare_exchange_strong(unpinned, kLocked, std::memory_order_acq_rel)) {
+      in_flight_[kept++] = node;
+      continue;
+    }
+    // a cursor might have touched it just before we locked
+    if (node->last_used_seq_id.load(std::memory_order_relaxed) > coherent_id) {
+      node->pins.fetch_and(~kLocked, std::memory_order_release);
+      in_flight_[kept++] = node;
+      continue;
     }
-    latest.last_used_seq_id = seq_id;
-    return suballocate(latest, size, alignment);
+    // invalidates cursors still pointing into the block
+    node->generation.fetch_add(1, std::memory_order_relaxed);
+    if (node->adhoc || node->total_size != target_size) {
+      release(node);
+      continue;
+    }
+    stats_.bytes_live -= node->total_size;
+    stats_.bytes_pooled += node->total_size;
+    pool_.push_back(node);
+  }
+  in_flight_.resize(kept);
+};
+
+template <typename Allocator, size_t BlockSize, class mutex>
+void
+RingBumpState<Allocator, BlockSize, mutex>::release(Node *node) {
+  stats_.bytes_live -= node->total_size;
+  stats_.blocks_released++;
+  node->block.reset();
+  node->total_size = 0;
+  spare_.push_back(node);
+};
+
+template <typename Allocator, size_t BlockSize, class mutex>
+void
+RingBumpState<Allocator, BlockSize, mutex>::adapt_and_trim() {
+  auto bytes_reserved = bytes_reserved_.load(std::memory_order_relaxed);
+  auto demand = bytes_reserved - last_bytes_reserved_;
+  last_bytes_reserved_ = bytes_reserved;
+  demand_peak_ = std::max(demand, demand_peak_ - (demand_peak_ >> kRingBumpDecayShift));
+  live_peak_ = std::max(live_high_, live_peak_ - (live_peak_ >> kRingBumpDecayShift));
+  live_high_ = stats_.bytes_live;
+
+  // a block should hold a few completions worth of data
+  auto target_size = target_size_.load(std::memory_order_relaxed);
+  auto wanted = std::clamp<size_t>(std::bit_ceil(demand_peak_ << 2), min_block_size, max_block_size);
+  if (wanted > target_size || (wanted << 2) <= target_size) {
+    target_size = wanted > target_size ? wanted : target_size >> 1;
+    target_size_.store(target_size, std::memory_order_relaxed);
+    stats_.block_size = target_size;
+  }
+
+  // keep pooled blocks only as long as the recent peak may need them again
+  while (!pool_.empty() &&
+         (pool_.front()->total_size != target_size ||
+          stats_.bytes_live + stats_.bytes_pooled > live_peak_ + target_size)) {
+    auto node = pool_.front();
+    pool_.erase(pool_.begin());
+    stats_.bytes_pooled -= node->total_size;
+    stats_.bytes_live += node->total_size;
+    release(node);
   }
-  return suballocate(
-      allocate_or_reuse_block(
-          seq_id, coherent_id, std::max(size, BlockSize) // in case required size is larger than block size
-      ),
-      size, alignment
-  );
 };
 
 template <typename Allocator, size_t BlockSize, class mutex>
 void
 RingBumpState<Allocator, BlockSize, mutex>::free_blocks(uint64_t coherent_id) {
   std::lock_guard<mutex> lock(mutex_);
-  while (!fifo.empty()) {
-    auto &front = fifo.front();
-    if (front.last_used_seq_id > coherent_id)
-      break;
-    auto expired = (coherent_id - front.last_used_seq_id) > kStagingBlockLifetime ||
-                   front.inc_time_to_live > kStagingBlockLifetime || coherent_id == -1ull;
-    auto adhoc = front.total_size != BlockSize;
-    if (expired || adhoc) {
-      // can be deallocated
-      fifo.pop();
-      continue;
+  if (coherent_id == ~0ull) {
+    if (auto active = active_.exchange(nullptr, std::memory_order_relaxed))
+      in_flight_.push_back(active);
+    retire_blocks(coherent_id);
+    adapt_and_trim();
+    while (!pool_.empty()) {
+      auto node = pool_.back();
+      pool_.pop_back();
+      stats_.bytes_pooled -= node->total_size;
+      stats_.bytes_live += node->total_size;
+      release(node);
     }
-    front.inc_time_to_live++;
-    break;
+    return;
   }
+  retire_blocks(coherent_id);
+  adapt_and_trim();
 };
 
 template <typename Allocator, size_t BlockSize, class mutex>
-RingBumpState<Allocator, BlockSize, mutex>::Allocation &
-RingBumpState<Allocator, BlockSize, mutex>::allocate_or_reuse_block(
-    uint64_t seq_id, uint64_t coherent_id, size_t block_size
-) {
-  while (!fifo.empty()) {
-    auto &front = fifo.front();
-    if (front.last_used_seq_id < coherent_id) {
-      if (front.total_size != BlockSize) {
-        fifo.pop();
-        continue;
-      } else if (front.total_size >= block_size) {
-        front.last_used_seq_id = seq_id;
-        front.allocated_size = 0;
-        front.inc_time_to_live = 0;
-        fifo.push(std::move(front));
-        fifo.pop();
-        return fifo.back();
-      }
-      WARN("forced to allocate new block of size ", block_size);
-    }
-    break;
+void
+RingBumpState<Allocator, BlockSize, mutex>::trim() {
+  std::lock_guard<mutex> lock(mutex_);
+  while (!pool_.empty()) {
+    auto node = pool_.back();
+    pool_.pop_back();
+    stats_.bytes_pooled -= node->total_size;
+    stats_.bytes_live += node->total_size;
+    release(node);
   }
-  fifo.push({
-      .allocated_size = 0,
-      .total_size = block_size,
-      .last_used_seq_id = seq_id,
-      .inc_time_to_live = 0,
-      .block = allocator_.allocate(block_size),
-  });
-  return fifo.back();
 };
 
 } // namespace dxmt
\ No newline at end of file
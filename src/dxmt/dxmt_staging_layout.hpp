@@ -0,0 +1,66 @@
+#pragma once
+
+#include "util_math.hpp"
+#include <cstdint>
+#include <cstring>
+
+namespace dxmt {
+
+/**
+ * \brief Extent of a box in the linear layout of a subresource
+ *
+ * A row of a BC format is a row of 4x4 blocks, and \c bytes_per_texel is the
+ * size of a block. Partial blocks at the edges of a mip level count as whole
+ * ones.
+ */
+struct StagingExtent {
+  uint32_t bytes_per_row;
+  uint32_t rows;
+};
+
+inline StagingExtent
+GetStagingExtent(uint32_t width, uint32_t height, uint32_t bytes_per_texel, bool block_compressed) {
+  if (block_compressed)
+    return {(align(width, 4u) >> 2) * bytes_per_texel, align(height, 4u) >> 2};
+  return {width * bytes_per_texel, height};
+}
+
+/**
+ * \brief Offset of a texel in the linear layout of a staging subresource
+ *
+ * The origin of a BC format is expected to be block aligned.
+ */
+inline uint64_t
+GetStagingOffset(
+    uint32_t x, uint32_t y, uint32_t z, uint32_t bytes_per_texel, bool block_compressed, uint32_t bytes_per_row,
+    uint32_t bytes_per_image
+) {
+  auto block_size = block_compressed ? 4u : 1u;
+  return uint64_t(z) * bytes_per_image + uint64_t(y / block_size) * bytes_per_row +
+         uint64_t(x / block_size) * bytes_per_texel;
+}
+
+/**
+ * \brief Copies rows of data into the linear layout of a staging subresource
+ *
+ * A row of a BC format is a row of blocks.
+ */
+inline void
+WriteStagingRows(
+    void *dst, uint32_t dst_row_pitch, uint32_t dst_depth_pitch, const void *src, uint32_t src_row_pitch,
+    uint32_t src_depth_pitch, uint32_t bytes_per_row, uint32_t rows, uint32_t depth
+) {
+  for (auto image = 0u; image < depth; image++) {
+    auto dst_image = (char *)dst + uint64_t(image) * dst_depth_pitch;
+    auto src_image = (const char *)src + uint64_t(image) * src_depth_pitch;
+    if (bytes_per_row == dst_row_pitch && bytes_per_row == src_row_pitch) {
+      std::memcpy(dst_image, src_image, uint64_t(bytes_per_row) * rows);
+      continue;
+    }
+    for (auto row = 0u; row < rows; row++) {
+      std::memcpy(dst_image + uint64_t(row) * dst_row_pitch, src_image + uint64_t(row) * src_row_pitch, bytes_per_row);
+    }
+  }
+}
+
+} // namespace dxmt
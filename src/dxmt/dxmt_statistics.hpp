@@ -46,14 +46,30 @@ struct FrameStatistics {
   uint32_t clear_pass_count = 0;
   uint32_t clear_pass_optimized = 0;
   uint32_t resolve_pass_optimized = 0;
+  uint32_t present_direct = 0;
+  uint32_t present_dropped = 0;
   uint32_t compute_pass_count = 0;
   uint32_t blit_pass_count = 0;
   uint32_t event_stall = 0;
+  uint32_t readback_ready = 0;
+  uint32_t readback_stalled = 0;
   uint32_t latency = 0;
+  uint32_t argument_table_encoded = 0;
+  uint32_t argument_table_reused = 0;
+  uint64_t argument_table_bytes = 0;
+  uint64_t heap_bytes_live = 0;
+  uint64_t heap_bytes_pooled = 0;
+  uint32_t heap_blocks_recycled = 0;
+  uint32_t texture_view_created = 0;
+  uint64_t init_bytes_elided = 0;
+  uint32_t init_batches = 0;
+  uint32_t init_clears_merged = 0;
   clock::duration encode_prepare_interval{};
   clock::duration encode_flush_interval{};
   clock::duration drawable_blocking_interval{};
   clock::duration present_latency_interval{};
+  clock::duration present_interval{};
+  clock::duration gpu_busy_interval{};
   ScalerInfo last_scaler_info{};
 
   void
@@ -68,14 +84,30 @@ struct FrameStatistics {
     clear_pass_count = 0;
     clear_pass_optimized = 0;
     resolve_pass_optimized = 0;
+    present_direct = 0;
+    present_dropped = 0;
     compute_pass_count = 0;
     blit_pass_count = 0;
     event_stall = 0;
+    readback_ready = 0;
+    readback_stalled = 0;
     latency = 0;
+    argument_table_encoded = 0;
+    argument_table_reused = 0;
+    argument_table_bytes = 0;
+    heap_bytes_live = 0;
+    heap_bytes_pooled = 0;
+    heap_blocks_recycled = 0;
+    texture_view_created = 0;
+    init_bytes_elided = 0;
+    init_batches = 0;
+    init_clears_merged = 0;
     encode_prepare_interval = {};
     encode_flush_interval = {};
     drawable_blocking_interval = {};
     present_latency_interval = {};
+    present_interval = {};
+    gpu_busy_interval = {};
     last_scaler_info.type = {};
   };
 };
@@ -132,6 +164,8 @@ public:
       min_.drawable_blocking_interval =
           std::min(min_.drawable_blocking_interval, frames_[i].drawable_blocking_interval);
       min_.present_latency_interval = std::min(min_.present_latency_interval, frames_[i].present_latency_interval);
+      min_.present_interval = std::min(min_.present_interval, frames_[i].present_interval);
+      min_.gpu_busy_interval = std::min(min_.gpu_busy_interval, frames_[i].gpu_busy_interval);
 
       max_.command_buffer_count = std::max(max_.command_buffer_count, frames_[i].command_buffer_count);
       max_.sync_count = std::max(max_.sync_count, frames_[i].sync_count);
@@ -143,6 +177,8 @@ public:
       max_.drawable_blocking_interval =
           std::max(max_.drawable_blocking_interval, frames_[i].drawable_blocking_interval);
       max_.present_latency_interval = std::max(max_.present_latency_interval, frames_[i].present_latency_interval);
+      max_.present_interval = std::max(max_.present_interval, frames_[i].present_interval);
+      max_.gpu_busy_interval = std::max(max_.gpu_busy_interval, frames_[i].gpu_busy_interval);
 
       average_.command_buffer_count += frames_[i].command_buffer_count;
       average_.sync_count += frames_[i].sync_count;
@@ -153,6 +189,8 @@ public:
       average_.encode_flush_interval += frames_[i].encode_flush_interval;
       average_.drawable_blocking_interval += frames_[i].drawable_blocking_interval;
       average_.present_latency_interval += frames_[i].present_latency_interval;
+      average_.present_interval += frames_[i].present_interval;
+      average_.gpu_busy_interval += frames_[i].gpu_busy_interval;
     }
     average_.command_buffer_count /= (kFrameStatisticsCount - 1);
     average_.sync_count /= (kFrameStatisticsCount - 1);
@@ -163,6 +201,8 @@ public:
     average_.encode_flush_interval /= (kFrameStatisticsCount - 1);
     average_.drawable_blocking_interval /= (kFrameStatisticsCount - 1);
     average_.present_latency_interval /= (kFrameStatisticsCount - 1);
+    average_.present_interval /= (kFrameStatisticsCount - 1);
+    average_.gpu_busy_interval /= (kFrameStatisticsCount - 1);
   };
 };
 
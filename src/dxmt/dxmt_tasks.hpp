@@ -1,10 +1,13 @@
 #pragma once
 
+#include "dxmt_trace.hpp"
 #include "thread.hpp"
 #include "util_win32_compat.h"
 #include <atomic>
-#include <queue>
+#include <deque>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace dxmt {
 
@@ -12,11 +15,44 @@ template <typename Task> struct task_trait {
   Task run_task(Task task);
   bool get_done(Task task);
   void set_done(Task task);
+  /* set when a task is put into a queue */
+  void set_queued(Task task);
+  bool get_queued(Task task);
+  /* clears the queued state, returns false if the entry is stale */
+  bool try_dequeue(Task task);
 };
 
+enum class task_priority : uint32_t {
+  normal = 0,
+  high = 1,
+};
+
+constexpr uint32_t kTaskPriorityCount = 2;
+
+/**
+ * \brief Task scheduler
+ *
+ * Every worker owns a queue per priority, idle workers steal from
+ * the others. A task that is waited on can be promoted, which also
+ * promotes the tasks it depends on. Promotion may leave a duplicated
+ * entry in a queue, \c task_trait::try_dequeue filters them out.
+ */
 template <typename Task> class task_scheduler {
 public:
-  void submit(Task task);
+  void submit(Task task, task_priority priority = task_priority::normal);
+
+  /**
+   * \brief Moves a pending task (and its dependencies) to high priority
+   */
+  void promote(Task task);
+
+  /**
+   * \brief Stops all workers
+   *
+   * Queued tasks that have not started are cancelled. Must be called
+   * before any task object is destroyed.
+   */
+  void shutdown();
 
   task_scheduler();
   ~task_scheduler();
@@ -27,38 +63,74 @@ public:
   }
 
 private:
-  void worker_func();
+  struct task_entry {
+    Task task;
+    task_priority priority;
+  };
+
+  struct worker_queue {
+    dxmt::mutex mutex;
+    std::deque<Task> tasks[kTaskPriorityCount];
+  };
+
+  void worker_func(uint32_t index);
 
-  dxmt::mutex worker_mutex_;
-  dxmt::condition_variable worker_cond_;
-  std::queue<Task> task_queue_;
-  std::queue<Task> task_continuation_queue_;
+  void run(uint32_t index, Task task, task_priority priority);
+
+  void push(uint32_t index, Task task, task_priority priority);
+
+  bool pop(uint32_t index, task_entry &entry);
+
+  void spawn_worker();
+
+  std::vector<std::unique_ptr<worker_queue>> queues_;
+  std::atomic_uint32_t next_queue_ = 0;
+  std::atomic_uint64_t pending_ = 0;
+
+  dxmt::mutex sleep_mutex_;
+  dxmt::condition_variable sleep_cond_;
 
   dxmt::mutex deps_mutex_;
-  std::unordered_multimap<Task, Task> task_continuation_;
+  std::unordered_multimap<Task, task_entry> task_continuation_;
+  std::unordered_map<Task, Task> task_dependency_;
 
+  dxmt::mutex workers_mutex_;
   std::vector<dxmt::thread> workers_;
 
   std::atomic_bool destroyed = false;
   std::atomic_uint64_t running = 0;
-  uint64_t threads;
-  uint64_t max_threads;
+  std::atomic_uint32_t threads = 0;
+  uint32_t max_threads;
 };
 
 template <typename Task> task_scheduler<Task>::task_scheduler() {
   max_threads = dxmt::thread::hardware_concurrency() * 2;
   workers_.reserve(max_threads);
-  threads = 2;
+  queues_.reserve(max_threads);
+  for (unsigned i = 0; i < max_threads; i++) {
+    queues_.push_back(std::make_unique<worker_queue>());
+  }
 
-  for (unsigned i = 0; i < threads; i++) {
-    workers_.emplace_back([this]() { worker_func(); });
+  std::unique_lock<dxmt::mutex> lock(workers_mutex_);
+  for (unsigned i = 0; i < 2; i++) {
+    spawn_worker();
   }
 }
 
 template <typename Task> task_scheduler<Task>::~task_scheduler() {
-  destroyed.store(true);
-  worker_cond_.notify_all();
+  shutdown();
+}
+
+template <typename Task>
+void
+task_scheduler<Task>::shutdown() {
+  {
+    std::unique_lock<dxmt::mutex> lock(sleep_mutex_);
+    destroyed.store(true);
+  }
+  sleep_cond_.notify_all();
 
+  std::unique_lock<dxmt::mutex> lock(workers_mutex_);
   for (auto &worker : workers_) {
     if (worker.joinable())
       worker.join();
@@ -69,78 +141,145 @@ template <typename Task> task_scheduler<Task>::~task_scheduler() {
 
 template <typename Task>
 void
-task_scheduler<Task>::worker_func() {
+task_scheduler<Task>::spawn_worker() {
+  uint32_t index = threads.load(std::memory_order_relaxed);
+  threads.store(index + 1, std::memory_order_release);
+  workers_.emplace_back([this, index]() { worker_func(index); });
+}
+
+template <typename Task>
+void
+task_scheduler<Task>::push(uint32_t index, Task task, task_priority priority) {
+  {
+    auto &queue = *queues_[index];
+    std::unique_lock<dxmt::mutex> lock(queue.mutex);
+    queue.tasks[uint32_t(priority)].push_back(task);
+  }
+  pending_.fetch_add(1, std::memory_order_release);
+  {
+    std::unique_lock<dxmt::mutex> lock(sleep_mutex_);
+  }
+  sleep_cond_.notify_one();
+}
+
+template <typename Task>
+bool
+task_scheduler<Task>::pop(uint32_t index, task_entry &entry) {
+  uint32_t count = threads.load(std::memory_order_acquire);
+  for (int priority = kTaskPriorityCount - 1; priority >= 0; priority--) {
+    // own queue first, then steal
+    for (uint32_t i = 0; i < count; i++) {
+      auto &queue = *queues_[(index + i) % count];
+      std::unique_lock<dxmt::mutex> lock(queue.mutex);
+      auto &tasks = queue.tasks[priority];
+      if (tasks.empty())
+        continue;
+      entry = {tasks.front(), task_priority(priority)};
+      tasks.pop_front();
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Task>
+void
+task_scheduler<Task>::worker_func(uint32_t index) {
   struct task_trait<Task> task_trait;
-  std::vector<Task> continuation_buffer;
   SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+  Tracer::setThreadName("dxmt-task-worker");
   while (!destroyed.load()) {
-    Task task;
-    {
-      std::unique_lock<dxmt::mutex> lock(worker_mutex_);
-
-      if (task_queue_.empty() && task_continuation_queue_.empty()) {
-        worker_cond_.wait(lock, [this]() {
-          return task_queue_.size() || task_continuation_queue_.size() || destroyed.load();
-        });
-      }
-
-      if (!task_continuation_queue_.empty()) {
-        task = task_continuation_queue_.front();
-        task_continuation_queue_.pop();
-      } else if (!task_queue_.empty()) {
-        task = task_queue_.front();
-        task_queue_.pop();
-      } else {
-        break;
-      }
+    task_entry entry;
+    if (!pop(index, entry)) {
+      std::unique_lock<dxmt::mutex> lock(sleep_mutex_);
+      sleep_cond_.wait(lock, [this]() {
+        return pending_.load(std::memory_order_acquire) || destroyed.load();
+      });
+      continue;
     }
+    // stale entry left by promote()
+    if (!task_trait.try_dequeue(entry.task))
+      continue;
     running.fetch_add(1, std::memory_order_relaxed);
-    while (true) {
-      Task continuation = task_trait.run_task(task);
-      if (continuation == task) {
-        {
-          std::unique_lock<dxmt::mutex> lock(deps_mutex_);
-          auto range = task_continuation_.equal_range(continuation);
-          for (auto itr = range.first; itr != range.second; ++itr) {
-            continuation_buffer.push_back(itr->second);
-          }
-          task_continuation_.erase(range.first, range.second);
-          task_trait.set_done(continuation);
-        }
-        {
-          std::unique_lock<dxmt::mutex> lock(worker_mutex_);
-          for (auto &task : continuation_buffer) {
-            task_continuation_queue_.push(task);
-          }
-        }
-        worker_cond_.notify_all();
-        continuation_buffer.clear();
-      } else {
+    run(index, entry.task, entry.priority);
+    running.fetch_sub(1, std::memory_order_relaxed);
+  }
+};
+
+template <typename Task>
+void
+task_scheduler<Task>::run(uint32_t index, Task task, task_priority priority) {
+  struct task_trait<Task> task_trait;
+  std::vector<task_entry> continuation_buffer;
+  while (true) {
+    Task continuation;
+    {
+      DXMT_TRACE_SCOPE("task_scheduler::run_task");
+      continuation = task_trait.run_task(task);
+    }
+    if (continuation == task) {
+      {
         std::unique_lock<dxmt::mutex> lock(deps_mutex_);
-        // spurious dependency
-        if (task_trait.get_done(continuation)) {
-          continue;
+        auto range = task_continuation_.equal_range(continuation);
+        for (auto itr = range.first; itr != range.second; ++itr) {
+          continuation_buffer.push_back(itr->second);
+          task_dependency_.erase(itr->second.task);
         }
-        task_continuation_.insert({continuation, task});
+        task_continuation_.erase(range.first, range.second);
+        task_trait.set_done(continuation);
+      }
+      for (auto &entry : continuation_buffer) {
+        task_trait.set_queued(entry.task);
+        push(index, entry.task, entry.priority);
       }
-      break;
+    } else {
+      std::unique_lock<dxmt::mutex> lock(deps_mutex_);
+      // spurious dependency
+      if (task_trait.get_done(continuation)) {
+        continue;
+      }
+      task_continuation_.insert({continuation, {task, priority}});
+      task_dependency_.insert({task, continuation});
+      if (priority == task_priority::high && task_trait.get_queued(continuation))
+        push(index, continuation, task_priority::high);
     }
-    running.fetch_sub(1, std::memory_order_relaxed);
+    break;
   }
-};
+}
 
 template <typename Task>
 void
-task_scheduler<Task>::submit(Task task) {
-  std::unique_lock<dxmt::mutex> lock(worker_mutex_);
-  task_queue_.push(task);
+task_scheduler<Task>::submit(Task task, task_priority priority) {
+  struct task_trait<Task> task_trait;
+  task_trait.set_queued(task);
+  push(next_queue_.fetch_add(1, std::memory_order_relaxed) % threads.load(std::memory_order_acquire), task, priority);
 
-  if (running.load(std::memory_order_relaxed) == threads && threads < max_threads) {
-    workers_.emplace_back([this]() { worker_func(); });
-    threads++;
+  if (running.load(std::memory_order_relaxed) == threads.load(std::memory_order_relaxed) &&
+      threads.load(std::memory_order_relaxed) < max_threads) {
+    std::unique_lock<dxmt::mutex> lock(workers_mutex_);
+    if (!destroyed.load() && threads.load(std::memory_order_relaxed) < max_threads)
+      spawn_worker();
   }
+}
 
-  worker_cond_.notify_one();
+template <typename Task>
+void
+task_scheduler<Task>::promote(Task task) {
+  struct task_trait<Task> task_trait;
+  std::unique_lock<dxmt::mutex> lock(deps_mutex_);
+  // walk down to the task that actually blocks progress
+  for (auto dep = task_dependency_.find(task); dep != task_dependency_.end(); dep = task_dependency_.find(task)) {
+    auto range = task_continuation_.equal_range(dep->second);
+    for (auto itr = range.first; itr != range.second; ++itr) {
+      if (itr->second.task == task)
+        itr->second.priority = task_priority::high;
+    }
+    task = dep->second;
+  }
+  if (task_trait.get_queued(task))
+    push(next_queue_.fetch_add(1, std::memory_order_relaxed) % threads.load(std::memory_order_acquire), task,
+         task_priority::high);
 }
 
 }; // namespace dxmt
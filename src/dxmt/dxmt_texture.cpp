@@ -1,4 +1,6 @@
 #include "dxmt_texture.hpp"
+#include "dxmt_format.hpp"
+#include "dxmt_memory_budget.hpp"
 #include "dxmt_residency.hpp"
 #include "wsi_platform.hpp"
 #include <atomic>
@@ -23,7 +25,9 @@ TextureView::TextureView(TextureAllocation *allocation) :
     texture(allocation->texture()),
     gpuResourceID(allocation->gpuResourceID),
     allocation(allocation),
-    key(allocation->descriptor->fullView) {}
+    key(allocation->descriptor->fullView) {
+  created_count_.fetch_add(1, std::memory_order_relaxed);
+}
 
 TextureView::TextureView(TextureAllocation *allocation, unsigned index, TextureViewDescriptor descriptor) :
     gpuResourceID(0),
@@ -35,6 +39,7 @@ TextureView::TextureView(TextureAllocation *allocation, unsigned index, TextureV
       descriptor.firstArraySlice, descriptor.arraySize,
       {WMTTextureSwizzleRed, WMTTextureSwizzleGreen, WMTTextureSwizzleBlue, WMTTextureSwizzleAlpha}, gpuResourceID
   );
+  created_count_.fetch_add(1, std::memory_order_relaxed);
 }
 
 TextureAllocation::TextureAllocation(
@@ -71,53 +76,60 @@ TextureAllocation::TextureAllocation(
 };
 
 TextureAllocation::~TextureAllocation(){
+  MemoryBudget::instance().track(MemoryCategory::Texture, -int64_t(tracked_size_));
 #ifdef __i386__
   wsi::aligned_free(mappedMemory);
 #endif
 };
 
 void
-Texture::prepareAllocationViews(TextureAllocation *allocation) {
-  if (allocation->version_ < 1) {
-    allocation->cached_view_.push_back(new TextureView(allocation));
-    allocation->version_ = 1;
+TextureAllocation::trackMemory(uint64_t size) {
+  tracked_size_ = size;
+  MemoryBudget::instance().track(MemoryCategory::Texture, size);
+}
+
+TextureView &
+Texture::materializeView(TextureViewKey key, TextureAllocation *allocation) {
+  auto &views = allocation->cached_view_;
+  if (views.size() <= key.index)
+    views.resize(key.index + 1);
+  if (key.index == 0) {
+    views[0] = new TextureView(allocation);
+  } else {
+    views[key.index] = new TextureView(allocation, key.index, viewEntry(key.index).descriptor);
   }
-  std::shared_lock<dxmt::shared_mutex> lock(mutex_);
-  for (unsigned version = allocation->version_; version < version_; version++) {
-    allocation->cached_view_.push_back(new TextureView(allocation, version, viewDescriptors_[version]));
+  return *views[key.index];
+}
+
+uint32_t
+Texture::appendView(TextureViewDescriptor const &descriptor) {
+  auto index = view_count_;
+  auto chunk = std::bit_width(index / kViewChunkBase + 1) - 1;
+  auto base = kViewChunkBase * ((1u << chunk) - 1);
+  if (index == base) {
+    assert(chunk < kViewChunkCount);
+    view_chunks_[chunk].store(new ViewEntry[kViewChunkBase << chunk], std::memory_order_release);
   }
-  allocation->version_ = version_;
+  view_chunks_[chunk].load(std::memory_order_relaxed)[index - base].descriptor = descriptor;
+  view_index_.emplace(std::bit_cast<uint64_t>(descriptor), index);
+  view_count_ = index + 1;
+  return index;
 }
 
 TextureViewKey
 Texture::createView(TextureViewDescriptor const &descriptor) {
-  std::unique_lock<dxmt::shared_mutex> lock(mutex_);
-  unsigned i = 0;
-  for (; i < version_; i++) {
-    if (viewDescriptors_[i].format != descriptor.format)
-      continue;
-    if (viewDescriptors_[i].type != descriptor.type)
-      continue;
-    if (viewDescriptors_[i].firstMiplevel != descriptor.firstMiplevel)
-      continue;
-    if (viewDescriptors_[i].miplevelCount != descriptor.miplevelCount)
-      continue;
-    if (viewDescriptors_[i].firstArraySlice != descriptor.firstArraySlice)
-      continue;
-    if (viewDescriptors_[i].arraySize != descriptor.arraySize)
-      continue;
-    return TextureViewKey(descriptor, i, info_.mipmap_level_count);
-  }
-  viewDescriptors_.push_back(descriptor);
-  version_ = version_ + 1;
-  return TextureViewKey(descriptor, i, info_.mipmap_level_count);
+  std::unique_lock<dxmt::mutex> lock(mutex_);
+  auto existing = view_index_.find(std::bit_cast<uint64_t>(descriptor));
+  if (existing != view_index_.end())
+    return TextureViewKey(descriptor, existing->second, info_.mipmap_level_count);
+  return TextureViewKey(descriptor, appendView(descriptor), info_.mipmap_level_count);
 }
 
 Texture::Texture(const WMTTextureInfo &descriptor, WMT::Device device) :
     info_(descriptor),
     device_(device) {
 
-  viewDescriptors_.push_back({
+  appendView({
       .format = info_.pixel_format,
       .type = info_.type,
       .firstMiplevel = 0,
@@ -125,8 +137,7 @@ Texture::Texture(const WMTTextureInfo &descriptor, WMT::Device device) :
       .firstArraySlice = 0,
       .arraySize = arrayLength(),
   });
-  version_ = 1;
-  fullView = TextureViewKey(viewDescriptors_[0], 0, info_.mipmap_level_count);
+  fullView = viewKey(0);
 }
 
 Texture::Texture(
@@ -141,7 +152,7 @@ Texture::Texture(
   assert(info_.mipmap_level_count == 1);
   assert(info_.array_length == 1);
 
-  viewDescriptors_.push_back({
+  appendView({
       .format = info_.pixel_format,
       .type = info_.type,
       .firstMiplevel = 0,
@@ -149,8 +160,35 @@ Texture::Texture(
       .firstArraySlice = 0,
       .arraySize = 1,
   });
-  version_ = 1;
-  fullView = TextureViewKey(viewDescriptors_[0], 0, info_.mipmap_level_count);
+  fullView = viewKey(0);
+}
+
+Texture::~Texture() {
+  for (auto &chunk : view_chunks_)
+    delete[] chunk.load(std::memory_order_relaxed);
+}
+
+/**
+ * Metal doesn't tell the size of a texture, this ignores alignment and
+ * padding of the actual layout.
+ */
+static uint64_t
+EstimateTextureSize(const WMTTextureInfo &info, uint32_t array_length) {
+  auto format = WMTPixelFormat(ORIGINAL_FORMAT(info.pixel_format));
+  // the texel size of a BC format is the size of a 4x4 block
+  bool block_compressed = format >= WMTPixelFormatBC1_RGBA && format <= WMTPixelFormatBC7_RGBAUnorm_sRGB;
+  uint64_t texels = 0;
+  for (uint32_t level = 0; level < info.mipmap_level_count; level++) {
+    uint64_t width = std::max(info.width >> level, 1u);
+    uint64_t height = std::max(info.height >> level, 1u);
+    uint64_t depth = std::max(info.depth >> level, 1u);
+    if (block_compressed) {
+      width = (width + 3) >> 2;
+      height = (height + 3) >> 2;
+    }
+    texels += width * height * depth;
+  }
+  return texels * MTLGetTexelSize(format) * array_length * std::max(info.sample_count, 1u);
 }
 
 Rc<TextureAllocation>
@@ -177,10 +215,15 @@ Texture::allocate(Flags<TextureAllocationFlag> flags) {
     buffer_info.memory.set(wsi::aligned_malloc(bytes_per_image_, DXMT_PAGE_SIZE));
 #endif
     auto buffer = device_.newBuffer(buffer_info);
-    return new TextureAllocation(this, std::move(buffer), buffer_info.memory.get(), info, bytes_per_row_, flags);
+    auto allocation =
+        new TextureAllocation(this, std::move(buffer), buffer_info.memory.get(), info, bytes_per_row_, flags);
+    allocation->trackMemory(bytes_per_image_);
+    return allocation;
   }
   auto texture = flags.test(TextureAllocationFlag::Shared) ? device_.newSharedTexture(info) : device_.newTexture(info);
-  return new TextureAllocation(this, std::move(texture), info, flags);
+  auto allocation = new TextureAllocation(this, std::move(texture), info, flags);
+  allocation->trackMemory(EstimateTextureSize(info_, arrayLength()));
+  return allocation;
 }
 
 Rc<TextureAllocation>
@@ -215,19 +258,22 @@ Texture::view(TextureViewKey key) {
 
 TextureView &
 Texture::view(TextureViewKey key, TextureAllocation* allocation) {
-  if (unlikely(allocation->version_ != version_)) {
-    prepareAllocationViews(allocation);
+  auto &views = allocation->cached_view_;
+  if (likely(key.index < views.size())) {
+    if (auto view = views[key.index].ptr(); likely(view != nullptr))
+      return *view;
   }
-  return *allocation->cached_view_[key.index];
+  return materializeView(key, allocation);
 }
 
 TextureViewKey Texture::checkViewUseArray(TextureViewKey key, bool isArray) {
-  std::shared_lock<dxmt::shared_mutex> shared_lock(mutex_);
-  auto view = viewDescriptors_[key.index];
-  shared_lock = {};
+  auto &entry = viewEntry(key.index);
+  auto view = entry.descriptor;
   static constexpr uint32_t ARRAY_TYPE_MASK = 0b0101001010;
   if (unlikely(bool((1 << uint32_t(view.type)) & ARRAY_TYPE_MASK) != isArray)) {
-    // TODO: this process can be cached
+    auto toggled = entry.array_toggled.load(std::memory_order_acquire);
+    if (likely(toggled != kNoView))
+      return viewKey(toggled);
     auto new_view_desc = view;
     switch (view.type) {
     case WMTTextureType1D:
@@ -265,19 +311,25 @@ TextureViewKey Texture::checkViewUseArray(TextureViewKey key, bool isArray) {
     default:
       return key; // should be unreachable
     }
-    return createView(new_view_desc);
+    auto new_key = createView(new_view_desc);
+    entry.array_toggled.store(new_key.index, std::memory_order_release);
+    return new_key;
   }
   return key;
 }
 
 TextureViewKey Texture::checkViewUseFormat(TextureViewKey key, WMTPixelFormat format) {
-  std::shared_lock<dxmt::shared_mutex> shared_lock(mutex_);
-  auto view = viewDescriptors_[key.index];
-  shared_lock = {};
+  auto &entry = viewEntry(key.index);
+  auto view = entry.descriptor;
   if (unlikely(view.format != format)) {
+    auto converted = entry.format_converted.load(std::memory_order_acquire);
+    if (likely((converted >> 32) == uint64_t(format)))
+      return viewKey(uint32_t(converted));
     auto new_view_desc = view;
     new_view_desc.format = format;
-    return createView(new_view_desc);
+    auto new_key = createView(new_view_desc);
+    entry.format_converted.store((uint64_t(format) << 32) | new_key.index, std::memory_order_release);
+    return new_key;
   }
   return key;
 }
@@ -7,6 +7,8 @@
 #include "thread.hpp"
 #include "util_flags.hpp"
 #include "util_svector.hpp"
+#include <bit>
+#include <unordered_map>
 
 namespace dxmt {
 
@@ -31,6 +33,8 @@ struct TextureViewDescriptor {
   uint32_t arraySize       : 12 = 1;
 };
 
+static_assert(sizeof(TextureViewDescriptor) == sizeof(uint64_t));
+
 struct TextureViewKey {
   union {
     struct {
@@ -86,8 +90,18 @@ public:
   TextureView(TextureAllocation *allocation);
   TextureView(TextureAllocation *allocation, unsigned index, TextureViewDescriptor descriptor);
 
+  /**
+   * \brief Number of views materialized so far, for statistics
+   */
+  static uint64_t
+  createdCount() {
+    return created_count_.load(std::memory_order_relaxed);
+  }
+
 private:
   std::atomic<uint32_t> refcount_ = {0u};
+
+  static inline std::atomic_uint64_t created_count_ = {0};
 };
 
 class TextureViewRef : public Rc<TextureView> {
@@ -146,10 +160,17 @@ private:
   TextureAllocation(const TextureAllocation &) = delete;
   TextureAllocation(TextureAllocation &&) = delete;
 
+  void trackMemory(uint64_t size);
+
   WMT::Reference<WMT::Texture> obj_;
   WMT::Reference<WMT::Buffer> buffer_;
-  uint32_t version_ = 0;
   Flags<TextureAllocationFlag> flags_;
+  /* accounted against the memory budget, imported textures aren't ours */
+  uint64_t tracked_size_ = 0;
+  /**
+   * indexed by `TextureViewKey::index`, a view is only created on first use
+   * and stays with the allocation while it is recycled
+   */
   small_vector<TextureViewRef, 4> cached_view_;
 };
 
@@ -178,14 +199,12 @@ public:
 
   WMTTextureType
   textureType(TextureViewKey view) {
-    std::shared_lock<dxmt::shared_mutex> lock(mutex_);
-    return viewDescriptors_[view.index].type;
+    return viewEntry(view.index).descriptor.type;
   }
 
   WMTPixelFormat
   pixelFormat(TextureViewKey view) {
-    std::shared_lock<dxmt::shared_mutex> lock(mutex_);
-    return viewDescriptors_[view.index].format;
+    return viewEntry(view.index).descriptor.format;
   }
 
   WMTTextureUsage
@@ -265,19 +284,57 @@ public:
 
   Texture(unsigned bytes_per_image, unsigned bytes_per_row, const WMTTextureInfo &info, WMT::Device device);
 
+  ~Texture();
+
 private:
-  void prepareAllocationViews(TextureAllocation* allocation);
+  /**
+   * Registered views are immutable and never removed, the table grows by
+   * chunks so readers don't need a lock. The memoized conversions are
+   * filled on first use.
+   */
+  struct ViewEntry {
+    TextureViewDescriptor descriptor;
+    /* index of the view with array-ness toggled */
+    std::atomic<uint32_t> array_toggled = kNoView;
+    /* (format << 32) | index of the last format conversion */
+    std::atomic<uint64_t> format_converted = kNoConversion;
+  };
+
+  static constexpr uint32_t kNoView = ~0u;
+  /* no pixel format is ~0u, unlike 0 which is WMTPixelFormatInvalid */
+  static constexpr uint64_t kNoConversion = ~0ull;
+  /* chunk N holds (kViewChunkBase << N) entries */
+  static constexpr uint32_t kViewChunkBase = 16;
+  static constexpr uint32_t kViewChunkCount = 24;
+
+  ViewEntry &
+  viewEntry(uint32_t index) {
+    auto chunk = std::bit_width(index / kViewChunkBase + 1) - 1;
+    auto base = kViewChunkBase * ((1u << chunk) - 1);
+    return view_chunks_[chunk].load(std::memory_order_acquire)[index - base];
+  }
+
+  TextureViewKey
+  viewKey(uint32_t index) {
+    return TextureViewKey(viewEntry(index).descriptor, index, info_.mipmap_level_count);
+  }
+
+  uint32_t appendView(TextureViewDescriptor const &descriptor);
+
+  TextureView &materializeView(TextureViewKey key, TextureAllocation *allocation);
 
   WMTTextureInfo info_;
   unsigned bytes_per_image_ = 0;
   unsigned bytes_per_row_ = 0;
 
   Rc<TextureAllocation> current_;
-  uint32_t version_ = 0;
   std::atomic<uint32_t> refcount_ = {0u};
 
-  small_vector<TextureViewDescriptor, 4> viewDescriptors_;
-  dxmt::shared_mutex mutex_;
+  std::atomic<ViewEntry *> view_chunks_[kViewChunkCount] = {};
+  uint32_t view_count_ = 0;
+  /* packed descriptor to view index, guarded by mutex_ */
+  std::unordered_map<uint64_t, uint32_t> view_index_;
+  dxmt::mutex mutex_;
   WMT::Device device_;
 };
 
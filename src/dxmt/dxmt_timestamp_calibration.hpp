@@ -0,0 +1,82 @@
+#pragma once
+
+#include "thread.hpp"
+#include <cmath>
+#include <cstdint>
+
+namespace dxmt {
+
+/**
+ * \brief Correlates GPU timestamps with the CPU clock
+ *
+ * Fed with pairs of CPU (nanoseconds) and GPU (ticks) timestamps sampled at
+ * the same moment. The GPU tick rate is derived from consecutive pairs. When
+ * the rate drifts beyond tolerance or the GPU clock goes backwards (e.g. after
+ * a power state change), a new epoch begins: timestamps from different epochs
+ * are not comparable.
+ */
+class TimestampCalibration {
+public:
+  static constexpr uint64_t kDefaultFrequency = 1'000'000'000;
+  // shorter intervals are dominated by sampling jitter
+  static constexpr uint64_t kMinimalInterval = 10'000'000;
+  static constexpr double kTolerance = 0.01;
+
+  /**
+   * \returns the current epoch
+   */
+  uint64_t
+  calibrate(uint64_t cpu_timestamp, uint64_t gpu_timestamp) {
+    std::unique_lock<dxmt::mutex> lock(mutex_);
+    if (!cpu_reference_) {
+      cpu_reference_ = cpu_timestamp;
+      gpu_reference_ = gpu_timestamp;
+      return epoch_;
+    }
+    if (cpu_timestamp <= cpu_reference_ || gpu_timestamp < gpu_reference_) {
+      epoch_++;
+      cpu_reference_ = cpu_timestamp;
+      gpu_reference_ = gpu_timestamp;
+      return epoch_;
+    }
+    uint64_t interval = cpu_timestamp - cpu_reference_;
+    if (interval < kMinimalInterval)
+      return epoch_;
+    double rate = double(gpu_timestamp - gpu_reference_) * 1e9 / double(interval);
+    if (frequency_ == 0.0) {
+      frequency_ = rate;
+    } else if (std::abs(rate - frequency_) > frequency_ * kTolerance) {
+      epoch_++;
+      frequency_ = rate;
+    } else {
+      frequency_ += (rate - frequency_) * 0.125;
+    }
+    cpu_reference_ = cpu_timestamp;
+    gpu_reference_ = gpu_timestamp;
+    return epoch_;
+  }
+
+  uint64_t
+  epoch() {
+    std::unique_lock<dxmt::mutex> lock(mutex_);
+    return epoch_;
+  }
+
+  /**
+   * \brief GPU ticks per second
+   */
+  uint64_t
+  frequency() {
+    std::unique_lock<dxmt::mutex> lock(mutex_);
+    return frequency_ == 0.0 ? kDefaultFrequency : uint64_t(frequency_ + 0.5);
+  }
+
+private:
+  dxmt::mutex mutex_;
+  uint64_t cpu_reference_ = 0;
+  uint64_t gpu_reference_ = 0;
+  double frequency_ = 0.0;
+  uint64_t epoch_ = 0;
+};
+
+} // namespace dxmt
@@ -0,0 +1,98 @@
+#include "dxmt_trace.hpp"
+#include "log/log.hpp"
+#include "thread.hpp"
+#include "util_env.hpp"
+#include "util_string.hpp"
+#include <algorithm>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+namespace dxmt {
+
+const bool Tracer::s_enabled = !env::getEnvVar("DXMT_TRACE_PATH").empty();
+
+static dxmt::mutex s_trace_buffers_mutex;
+static std::vector<std::unique_ptr<TraceBuffer>> s_trace_buffers;
+static thread_local TraceBuffer *s_current_trace_buffer = nullptr;
+
+TraceBuffer *
+Tracer::currentBuffer() {
+  if (likely(s_current_trace_buffer != nullptr))
+    return s_current_trace_buffer;
+  // registration happens once per thread, buffers outlive their threads
+  std::lock_guard<dxmt::mutex> lock(s_trace_buffers_mutex);
+  s_current_trace_buffer =
+      s_trace_buffers.emplace_back(std::make_unique<TraceBuffer>(dxmt::this_thread::get_id())).get();
+  return s_current_trace_buffer;
+}
+
+void
+Tracer::record(const char *name, clock::time_point begin, clock::time_point end, uint64_t arg) {
+  currentBuffer()->push(name, begin, end, arg);
+}
+
+void
+Tracer::setThreadName(const char *name) {
+  if (likely(!enabled()))
+    return;
+  currentBuffer()->thread_name_ = name;
+}
+
+static double
+toMicroseconds(clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count() / 1000.0;
+}
+
+void
+Tracer::dump() {
+  if (!enabled())
+    return;
+
+  std::string path = env::getEnvVar("DXMT_TRACE_PATH");
+  if (*path.rbegin() != '/')
+    path += '/';
+  path += env::getExeBaseName() + "_trace.json";
+
+  std::ofstream stream(str::topath(path.c_str()).c_str());
+  if (!stream) {
+    ERR("Tracer: failed to open ", path);
+    return;
+  }
+
+  std::lock_guard<dxmt::mutex> lock(s_trace_buffers_mutex);
+  std::vector<TraceEvent> snapshot;
+  bool first = true;
+  auto separator = [&]() -> const char * { return std::exchange(first, false) ? "\n" : ",\n"; };
+
+  stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (auto &buffer : s_trace_buffers) {
+    if (!buffer->thread_name_.empty()) {
+      stream << separator() << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid_
+             << ",\"name\":\"thread_name\",\"args\":{\"name\":\"" << buffer->thread_name_ << "\"}}";
+    }
+    uint64_t end = buffer->committed_.load(std::memory_order_acquire);
+    uint64_t begin = end > kTraceBufferCapacity ? end - kTraceBufferCapacity : 0;
+    snapshot.clear();
+    for (uint64_t i = begin; i < end; i++)
+      snapshot.push_back(buffer->events_[i % kTraceBufferCapacity]);
+    // the owner thread may still be running: drop entries it could have overwritten meanwhile
+    uint64_t end_after = buffer->committed_.load(std::memory_order_acquire);
+    uint64_t overwritten = end_after > kTraceBufferCapacity ? end_after - kTraceBufferCapacity : 0;
+    size_t skip = std::min<uint64_t>(overwritten > begin ? overwritten - begin : 0, snapshot.size());
+    for (size_t i = skip; i < snapshot.size(); i++) {
+      auto &event = snapshot[i];
+      stream << separator() << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid_ << ",\"name\":\"" << event.name
+             << "\",\"ts\":" << std::fixed << toMicroseconds(event.begin)
+             << ",\"dur\":" << toMicroseconds(event.end) - toMicroseconds(event.begin);
+      if (event.arg != kTraceNoArgument)
+        stream << ",\"args\":{\"value\":" << event.arg << "}";
+      stream << "}";
+    }
+  }
+  stream << "\n]}\n";
+
+  WARN("Tracer: timeline written to ", path);
+}
+
+} // namespace dxmt
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "dxmt_statistics.hpp"
+#include "util_likely.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace dxmt {
+
+struct TraceEvent {
+  const char *name;
+  clock::time_point begin;
+  clock::time_point end;
+  uint64_t arg;
+};
+
+constexpr size_t kTraceBufferCapacity = 0x10000;
+constexpr uint64_t kTraceNoArgument = ~0ull;
+
+/**
+ * \brief Per-thread span buffer
+ *
+ * Only written by its owner thread. Events are stored in a ring, so when
+ * the buffer is full the oldest spans are overwritten. A reader snapshots
+ * \c committed_ before and after copying to discard torn entries.
+ */
+class TraceBuffer {
+public:
+  TraceBuffer(uint32_t tid) : tid_(tid), events_(std::make_unique<TraceEvent[]>(kTraceBufferCapacity)) {}
+
+  void
+  push(const char *name, clock::time_point begin, clock::time_point end, uint64_t arg) {
+    auto index = committed_.load(std::memory_order_relaxed);
+    events_[index % kTraceBufferCapacity] = {name, begin, end, arg};
+    committed_.store(index + 1, std::memory_order_release);
+  }
+
+  uint32_t tid_;
+  std::string thread_name_;
+  std::unique_ptr<TraceEvent[]> events_;
+  std::atomic_uint64_t committed_ = 0;
+};
+
+/**
+ * \brief Timeline tracer
+ *
+ * Opt-in with \c DXMT_TRACE_PATH. Records spans from any thread without
+ * locking and writes them as Chrome trace JSON (loadable in Perfetto or
+ * chrome://tracing) when \c dump is called.
+ */
+class Tracer {
+public:
+  static bool
+  enabled() {
+    return s_enabled;
+  }
+
+  static void record(const char *name, clock::time_point begin, clock::time_point end, uint64_t arg);
+
+  static void setThreadName(const char *name);
+
+  static void dump();
+
+private:
+  static TraceBuffer *currentBuffer();
+
+  static const bool s_enabled;
+};
+
+class TraceScope {
+public:
+  TraceScope(const char *name, uint64_t arg = kTraceNoArgument) {
+    if (likely(!Tracer::enabled()))
+      return;
+    name_ = name;
+    arg_ = arg;
+    begin_ = clock::now();
+  }
+
+  ~TraceScope() {
+    if (name_)
+      Tracer::record(name_, begin_, clock::now(), arg_);
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  const char *name_ = nullptr;
+  uint64_t arg_;
+  clock::time_point begin_;
+};
+
+} // namespace dxmt
+
+#define DXMT_TRACE_CONCAT_(a, b) a##b
+#define DXMT_TRACE_CONCAT(a, b) DXMT_TRACE_CONCAT_(a, b)
+
+#define DXMT_TRACE_SCOPE(...) ::dxmt::TraceScope DXMT_TRACE_CONCAT(dxmt_trace_scope_, __LINE__)(__VA_ARGS__)
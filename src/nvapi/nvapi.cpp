@@ -153,10 +153,45 @@ NVAPI_INTERFACE NvAPI_D3D11_EndUAVOverlap(__in IUnknown *pDeviceOrContext) {
   return NVAPI_OK;
 }
 
+NVAPI_INTERFACE NvAPI_D3D11_MultiDrawInstancedIndirect(
+    __in ID3D11DeviceContext *pDevContext11, __in NvU32 drawCount, __in ID3D11Buffer *pBuffer,
+    __in NvU32 alignedByteOffsetForArgs, __in NvU32 alignedByteStrideForArgs
+) {
+  if (!pDevContext11 || !pBuffer)
+    return NVAPI_INVALID_ARGUMENT;
+  Com<IMTLD3D11ContextExt2> context;
+  if (FAILED(pDevContext11->QueryInterface(IID_PPV_ARGS(&context))))
+    return NVAPI_NOT_SUPPORTED;
+  context->MultiDrawInstancedIndirect(drawCount, pBuffer, alignedByteOffsetForArgs, alignedByteStrideForArgs);
+  return NVAPI_OK;
+}
+
+NVAPI_INTERFACE NvAPI_D3D11_MultiDrawIndexedInstancedIndirect(
+    __in ID3D11DeviceContext *pDevContext11, __in NvU32 drawCount, __in ID3D11Buffer *pBuffer,
+    __in NvU32 alignedByteOffsetForArgs, __in NvU32 alignedByteStrideForArgs
+) {
+  if (!pDevContext11 || !pBuffer)
+    return NVAPI_INVALID_ARGUMENT;
+  Com<IMTLD3D11ContextExt2> context;
+  if (FAILED(pDevContext11->QueryInterface(IID_PPV_ARGS(&context))))
+    return NVAPI_NOT_SUPPORTED;
+  context->MultiDrawIndexedInstancedIndirect(drawCount, pBuffer, alignedByteOffsetForArgs, alignedByteStrideForArgs);
+  return NVAPI_OK;
+}
+
 NVAPI_INTERFACE NvAPI_D3D11_SetDepthBoundsTest(IUnknown *pDeviceOrContext,
                                                NvU32 bEnable, float fMinDepth,
                                                float fMaxDepth) {
-  return NVAPI_NOT_SUPPORTED;
+  if (!pDeviceOrContext)
+    return NVAPI_INVALID_ARGUMENT;
+  auto context_ext = GetD3D11ContextExt(pDeviceOrContext);
+  if (!context_ext)
+    return NVAPI_INVALID_ARGUMENT;
+  Com<IMTLD3D11ContextExt2> context;
+  if (FAILED(context_ext->QueryInterface(IID_PPV_ARGS(&context))))
+    return NVAPI_NOT_SUPPORTED;
+  context->SetDepthBoundsTest(bEnable, fMinDepth, fMaxDepth);
+  return NVAPI_OK;
 }
 
 NVAPI_INTERFACE NvAPI_D3D11_IsNvShaderExtnOpCodeSupported(
@@ -827,6 +862,10 @@ extern "C" __cdecl void *nvapi_QueryInterface(NvU32 id) {
     return (void *)&NvAPI_D3D11_EndUAVOverlap;
   case 0x7aaf7a04:
     return (void *)&NvAPI_D3D11_SetDepthBoundsTest;
+  case 0xd4e26bbf:
+    return (void *)&NvAPI_D3D11_MultiDrawInstancedIndirect;
+  case 0x59e890f9:
+    return (void *)&NvAPI_D3D11_MultiDrawIndexedInstancedIndirect;
   case 0x5f68da40:
     return (void *)&NvAPI_D3D11_IsNvShaderExtnOpCodeSupported;
   case 0x8e90bb9f:
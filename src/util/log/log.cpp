@@ -8,7 +8,10 @@
  * See <https://github.com/doitsujin/dxvk/blob/master/LICENSE>
  */
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <unordered_map>
 #include <utility>
 
 #include "log.hpp"
@@ -18,88 +21,279 @@
 
 namespace dxmt {
 
+constexpr uint32_t kLogRepeatLimit = 10;
+constexpr uint64_t kLogRepeatWindowMs = 1000;
+
+static thread_local LogRing *s_currentRing = nullptr;
+
+static uint64_t currentTimeMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Logger::State {
+  State(LogLevel minLevel, const std::string &fileName)
+      : minLevel(minLevel), fileName(fileName) {}
+
+  const LogLevel minLevel;
+  const std::string fileName;
+
+  dxmt::mutex mutex;
+  std::ofstream fileStream;
+
+  bool initialized = false;
+  PFN_wineLogOutput wineLogOutput = nullptr;
+
+  std::vector<std::unique_ptr<LogRing>> rings;
+  std::atomic_uint64_t seq = 0;
+  std::vector<LogMessage> pending;
+
+  struct RepeatInfo {
+    LogLevel level;
+    uint32_t count;
+  };
+  std::unordered_map<std::string, RepeatInfo> repeats;
+  uint64_t repeatWindowStart = 0;
+
+  dxmt::mutex writerMutex;
+  dxmt::condition_variable writerCond;
+  dxmt::thread writer;
+  std::once_flag writerOnce;
+  std::atomic_uint32_t queued = 0;
+  std::atomic_bool stopWriter = false;
+
+  void emitMsg(LogLevel level, const std::string &message);
+
+  LogRing *currentRing();
+
+  void writerFunc();
+
+  void drainLocked();
+
+  void writeLocked(LogLevel level, const std::string &message);
+
+  void flushRepeatsLocked();
+
+  std::string getFileName(const std::string &base);
+};
+
 Logger::Logger(const std::string &fileName)
-    : m_minLevel(getMinLogLevel()), m_fileName(fileName) {}
+    : m_minLevel(getMinLogLevel()), m_state(new State(m_minLevel, fileName)) {}
+
+Logger::~Logger() {
+  if (this_thread::isInModuleDetachment()) {
+    // Under the loader lock the writer may be blocked or already
+    // killed, neither wait for it nor take a lock it may hold. The
+    // state is leaked so a writer that is still running never sees
+    // it destroyed, queued messages are dropped.
+    m_state->stopWriter = true;
+    m_state->writerCond.notify_one();
+    if (m_state->writer.joinable())
+      m_state->writer.detach();
+    return;
+  }
 
-Logger::~Logger() {}
+  {
+    std::lock_guard<dxmt::mutex> lock(m_state->writerMutex);
+    m_state->stopWriter = true;
+  }
+  m_state->writerCond.notify_one();
+  if (m_state->writer.joinable())
+    m_state->writer.join();
+
+  {
+    std::lock_guard<dxmt::mutex> lock(m_state->mutex);
+    m_state->drainLocked();
+    m_state->flushRepeatsLocked();
+  }
+  delete m_state;
+}
 
 void Logger::trace(const std::string &message) {
-  s_instance.emitMsg(LogLevel::Trace, message);
+  s_instance.m_state->emitMsg(LogLevel::Trace, message);
 }
 
 void Logger::debug(const std::string &message) {
-  s_instance.emitMsg(LogLevel::Debug, message);
+  s_instance.m_state->emitMsg(LogLevel::Debug, message);
 }
 
 void Logger::info(const std::string &message) {
-  s_instance.emitMsg(LogLevel::Info, message);
+  s_instance.m_state->emitMsg(LogLevel::Info, message);
 }
 
 void Logger::warn(const std::string &message) {
-  s_instance.emitMsg(LogLevel::Warn, message);
+  s_instance.m_state->emitMsg(LogLevel::Warn, message);
 }
 
 void Logger::err(const std::string &message) {
-  s_instance.emitMsg(LogLevel::Error, message);
+  s_instance.m_state->emitMsg(LogLevel::Error, message);
 }
 
 void Logger::log(LogLevel level, const std::string &message) {
-  s_instance.emitMsg(level, message);
+  s_instance.m_state->emitMsg(level, message);
+}
+
+void Logger::flush() {
+  std::lock_guard<dxmt::mutex> lock(s_instance.m_state->mutex);
+  s_instance.m_state->drainLocked();
+}
+
+void Logger::State::emitMsg(LogLevel level, const std::string &message) {
+  if (level < minLevel)
+    return;
+
+  // Errors may precede a crash, don't leave them in a queue
+  if (level >= LogLevel::Error) {
+    std::lock_guard<dxmt::mutex> lock(mutex);
+    drainLocked();
+    writeLocked(level, message);
+    return;
+  }
+
+  std::call_once(writerOnce, [this]() {
+    writer = dxmt::thread([this]() { writerFunc(); });
+  });
+
+  LogMessage entry = {seq.fetch_add(1, std::memory_order_relaxed), level,
+                      message};
+
+  if (unlikely(!currentRing()->push(std::move(entry)))) {
+    // Ring is full, write out everything on this thread
+    std::lock_guard<dxmt::mutex> lock(mutex);
+    drainLocked();
+    writeLocked(level, message);
+    return;
+  }
+
+  if (queued.fetch_add(1, std::memory_order_acq_rel) == 0) {
+    std::lock_guard<dxmt::mutex> lock(writerMutex);
+    writerCond.notify_one();
+  }
+}
+
+LogRing *Logger::State::currentRing() {
+  if (likely(s_currentRing != nullptr))
+    return s_currentRing;
+  // Rings are never freed so the writer can drain them after the
+  // owner thread has exited
+  std::lock_guard<dxmt::mutex> lock(mutex);
+  s_currentRing = rings.emplace_back(std::make_unique<LogRing>()).get();
+  return s_currentRing;
+}
+
+void Logger::State::writerFunc() {
+  env::setThreadName("dxmt-log-writer");
+
+  while (true) {
+    {
+      std::unique_lock<dxmt::mutex> lock(writerMutex);
+      writerCond.wait_for(lock, std::chrono::milliseconds(100), [this]() {
+        return stopWriter || queued.load(std::memory_order_acquire);
+      });
+      if (stopWriter)
+        break;
+    }
+
+    queued.store(0, std::memory_order_release);
+
+    std::lock_guard<dxmt::mutex> lock(mutex);
+    drainLocked();
+    if (currentTimeMs() - repeatWindowStart >= kLogRepeatWindowMs)
+      flushRepeatsLocked();
+  }
 }
 
-void Logger::emitMsg(LogLevel level, const std::string &message) {
-  if (level >= m_minLevel) {
-    std::lock_guard<dxmt::mutex> lock(m_mutex);
+void Logger::State::drainLocked() {
+  for (auto &ring : rings)
+    ring->drain([this](LogMessage &&message) {
+      pending.push_back(std::move(message));
+    });
 
-    static std::array<const char *, 5> s_prefixes = {
-        {"trace: ", "debug: ", "info:  ", "warn:  ", "err:   "}};
+  if (pending.empty())
+    return;
 
-    const char *prefix = s_prefixes.at(static_cast<uint32_t>(level));
+  std::sort(pending.begin(), pending.end(),
+            [](const LogMessage &a, const LogMessage &b) {
+              return a.seq < b.seq;
+            });
 
-    if (!std::exchange(m_initialized, true)) {
+  for (auto &message : pending)
+    writeLocked(message.level, message.text);
+
+  pending.clear();
+}
+
+void Logger::State::writeLocked(LogLevel level, const std::string &message) {
+  static std::array<const char *, 5> s_prefixes = {
+      {"trace: ", "debug: ", "info:  ", "warn:  ", "err:   "}};
+
+  if (!std::exchange(initialized, true)) {
 #ifdef _WIN32
-      HMODULE ntdll = GetModuleHandleA("ntdll.dll");
+    HMODULE ntdll = GetModuleHandleA("ntdll.dll");
 
-      if (ntdll)
-        m_wineLogOutput = reinterpret_cast<PFN_wineLogOutput>(
-            GetProcAddress(ntdll, "__wine_dbg_output"));
+    if (ntdll)
+      wineLogOutput = reinterpret_cast<PFN_wineLogOutput>(
+          GetProcAddress(ntdll, "__wine_dbg_output"));
 #endif
-      auto path = getFileName(m_fileName);
+    auto path = getFileName(fileName);
 
-      if (!path.empty())
-        m_fileStream = std::ofstream(str::topath(path.c_str()).c_str());
-    }
+    if (!path.empty())
+      fileStream = std::ofstream(str::topath(path.c_str()).c_str());
+  }
+
+  if (currentTimeMs() - repeatWindowStart >= kLogRepeatWindowMs)
+    flushRepeatsLocked();
 
-    std::stringstream stream(message);
-    std::string line;
+  auto &repeat = repeats.try_emplace(message, RepeatInfo{level, 0}).first->second;
+  if (++repeat.count > kLogRepeatLimit)
+    return;
 
-    while (std::getline(stream, line, '\n')) {
-      std::stringstream outstream;
-      outstream << prefix << line << std::endl;
+  const char *prefix = s_prefixes.at(static_cast<uint32_t>(level));
 
-      std::string adjusted = outstream.str();
+  std::stringstream stream(message);
+  std::string line;
 
-      if (!adjusted.empty()) {
-        if (m_wineLogOutput)
-          m_wineLogOutput(adjusted.c_str());
-        else
-          std::cerr << adjusted;
-      }
+  while (std::getline(stream, line, '\n')) {
+    std::stringstream outstream;
+    outstream << prefix << line << std::endl;
 
-      if (m_fileStream)
-        m_fileStream << adjusted;
+    std::string adjusted = outstream.str();
+
+    if (!adjusted.empty()) {
+      if (wineLogOutput)
+        wineLogOutput(adjusted.c_str());
+      else
+        std::cerr << adjusted;
     }
+
+    if (fileStream)
+      fileStream << adjusted;
+  }
+}
+
+void Logger::State::flushRepeatsLocked() {
+  repeatWindowStart = currentTimeMs();
+
+  auto flushed = std::move(repeats);
+  repeats.clear();
+
+  for (auto &[message, repeat] : flushed) {
+    if (repeat.count > kLogRepeatLimit)
+      writeLocked(repeat.level,
+                  str::format("(suppressed ", repeat.count - kLogRepeatLimit,
+                              " repeats) ", message));
   }
 }
 
-std::string Logger::getFileName(const std::string &base) {
+std::string Logger::State::getFileName(const std::string &base) {
   std::string path = env::getEnvVar("DXMT_LOG_PATH");
 
   if (path == "none")
     return std::string();
 
   // Don't create a log file if we're writing to wine's console output
-  if (path.empty() && m_wineLogOutput)
+  if (path.empty() && wineLogOutput)
     return std::string();
 
   if (!path.empty() && *path.rbegin() != '/')
@@ -10,10 +10,16 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "../thread.hpp"
+#include "../util_likely.hpp"
 #include "../util_string.hpp"
 
 namespace dxmt {
@@ -29,11 +35,55 @@ enum class LogLevel : uint32_t {
 
 using PFN_wineLogOutput = int(__cdecl *)(const char *);
 
+struct LogMessage {
+  uint64_t seq;
+  LogLevel level;
+  std::string text;
+};
+
+constexpr size_t kLogRingCapacity = 256;
+
+/**
+ * \brief Per-thread message ring
+ *
+ * Single producer (the owner thread), single consumer (whoever
+ * holds the logger mutex, usually the writer thread).
+ */
+class LogRing {
+public:
+  bool push(LogMessage &&message) {
+    auto head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) == kLogRingCapacity)
+      return false;
+    m_messages[head % kLogRingCapacity] = std::move(message);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  template <typename Fn> void drain(Fn &&fn) {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    auto head = m_head.load(std::memory_order_acquire);
+    for (; tail != head; tail++)
+      fn(std::move(m_messages[tail % kLogRingCapacity]));
+    m_tail.store(tail, std::memory_order_release);
+  }
+
+private:
+  std::array<LogMessage, kLogRingCapacity> m_messages;
+  std::atomic_uint64_t m_head = 0;
+  std::atomic_uint64_t m_tail = 0;
+};
+
 /**
  * \brief Logger
  *
  * Logger for one DLL. Creates a text file and
  * writes all log messages to that file.
+ *
+ * Messages are queued to a per-thread ring and written
+ * out by a background thread, errors are written out
+ * synchronously. Identical messages repeated in quick
+ * succession are rate-limited.
  */
 class Logger {
 
@@ -50,21 +100,26 @@ public:
 
   static LogLevel logLevel() { return s_instance.m_minLevel; }
 
+  static bool enabled(LogLevel level) { return level >= s_instance.m_minLevel; }
+
+  /**
+   * \brief Writes out all queued messages
+   */
+  static void flush();
+
 private:
   static Logger s_instance;
 
   const LogLevel m_minLevel;
-  const std::string m_fileName;
-
-  dxmt::mutex m_mutex;
-  std::ofstream m_fileStream;
-
-  bool m_initialized = false;
-  PFN_wineLogOutput m_wineLogOutput = nullptr;
 
-  void emitMsg(LogLevel level, const std::string &message);
-
-  std::string getFileName(const std::string &base);
+  /**
+   * \brief Logger state shared with the writer thread
+   *
+   * Heap allocated so that a writer left running at module
+   * detachment never observes it being destroyed.
+   */
+  struct State;
+  State *m_state;
 
   static LogLevel getMinLogLevel();
 };
@@ -72,16 +127,23 @@ private:
 } // namespace dxmt
 
 
-#define TRACE(...) Logger::trace(str::format(__VA_ARGS__))
+// Arguments are only formatted when the level is enabled
+#define DXMT_LOG_IF(level, fn, ...)                                            \
+  do {                                                                         \
+    if (unlikely(Logger::enabled(level)))                                      \
+      Logger::fn(str::format(__VA_ARGS__));                                    \
+  } while (0)
+
+#define TRACE(...) DXMT_LOG_IF(LogLevel::Trace, trace, __VA_ARGS__)
 
-#define DEBUG(...) Logger::debug(str::format(__VA_ARGS__))
+#define DEBUG(...) DXMT_LOG_IF(LogLevel::Debug, debug, __VA_ARGS__)
 
-#define WARN(...) Logger::warn(str::format(__VA_ARGS__))
+#define WARN(...) DXMT_LOG_IF(LogLevel::Warn, warn, __VA_ARGS__)
 
-#define ERR(...) Logger::err(str::format(__VA_ARGS__))
+#define ERR(...) DXMT_LOG_IF(LogLevel::Error, err, __VA_ARGS__)
 
 #define ERR_ONCE(...)                                                          \
   static bool s_errorShown = false;                                            \
   if (!std::exchange(s_errorShown, true)) {                                    \
-    Logger::err(str::format(__VA_ARGS__));                                     \
+    ERR(__VA_ARGS__);                                                          \
   }
@@ -10,6 +10,8 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 
 namespace dxmt {
 
@@ -26,4 +28,50 @@ private:
   size_t m_value = 0;
 };
 
+/**
+ * \brief Fast 64-bit hash of a byte range
+ *
+ * FNV-1a over 8-byte words with a murmur3 finalizer. Meant for
+ * in-process lookup of small plain descriptors, not for anything
+ * that is persisted.
+ */
+inline uint64_t
+HashBytes(const void *data, size_t size) {
+  auto bytes = static_cast<const unsigned char *>(data);
+  uint64_t h = 0xcbf29ce484222325ull ^ size;
+  for (; size >= 8; bytes += 8, size -= 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes, 8);
+    h = (h ^ word) * 0x100000001b3ull;
+  }
+  for (; size; bytes++, size--)
+    h = (h ^ *bytes) * 0x100000001b3ull;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+/**
+ * \brief Hash and equality over the object representation
+ *
+ * Only valid for types without indeterminate padding; callers zero
+ * such structures before filling them.
+ */
+template <typename T> struct BytewiseHash {
+  size_t
+  operator()(const T &v) const noexcept {
+    return HashBytes(&v, sizeof(T));
+  }
+};
+
+template <typename T> struct BytewiseEqual {
+  bool
+  operator()(const T &x, const T &y) const noexcept {
+    return std::memcmp(&x, &y, sizeof(T)) == 0;
+  }
+};
+
 } // namespace dxmt
\ No newline at end of file
@@ -529,6 +529,25 @@ public:
     cmd.fence = fence.handle;
     MTLComputeCommandEncoder_encodeCommands(handle, (const wmtcmd_base *)&cmd);
   }
+
+  void
+  useResource(Resource resource, WMTResourceUsage usage) {
+    struct wmtcmd_compute_useresource cmd;
+    cmd.type = WMTComputeCommandUseResource;
+    cmd.next.set(nullptr);
+    cmd.resource = resource;
+    cmd.usage = usage;
+    MTLComputeCommandEncoder_encodeCommands(handle, (const wmtcmd_base *)&cmd);
+  }
+
+  void
+  memoryBarrier(WMTBarrierScope scope) {
+    struct wmtcmd_compute_memory_barrier cmd;
+    cmd.type = WMTComputeCommandMemoryBarrier;
+    cmd.next.set(nullptr);
+    cmd.scope = scope;
+    MTLComputeCommandEncoder_encodeCommands(handle, (const wmtcmd_base *)&cmd);
+  }
 };
 
 class MetalDrawable : public Object {
@@ -614,6 +633,11 @@ public:
     return LogContainer{MTLCommandBuffer_logs(handle)};
   }
 
+  uint64_t
+  gpuStartTime() {
+    return MTLCommandBuffer_property(handle, WMTCommandBufferPropertyGPUStartTime);
+  }
+
   uint64_t
   gpuEndTime() {
     return MTLCommandBuffer_property(handle, WMTCommandBufferPropertyGPUEndTime);
@@ -906,6 +930,11 @@ public:
   newCounterSampleBuffer(uint32_t sample_count, bool shared = true) {
     return Reference<CounterSampleBuffer>(MTLCounterSampleBuffer_newTimestampBuffer(handle, sample_count, shared));
   }
+
+  void
+  sampleTimestamps(uint64_t &cpu_timestamp, uint64_t &gpu_timestamp) {
+    MTLDevice_sampleTimestamps(handle, &cpu_timestamp, &gpu_timestamp);
+  }
 };
 
 inline Reference<Array<Device>>
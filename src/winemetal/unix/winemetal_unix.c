@@ -9,6 +9,7 @@
 #include "objc/objc-runtime.h"
 #include <bootstrap.h>
 #include <mach/mach_port.h>
+#include <mach/mach_time.h>
 #define WINEMETAL_API
 #include "../winemetal_thunks.h"
 #include "../airconv_thunks.h"
@@ -2782,6 +2783,20 @@ _MTLCommandBuffer_property(void *obj) {
   return STATUS_SUCCESS;
 }
 
+static NTSTATUS
+_MTLDevice_sampleTimestamps(void *obj) {
+  struct unixcall_mtldevice_sampletimestamps *params = obj;
+  id<MTLDevice> device = (id<MTLDevice>)params->device;
+  MTLTimestamp cpu_timestamp = 0, gpu_timestamp = 0;
+  [device sampleTimestamps:&cpu_timestamp gpuTimestamp:&gpu_timestamp];
+  static mach_timebase_info_data_t timebase;
+  if (!timebase.denom)
+    mach_timebase_info(&timebase);
+  params->ret_cpu_timestamp = cpu_timestamp * timebase.numer / timebase.denom;
+  params->ret_gpu_timestamp = gpu_timestamp;
+  return STATUS_SUCCESS;
+}
+
 static NTSTATUS
 _MTLDevice_newTileRenderPipelineState(void *obj) {
   struct unixcall_mtldevice_newrenderpso *params = obj;
@@ -2974,6 +2989,7 @@ const void *__wine_unix_call_funcs[] = {
     &_MTLCommandBuffer_blitCommandEncoderWithSampleBuffers,
     &_MTLCommandBuffer_property,
     &_MTLDevice_newTileRenderPipelineState,
+    &_MTLDevice_sampleTimestamps,
 };
 
 #ifndef DXMT_NATIVE
@@ -3110,5 +3126,6 @@ const void *__wine_unix_call_wow64_funcs[] = {
     &_MTLCommandBuffer_blitCommandEncoderWithSampleBuffers,
     &_MTLCommandBuffer_property,
     &_MTLDevice_newTileRenderPipelineState,
+    &_MTLDevice_sampleTimestamps,
 };
 #endif
@@ -1948,4 +1948,10 @@ WINEMETAL_API obj_handle_t MTLDevice_newTileRenderPipelineState(
     obj_handle_t device, const struct WMTTileRenderPipelineInfo *info, obj_handle_t *err_out
 );
 
+/**
+ * CPU timestamp is in nanoseconds, GPU timestamp is in the time domain of counter sample buffers
+ */
+WINEMETAL_API void
+MTLDevice_sampleTimestamps(obj_handle_t device, uint64_t *cpu_timestamp, uint64_t *gpu_timestamp);
+
 #endif
\ No newline at end of file
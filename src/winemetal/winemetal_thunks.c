@@ -1179,3 +1179,14 @@ MTLDevice_newTileRenderPipelineState(
     *err_out = params.ret_error;
   return params.ret_pso;
 }
+
+WINEMETAL_API void
+MTLDevice_sampleTimestamps(obj_handle_t device, uint64_t *cpu_timestamp, uint64_t *gpu_timestamp) {
+  struct unixcall_mtldevice_sampletimestamps params;
+  params.device = device;
+  params.ret_cpu_timestamp = 0;
+  params.ret_gpu_timestamp = 0;
+  UNIX_CALL(132, &params);
+  *cpu_timestamp = params.ret_cpu_timestamp;
+  *gpu_timestamp = params.ret_gpu_timestamp;
+}
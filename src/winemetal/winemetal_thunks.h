@@ -371,6 +371,12 @@ struct unixcall_mtlcommandbuffer_blitcommandencoderwithsamplebuffers {
   obj_handle_t ret;
 };
 
+struct unixcall_mtldevice_sampletimestamps {
+  obj_handle_t device;
+  uint64_t ret_cpu_timestamp;
+  uint64_t ret_gpu_timestamp;
+};
+
 #pragma pack(pop)
 
 #endif
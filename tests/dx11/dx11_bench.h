@@ -0,0 +1,209 @@
+#pragma once
+
+// Shared setup of the dx11_bench_* programs: a window with a swap chain, so
+// that per-frame statistics show up in the Metal HUD (MTL_HUD_ENABLED=1),
+// and a CPU timer. Each program renders a fixed number of frames, prints
+// its measurements and exits.
+
+#include <cstdio>
+#include <cstring>
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define UNICODE
+#include <windows.h>
+#include <d3d11_1.h>
+#include <d3dcompiler.h>
+
+#include <assert.h>
+
+struct Bench {
+    HWND hwnd;
+    ID3D11Device1* device;
+    ID3D11DeviceContext1* context;
+    IDXGISwapChain1* swapChain;
+    ID3D11RenderTargetView* frameBufferView;
+    UINT width;
+    UINT height;
+};
+
+static LRESULT CALLBACK BenchWndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
+{
+    switch(msg)
+    {
+        case WM_KEYDOWN:
+            if(wparam == VK_ESCAPE)
+                DestroyWindow(hwnd);
+            return 0;
+        case WM_DESTROY:
+            PostQuitMessage(0);
+            return 0;
+        default:
+            return DefWindowProcW(hwnd, msg, wparam, lparam);
+    }
+}
+
+static bool BenchInit(HINSTANCE hInstance, const wchar_t* title, Bench& bench)
+{
+    bench.width = 1024;
+    bench.height = 768;
+    {
+        WNDCLASSEXW winClass = {};
+        winClass.cbSize = sizeof(WNDCLASSEXW);
+        winClass.style = CS_HREDRAW | CS_VREDRAW;
+        winClass.lpfnWndProc = &BenchWndProc;
+        winClass.hInstance = hInstance;
+        winClass.hCursor = LoadCursorW(0, IDC_ARROW);
+        winClass.lpszClassName = L"BenchWindowClass";
+        if(!RegisterClassExW(&winClass))
+            return false;
+
+        // fixed size, resizing would only add noise to the measurements
+        RECT initialRect = { 0, 0, (LONG)bench.width, (LONG)bench.height };
+        AdjustWindowRectEx(&initialRect, WS_OVERLAPPED | WS_CAPTION, FALSE, 0);
+        bench.hwnd = CreateWindowExW(0, winClass.lpszClassName, title,
+                                     WS_OVERLAPPED | WS_CAPTION | WS_VISIBLE,
+                                     CW_USEDEFAULT, CW_USEDEFAULT,
+                                     initialRect.right - initialRect.left,
+                                     initialRect.bottom - initialRect.top,
+                                     0, 0, hInstance, 0);
+        if(!bench.hwnd)
+            return false;
+    }
+
+    {
+        ID3D11Device* baseDevice;
+        ID3D11DeviceContext* baseDeviceContext;
+        D3D_FEATURE_LEVEL featureLevels[] = { D3D_FEATURE_LEVEL_11_0 };
+        HRESULT hResult = D3D11CreateDevice(0, D3D_DRIVER_TYPE_HARDWARE,
+                                            0, D3D11_CREATE_DEVICE_BGRA_SUPPORT,
+                                            featureLevels, ARRAYSIZE(featureLevels),
+                                            D3D11_SDK_VERSION, &baseDevice,
+                                            0, &baseDeviceContext);
+        if(FAILED(hResult))
+            return false;
+
+        hResult = baseDevice->QueryInterface(__uuidof(ID3D11Device1), (void**)&bench.device);
+        assert(SUCCEEDED(hResult));
+        baseDevice->Release();
+
+        hResult = baseDeviceContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&bench.context);
+        assert(SUCCEEDED(hResult));
+        baseDeviceContext->Release();
+    }
+
+    {
+        IDXGIFactory2* dxgiFactory;
+        {
+            IDXGIDevice1* dxgiDevice;
+            HRESULT hResult = bench.device->QueryInterface(__uuidof(IDXGIDevice1), (void**)&dxgiDevice);
+            assert(SUCCEEDED(hResult));
+
+            IDXGIAdapter* dxgiAdapter;
+            hResult = dxgiDevice->GetAdapter(&dxgiAdapter);
+            assert(SUCCEEDED(hResult));
+            dxgiDevice->Release();
+
+            hResult = dxgiAdapter->GetParent(__uuidof(IDXGIFactory2), (void**)&dxgiFactory);
+            assert(SUCCEEDED(hResult));
+            dxgiAdapter->Release();
+        }
+
+        DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
+        swapChainDesc.Width = bench.width;
+        swapChainDesc.Height = bench.height;
+        swapChainDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        swapChainDesc.SampleDesc.Count = 1;
+        swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+        swapChainDesc.BufferCount = 2;
+        swapChainDesc.Scaling = DXGI_SCALING_STRETCH;
+        swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+
+        HRESULT hResult = dxgiFactory->CreateSwapChainForHwnd(bench.device, bench.hwnd, &swapChainDesc, 0, 0, &bench.swapChain);
+        dxgiFactory->Release();
+        if(FAILED(hResult))
+            return false;
+    }
+
+    {
+        ID3D11Texture2D* frameBuffer;
+        HRESULT hResult = bench.swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&frameBuffer);
+        assert(SUCCEEDED(hResult));
+
+        hResult = bench.device->CreateRenderTargetView(frameBuffer, 0, &bench.frameBufferView);
+        assert(SUCCEEDED(hResult));
+        frameBuffer->Release();
+    }
+    return true;
+}
+
+static void BenchRelease(Bench& bench)
+{
+    bench.frameBufferView->Release();
+    bench.swapChain->Release();
+    bench.context->Release();
+    bench.device->Release();
+    DestroyWindow(bench.hwnd);
+}
+
+// returns false once the window has been closed
+static bool BenchPumpMessages()
+{
+    MSG msg = {};
+    while(PeekMessageW(&msg, 0, 0, 0, PM_REMOVE))
+    {
+        if(msg.message == WM_QUIT)
+            return false;
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+    return true;
+}
+
+static void BenchBeginFrame(Bench& bench)
+{
+    FLOAT backgroundColor[4] = { 0.1f, 0.2f, 0.6f, 1.0f };
+    bench.context->ClearRenderTargetView(bench.frameBufferView, backgroundColor);
+    D3D11_VIEWPORT viewport = { 0.0f, 0.0f, (FLOAT)bench.width, (FLOAT)bench.height, 0.0f, 1.0f };
+    bench.context->RSSetViewports(1, &viewport);
+    bench.context->OMSetRenderTargets(1, &bench.frameBufferView, nullptr);
+}
+
+static ID3DBlob* BenchCompileShader(const char* source, const char* entry, const char* target)
+{
+    ID3DBlob* blob = nullptr;
+    ID3DBlob* errors = nullptr;
+    HRESULT hResult = D3DCompile(source, strlen(source), nullptr, nullptr, nullptr, entry, target, 0, 0, &blob, &errors);
+    if(FAILED(hResult))
+    {
+        fprintf(stderr, "%s: %s\n", entry, errors ? (const char*)errors->GetBufferPointer() : "compilation failed");
+        if(errors)
+            errors->Release();
+        return nullptr;
+    }
+    return blob;
+}
+
+// milliseconds since an arbitrary point
+static double BenchNow()
+{
+    static LARGE_INTEGER frequency = {};
+    if(!frequency.QuadPart)
+        QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1000.0 / (double)frequency.QuadPart;
+}
+
+// blocks until the GPU has caught up with everything submitted so far
+static void BenchWaitIdle(Bench& bench)
+{
+    D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_EVENT, 0 };
+    ID3D11Query* query;
+    HRESULT hResult = bench.device->CreateQuery(&queryDesc, &query);
+    assert(SUCCEEDED(hResult));
+    bench.context->End(query);
+    BOOL done = FALSE;
+    while(bench.context->GetData(query, &done, sizeof(done), 0) != S_OK || !done)
+        Sleep(0);
+    query->Release();
+}
@@ -0,0 +1,207 @@
+// Draws many objects, each after a WRITE_DISCARD of its own vertex shader
+// constant buffer, while the pixel shader keeps a full set of constant
+// buffers and textures bound. This is the per-object constant update that
+// dominates a typical frame.
+//
+// Argument tables encoded per frame are shown in the Metal HUD
+// (MTL_HUD_ENABLED=1, "ArgTable: encoded+reused"). When a rename dirtied
+// every stage, each draw encoded the pixel shader tables again; now only
+// the vertex shader constant buffers are.
+
+#include "dx11_bench.h"
+
+static const char* shaderSource = R"(
+cbuffer PerObject : register(b4)
+{
+    float4 offsetScale;
+    float4 color;
+};
+
+struct VS_Output
+{
+    float4 position : SV_POSITION;
+    float4 color : COLOR;
+    float2 uv : TEXCOORD;
+};
+
+VS_Output vs_main(uint id : SV_VertexID)
+{
+    VS_Output output;
+    output.uv = float2(id & 1, id >> 1);
+    output.position = float4(offsetScale.xy + output.uv * offsetScale.zw, 0, 1);
+    output.color = color;
+    return output;
+}
+
+cbuffer Material0 : register(b0) { float4 tint0; };
+cbuffer Material1 : register(b1) { float4 tint1; };
+cbuffer Material2 : register(b2) { float4 tint2; };
+cbuffer Material3 : register(b3) { float4 tint3; };
+
+Texture2D textures[8] : register(t0);
+SamplerState smp : register(s0);
+
+float4 ps_main(VS_Output input) : SV_TARGET
+{
+    float4 result = input.color * tint0 * tint1 * tint2 * tint3;
+    [unroll] for (uint i = 0; i < 8; i++)
+        result += textures[i].Sample(smp, input.uv) * 0.01;
+    return result;
+}
+)";
+
+static const UINT kObjectCount = 2000;
+static const UINT kObjectBufferCount = 64;
+static const UINT kMaterialCount = 4;
+static const UINT kTextureCount = 8;
+static const UINT kWarmupFrames = 60;
+static const UINT kMeasuredFrames = 600;
+
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/, LPSTR /*lpCmdLine*/, int /*nShowCmd*/)
+{
+    Bench bench;
+    if(!BenchInit(hInstance, L"Benchmark: constant buffer discards", bench))
+    {
+        fprintf(stderr, "failed to initialize\n");
+        return 1;
+    }
+
+    ID3D11VertexShader* vertexShader;
+    ID3D11PixelShader* pixelShader;
+    {
+        ID3DBlob* vsBlob = BenchCompileShader(shaderSource, "vs_main", "vs_5_0");
+        ID3DBlob* psBlob = BenchCompileShader(shaderSource, "ps_main", "ps_5_0");
+        if(!vsBlob || !psBlob)
+            return 1;
+        HRESULT hResult = bench.device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &vertexShader);
+        assert(SUCCEEDED(hResult));
+        hResult = bench.device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &pixelShader);
+        assert(SUCCEEDED(hResult));
+        vsBlob->Release();
+        psBlob->Release();
+    }
+
+    // a pool of per-object buffers, as engines usually rotate a few of them
+    ID3D11Buffer* objectBuffers[kObjectBufferCount];
+    for(UINT i = 0; i < kObjectBufferCount; i++)
+    {
+        D3D11_BUFFER_DESC bufferDesc = {};
+        bufferDesc.ByteWidth = 32;
+        bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        HRESULT hResult = bench.device->CreateBuffer(&bufferDesc, nullptr, &objectBuffers[i]);
+        assert(SUCCEEDED(hResult));
+    }
+
+    ID3D11Buffer* materialBuffers[kMaterialCount];
+    for(UINT i = 0; i < kMaterialCount; i++)
+    {
+        float tint[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        D3D11_BUFFER_DESC bufferDesc = {};
+        bufferDesc.ByteWidth = sizeof(tint);
+        bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+        bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        D3D11_SUBRESOURCE_DATA data = { tint };
+        HRESULT hResult = bench.device->CreateBuffer(&bufferDesc, &data, &materialBuffers[i]);
+        assert(SUCCEEDED(hResult));
+    }
+
+    ID3D11Texture2D* texture;
+    ID3D11ShaderResourceView* textureViews[kTextureCount];
+    {
+        UINT pixels[16 * 16];
+        for(UINT i = 0; i < 16 * 16; i++)
+            pixels[i] = 0xff000000 | (i * 0x010203);
+        D3D11_TEXTURE2D_DESC textureDesc = {};
+        textureDesc.Width = 16;
+        textureDesc.Height = 16;
+        textureDesc.MipLevels = 1;
+        textureDesc.ArraySize = 1;
+        textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        textureDesc.SampleDesc.Count = 1;
+        textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+        textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        D3D11_SUBRESOURCE_DATA data = { pixels, 16 * 4 };
+        HRESULT hResult = bench.device->CreateTexture2D(&textureDesc, &data, &texture);
+        assert(SUCCEEDED(hResult));
+        for(UINT i = 0; i < kTextureCount; i++)
+        {
+            hResult = bench.device->CreateShaderResourceView(texture, nullptr, &textureViews[i]);
+            assert(SUCCEEDED(hResult));
+        }
+    }
+
+    ID3D11SamplerState* samplerState;
+    {
+        D3D11_SAMPLER_DESC samplerDesc = {};
+        samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+        samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+        samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+        samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+        samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+        HRESULT hResult = bench.device->CreateSamplerState(&samplerDesc, &samplerState);
+        assert(SUCCEEDED(hResult));
+    }
+
+    double measuredTime = 0;
+    UINT frame = 0;
+    while(frame < kWarmupFrames + kMeasuredFrames && BenchPumpMessages())
+    {
+        double frameStart = BenchNow();
+        BenchBeginFrame(bench);
+
+        bench.context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        bench.context->IASetInputLayout(nullptr);
+        bench.context->VSSetShader(vertexShader, nullptr, 0);
+        bench.context->PSSetShader(pixelShader, nullptr, 0);
+        bench.context->PSSetConstantBuffers(0, kMaterialCount, materialBuffers);
+        bench.context->PSSetShaderResources(0, kTextureCount, textureViews);
+        bench.context->PSSetSamplers(0, 1, &samplerState);
+
+        for(UINT i = 0; i < kObjectCount; i++)
+        {
+            ID3D11Buffer* objectBuffer = objectBuffers[i % kObjectBufferCount];
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            HRESULT hResult = bench.context->Map(objectBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+            assert(SUCCEEDED(hResult));
+            float* constants = (float*)mapped.pData;
+            constants[0] = -1.0f + (i % 50) * 0.04f;
+            constants[1] = -1.0f + (i / 50) * 0.05f;
+            constants[2] = 0.03f;
+            constants[3] = 0.04f;
+            constants[4] = (float)(i % 7) / 7.0f;
+            constants[5] = (float)(frame % 60) / 60.0f;
+            constants[6] = 0.5f;
+            constants[7] = 1.0f;
+            bench.context->Unmap(objectBuffer, 0);
+
+            bench.context->VSSetConstantBuffers(4, 1, &objectBuffer);
+            bench.context->Draw(4, 0);
+        }
+
+        bench.swapChain->Present(0, 0);
+        if(frame >= kWarmupFrames)
+            measuredTime += BenchNow() - frameStart;
+        frame++;
+    }
+    BenchWaitIdle(bench);
+
+    if(frame == kWarmupFrames + kMeasuredFrames)
+        printf("%u draws with a constant buffer discard each: %.3f ms CPU per frame, %.3f us per draw over %u frames\n",
+               kObjectCount, measuredTime / kMeasuredFrames, measuredTime * 1000.0 / kMeasuredFrames / kObjectCount,
+               kMeasuredFrames);
+
+    samplerState->Release();
+    for(UINT i = 0; i < kTextureCount; i++)
+        textureViews[i]->Release();
+    texture->Release();
+    for(UINT i = 0; i < kMaterialCount; i++)
+        materialBuffers[i]->Release();
+    for(UINT i = 0; i < kObjectBufferCount; i++)
+        objectBuffers[i]->Release();
+    pixelShader->Release();
+    vertexShader->Release();
+    BenchRelease(bench);
+    return 0;
+}
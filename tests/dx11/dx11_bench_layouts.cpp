@@ -0,0 +1,176 @@
+// Draws once with every combination of several vertex shaders and input
+// layouts, like a scene that mixes meshes of different vertex formats with
+// materials sharing their vertex inputs. The layouts only differ in
+// elements the shaders don't consume and in declaration order.
+//
+// The first pass compiles the pipelines, later passes only look them up.
+// SM50 compiles, compile time and shared fetch layouts are shown in the
+// Metal HUD (MTL_HUD_ENABLED=1). Vertex shader variants used to be compiled
+// for each combination, now they are compiled once per vertex shader.
+
+#include "dx11_bench.h"
+
+static const char* vertexShaderTemplate = R"(
+struct VS_Input
+{
+    float3 position : POSITION;
+    float2 uv : TEXCOORD;
+};
+
+struct VS_Output
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD;
+};
+
+VS_Output vs_main(VS_Input input)
+{
+    VS_Output output;
+    output.position = float4(input.position * %u.0 / %u.0, 1);
+    output.uv = input.uv;
+    return output;
+}
+)";
+
+static const char* pixelShaderSource = R"(
+float4 ps_main(float4 position : SV_POSITION, float2 uv : TEXCOORD) : SV_TARGET
+{
+    return float4(uv, 0, 1);
+}
+)";
+
+static const UINT kShaderCount = 8;
+static const UINT kLayoutCount = 8;
+static const UINT kVertexStride = 64;
+static const UINT kWarmPasses = 100;
+
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/, LPSTR /*lpCmdLine*/, int /*nShowCmd*/)
+{
+    Bench bench;
+    if(!BenchInit(hInstance, L"Benchmark: input layouts shared by vertex shaders", bench))
+    {
+        fprintf(stderr, "failed to initialize\n");
+        return 1;
+    }
+
+    ID3D11VertexShader* vertexShaders[kShaderCount];
+    ID3DBlob* signatureBlob = nullptr;
+    for(UINT i = 0; i < kShaderCount; i++)
+    {
+        // same input signature, different bodies
+        char source[1024];
+        snprintf(source, sizeof(source), vertexShaderTemplate, i + 1, kShaderCount);
+        ID3DBlob* vsBlob = BenchCompileShader(source, "vs_main", "vs_5_0");
+        if(!vsBlob)
+            return 1;
+        HRESULT hResult = bench.device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &vertexShaders[i]);
+        assert(SUCCEEDED(hResult));
+        if(!signatureBlob)
+            signatureBlob = vsBlob;
+        else
+            vsBlob->Release();
+    }
+
+    ID3D11PixelShader* pixelShader;
+    {
+        ID3DBlob* psBlob = BenchCompileShader(pixelShaderSource, "ps_main", "ps_5_0");
+        if(!psBlob)
+            return 1;
+        HRESULT hResult = bench.device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &pixelShader);
+        assert(SUCCEEDED(hResult));
+        psBlob->Release();
+    }
+
+    // POSITION and TEXCOORD always at the same offsets, optional elements
+    // after them, in reverse order for every other layout
+    ID3D11InputLayout* inputLayouts[kLayoutCount];
+    for(UINT m = 0; m < kLayoutCount; m++)
+    {
+        D3D11_INPUT_ELEMENT_DESC elements[5];
+        UINT count = 0;
+        elements[count++] = { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        elements[count++] = { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        if(m & 1)
+            elements[count++] = { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 20, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        if(m & 2)
+            elements[count++] = { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 32, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        if(m & 4)
+            elements[count++] = { "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 36, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+        if(m & 1)
+        {
+            for(UINT i = 0; i < count / 2; i++)
+            {
+                D3D11_INPUT_ELEMENT_DESC element = elements[i];
+                elements[i] = elements[count - 1 - i];
+                elements[count - 1 - i] = element;
+            }
+        }
+        HRESULT hResult = bench.device->CreateInputLayout(elements, count, signatureBlob->GetBufferPointer(), signatureBlob->GetBufferSize(), &inputLayouts[m]);
+        assert(SUCCEEDED(hResult));
+    }
+    signatureBlob->Release();
+
+    ID3D11Buffer* vertexBuffer;
+    {
+        char vertices[3 * kVertexStride] = {};
+        float* position = (float*)vertices;
+        position[0] = -0.5f; position[1] = -0.5f;
+        position = (float*)(vertices + kVertexStride);
+        position[0] = 0.0f; position[1] = 0.5f;
+        position = (float*)(vertices + 2 * kVertexStride);
+        position[0] = 0.5f; position[1] = -0.5f;
+        D3D11_BUFFER_DESC bufferDesc = {};
+        bufferDesc.ByteWidth = sizeof(vertices);
+        bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+        bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        D3D11_SUBRESOURCE_DATA data = { vertices };
+        HRESULT hResult = bench.device->CreateBuffer(&bufferDesc, &data, &vertexBuffer);
+        assert(SUCCEEDED(hResult));
+    }
+
+    double firstPassTime = 0;
+    double warmTime = 0;
+    UINT pass = 0;
+    while(pass < 1 + kWarmPasses && BenchPumpMessages())
+    {
+        double passStart = BenchNow();
+        BenchBeginFrame(bench);
+
+        UINT stride = kVertexStride;
+        UINT offset = 0;
+        bench.context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        bench.context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+        bench.context->PSSetShader(pixelShader, nullptr, 0);
+        for(UINT m = 0; m < kLayoutCount; m++)
+        {
+            bench.context->IASetInputLayout(inputLayouts[m]);
+            for(UINT i = 0; i < kShaderCount; i++)
+            {
+                bench.context->VSSetShader(vertexShaders[i], nullptr, 0);
+                bench.context->Draw(3, 0);
+            }
+        }
+
+        bench.swapChain->Present(0, 0);
+        // includes waiting for the pipelines the draws need
+        BenchWaitIdle(bench);
+        if(pass == 0)
+            firstPassTime = BenchNow() - passStart;
+        else
+            warmTime += BenchNow() - passStart;
+        pass++;
+    }
+
+    if(pass == 1 + kWarmPasses)
+        printf("%u vertex shaders x %u input layouts: first pass %.3f ms, later passes %.3f ms\n",
+               kShaderCount, kLayoutCount, firstPassTime, warmTime / kWarmPasses);
+
+    vertexBuffer->Release();
+    for(UINT m = 0; m < kLayoutCount; m++)
+        inputLayouts[m]->Release();
+    pixelShader->Release();
+    for(UINT i = 0; i < kShaderCount; i++)
+        vertexShaders[i]->Release();
+    BenchRelease(bench);
+    return 0;
+}
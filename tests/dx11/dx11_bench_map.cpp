@@ -0,0 +1,211 @@
+// Compares mapping a default-usage buffer with CPU access in place against
+// the staging round-trip that is needed without MapOnDefaultBuffers, for
+// uploads consumed by a draw and for readbacks of data written by the GPU.
+//
+// Each mode runs a fixed number of iterations and prints the CPU time per
+// iteration, including the time spent waiting for the GPU.
+
+#include "dx11_bench.h"
+
+static const char* shaderSource = R"(
+float4 vs_main(float4 position : POSITION) : SV_POSITION
+{
+    return float4(position.xy, 0, 1);
+}
+
+float4 ps_main() : SV_TARGET
+{
+    return float4(1, 1, 1, 1);
+}
+)";
+
+static const UINT kVertexCount = 4096;
+static const UINT kBufferSize = kVertexCount * 16;
+static const UINT kIterationsPerFrame = 16;
+static const UINT kWarmupFrames = 20;
+static const UINT kMeasuredFrames = 200;
+
+enum class Mode {
+    UploadInPlace,
+    UploadStaging,
+    ReadbackInPlace,
+    ReadbackStaging,
+};
+
+static const char* modeNames[] = {
+    "upload, in place",
+    "upload, staging round-trip",
+    "readback, in place",
+    "readback, staging round-trip",
+};
+
+struct Resources {
+    ID3D11VertexShader* vertexShader;
+    ID3D11PixelShader* pixelShader;
+    ID3D11InputLayout* inputLayout;
+    // default usage with CPU access, mapped in place
+    ID3D11Buffer* mappable;
+    // default usage without CPU access, updated through staging
+    ID3D11Buffer* gpuOnly;
+    ID3D11Buffer* staging;
+    // written to the buffers under test by the GPU before a readback
+    ID3D11Buffer* source;
+};
+
+static float uploadData[kBufferSize / 4];
+static float readbackData[kBufferSize / 4];
+
+static void Iterate(Bench& bench, Resources& res, Mode mode)
+{
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT hResult;
+    ID3D11Buffer* vertexBuffer = nullptr;
+    switch(mode)
+    {
+        case Mode::UploadInPlace:
+            // waits for the draw of the previous iteration to have read the buffer
+            hResult = bench.context->Map(res.mappable, 0, D3D11_MAP_WRITE, 0, &mapped);
+            assert(SUCCEEDED(hResult));
+            memcpy(mapped.pData, uploadData, kBufferSize);
+            bench.context->Unmap(res.mappable, 0);
+            vertexBuffer = res.mappable;
+            break;
+        case Mode::UploadStaging:
+            hResult = bench.context->Map(res.staging, 0, D3D11_MAP_WRITE, 0, &mapped);
+            assert(SUCCEEDED(hResult));
+            memcpy(mapped.pData, uploadData, kBufferSize);
+            bench.context->Unmap(res.staging, 0);
+            bench.context->CopyResource(res.gpuOnly, res.staging);
+            vertexBuffer = res.gpuOnly;
+            break;
+        case Mode::ReadbackInPlace:
+            bench.context->CopyResource(res.mappable, res.source);
+            // waits only for the copy, the last writer
+            hResult = bench.context->Map(res.mappable, 0, D3D11_MAP_READ, 0, &mapped);
+            assert(SUCCEEDED(hResult));
+            memcpy(readbackData, mapped.pData, kBufferSize);
+            bench.context->Unmap(res.mappable, 0);
+            return;
+        case Mode::ReadbackStaging:
+            bench.context->CopyResource(res.gpuOnly, res.source);
+            bench.context->CopyResource(res.staging, res.gpuOnly);
+            hResult = bench.context->Map(res.staging, 0, D3D11_MAP_READ, 0, &mapped);
+            assert(SUCCEEDED(hResult));
+            memcpy(readbackData, mapped.pData, kBufferSize);
+            bench.context->Unmap(res.staging, 0);
+            return;
+    }
+
+    UINT stride = 16;
+    UINT offset = 0;
+    bench.context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+    bench.context->Draw(kVertexCount, 0);
+}
+
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/, LPSTR /*lpCmdLine*/, int /*nShowCmd*/)
+{
+    Bench bench;
+    if(!BenchInit(hInstance, L"Benchmark: map default buffers", bench))
+    {
+        fprintf(stderr, "failed to initialize\n");
+        return 1;
+    }
+
+    D3D11_FEATURE_DATA_D3D11_OPTIONS1 options1 = {};
+    bench.device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS1, &options1, sizeof(options1));
+    if(!options1.MapOnDefaultBuffers)
+    {
+        fprintf(stderr, "MapOnDefaultBuffers is not supported\n");
+        return 1;
+    }
+
+    Resources res;
+    {
+        ID3DBlob* vsBlob = BenchCompileShader(shaderSource, "vs_main", "vs_5_0");
+        ID3DBlob* psBlob = BenchCompileShader(shaderSource, "ps_main", "ps_5_0");
+        if(!vsBlob || !psBlob)
+            return 1;
+        HRESULT hResult = bench.device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &res.vertexShader);
+        assert(SUCCEEDED(hResult));
+        hResult = bench.device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &res.pixelShader);
+        assert(SUCCEEDED(hResult));
+
+        D3D11_INPUT_ELEMENT_DESC inputElementDesc[] =
+        {
+            { "POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        };
+        hResult = bench.device->CreateInputLayout(inputElementDesc, ARRAYSIZE(inputElementDesc), vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &res.inputLayout);
+        assert(SUCCEEDED(hResult));
+        vsBlob->Release();
+        psBlob->Release();
+    }
+
+    for(UINT i = 0; i < kBufferSize / 4; i++)
+        uploadData[i] = (float)(i % 7) / 7.0f - 0.5f;
+
+    {
+        D3D11_BUFFER_DESC bufferDesc = {};
+        bufferDesc.ByteWidth = kBufferSize;
+        bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE | D3D11_CPU_ACCESS_READ;
+        HRESULT hResult = bench.device->CreateBuffer(&bufferDesc, nullptr, &res.mappable);
+        if(FAILED(hResult))
+        {
+            fprintf(stderr, "failed to create a default buffer with CPU access\n");
+            return 1;
+        }
+
+        bufferDesc.CPUAccessFlags = 0;
+        hResult = bench.device->CreateBuffer(&bufferDesc, nullptr, &res.gpuOnly);
+        assert(SUCCEEDED(hResult));
+
+        D3D11_SUBRESOURCE_DATA data = { uploadData };
+        hResult = bench.device->CreateBuffer(&bufferDesc, &data, &res.source);
+        assert(SUCCEEDED(hResult));
+
+        bufferDesc.Usage = D3D11_USAGE_STAGING;
+        bufferDesc.BindFlags = 0;
+        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE | D3D11_CPU_ACCESS_READ;
+        hResult = bench.device->CreateBuffer(&bufferDesc, nullptr, &res.staging);
+        assert(SUCCEEDED(hResult));
+    }
+
+    bool isRunning = true;
+    for(UINT m = 0; m < ARRAYSIZE(modeNames) && isRunning; m++)
+    {
+        Mode mode = (Mode)m;
+        double measuredTime = 0;
+        UINT frame = 0;
+        for(; frame < kWarmupFrames + kMeasuredFrames; frame++)
+        {
+            if(!(isRunning = BenchPumpMessages()))
+                break;
+            double frameStart = BenchNow();
+            BenchBeginFrame(bench);
+            bench.context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
+            bench.context->IASetInputLayout(res.inputLayout);
+            bench.context->VSSetShader(res.vertexShader, nullptr, 0);
+            bench.context->PSSetShader(res.pixelShader, nullptr, 0);
+            for(UINT i = 0; i < kIterationsPerFrame; i++)
+                Iterate(bench, res, mode);
+            bench.swapChain->Present(0, 0);
+            if(frame >= kWarmupFrames)
+                measuredTime += BenchNow() - frameStart;
+        }
+        BenchWaitIdle(bench);
+        if(isRunning)
+            printf("%-30s %u bytes: %.3f us CPU per iteration over %u iterations\n", modeNames[m], kBufferSize,
+                   measuredTime * 1000.0 / (kMeasuredFrames * kIterationsPerFrame), kMeasuredFrames * kIterationsPerFrame);
+    }
+
+    res.source->Release();
+    res.staging->Release();
+    res.gpuOnly->Release();
+    res.mappable->Release();
+    res.inputLayout->Release();
+    res.pixelShader->Release();
+    res.vertexShader->Release();
+    BenchRelease(bench);
+    return 0;
+}
@@ -0,0 +1,186 @@
+// Renames dynamic textures that have several views registered, the way a
+// game streaming per-frame texture data does: every frame each texture is
+// mapped with WRITE_DISCARD and sampled through one of its views.
+//
+// Texture views created per frame are shown in the Metal HUD
+// (MTL_HUD_ENABLED=1, "TexView: N created"). Before views were created on
+// demand that was every registered view of every renamed texture, now it is
+// at most one per texture and frame.
+
+#include "dx11_bench.h"
+
+static const char* shaderSource = R"(
+struct VS_Output
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD;
+};
+
+VS_Output vs_main(uint id : SV_VertexID)
+{
+    VS_Output output;
+    output.uv = float2(id & 1, id >> 1);
+    output.position = float4(output.uv * float2(2, -2) + float2(-1, 1), 0, 1);
+    return output;
+}
+
+Texture2D tex : register(t0);
+Texture2DArray texArray;
+SamplerState smp : register(s0);
+
+float4 ps_main(VS_Output input) : SV_TARGET
+{
+    return tex.Sample(smp, input.uv);
+}
+
+float4 ps_array_main(VS_Output input) : SV_TARGET
+{
+    return texArray.Sample(smp, float3(input.uv, 0));
+}
+)";
+
+static const UINT kTextureCount = 64;
+static const UINT kTextureSize = 64;
+static const UINT kViewCount = 4;
+static const UINT kWarmupFrames = 60;
+static const UINT kMeasuredFrames = 600;
+
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/, LPSTR /*lpCmdLine*/, int /*nShowCmd*/)
+{
+    Bench bench;
+    if(!BenchInit(hInstance, L"Benchmark: texture views of renamed textures", bench))
+    {
+        fprintf(stderr, "failed to initialize\n");
+        return 1;
+    }
+
+    ID3D11VertexShader* vertexShader;
+    ID3D11PixelShader* pixelShader;
+    ID3D11PixelShader* pixelShaderArray;
+    {
+        ID3DBlob* vsBlob = BenchCompileShader(shaderSource, "vs_main", "vs_5_0");
+        ID3DBlob* psBlob = BenchCompileShader(shaderSource, "ps_main", "ps_5_0");
+        ID3DBlob* psArrayBlob = BenchCompileShader(shaderSource, "ps_array_main", "ps_5_0");
+        if(!vsBlob || !psBlob || !psArrayBlob)
+            return 1;
+        HRESULT hResult = bench.device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &vertexShader);
+        assert(SUCCEEDED(hResult));
+        hResult = bench.device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &pixelShader);
+        assert(SUCCEEDED(hResult));
+        hResult = bench.device->CreatePixelShader(psArrayBlob->GetBufferPointer(), psArrayBlob->GetBufferSize(), nullptr, &pixelShaderArray);
+        assert(SUCCEEDED(hResult));
+        vsBlob->Release();
+        psBlob->Release();
+        psArrayBlob->Release();
+    }
+
+    ID3D11SamplerState* samplerState;
+    {
+        D3D11_SAMPLER_DESC samplerDesc = {};
+        samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
+        samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+        samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+        samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+        samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+        HRESULT hResult = bench.device->CreateSamplerState(&samplerDesc, &samplerState);
+        assert(SUCCEEDED(hResult));
+    }
+
+    // typeless, so that both UNORM and SRGB views can be created
+    ID3D11Texture2D* textures[kTextureCount];
+    ID3D11ShaderResourceView* views[kTextureCount][kViewCount];
+    for(UINT i = 0; i < kTextureCount; i++)
+    {
+        D3D11_TEXTURE2D_DESC textureDesc = {};
+        textureDesc.Width = kTextureSize;
+        textureDesc.Height = kTextureSize;
+        textureDesc.MipLevels = 1;
+        textureDesc.ArraySize = 1;
+        textureDesc.Format = DXGI_FORMAT_R8G8B8A8_TYPELESS;
+        textureDesc.SampleDesc.Count = 1;
+        textureDesc.Usage = D3D11_USAGE_DYNAMIC;
+        textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        HRESULT hResult = bench.device->CreateTexture2D(&textureDesc, nullptr, &textures[i]);
+        if(FAILED(hResult))
+        {
+            fprintf(stderr, "failed to create a dynamic typeless texture\n");
+            return 1;
+        }
+
+        for(UINT v = 0; v < kViewCount; v++)
+        {
+            D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+            viewDesc.Format = (v & 1) ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+            if(v & 2)
+            {
+                viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+                viewDesc.Texture2DArray.MipLevels = 1;
+                viewDesc.Texture2DArray.ArraySize = 1;
+            }
+            else
+            {
+                viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+                viewDesc.Texture2D.MipLevels = 1;
+            }
+            hResult = bench.device->CreateShaderResourceView(textures[i], &viewDesc, &views[i][v]);
+            assert(SUCCEEDED(hResult));
+        }
+    }
+
+    double measuredTime = 0;
+    UINT frame = 0;
+    while(frame < kWarmupFrames + kMeasuredFrames && BenchPumpMessages())
+    {
+        double frameStart = BenchNow();
+        BenchBeginFrame(bench);
+
+        bench.context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        bench.context->IASetInputLayout(nullptr);
+        bench.context->VSSetShader(vertexShader, nullptr, 0);
+        bench.context->PSSetSamplers(0, 1, &samplerState);
+
+        for(UINT i = 0; i < kTextureCount; i++)
+        {
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            HRESULT hResult = bench.context->Map(textures[i], 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+            assert(SUCCEEDED(hResult));
+            for(UINT row = 0; row < kTextureSize; row++)
+                memset((char*)mapped.pData + row * mapped.RowPitch, (int)(frame + i + row), kTextureSize * 4);
+            bench.context->Unmap(textures[i], 0);
+
+            // one of the views, a different one every frame
+            UINT v = (frame + i) % kViewCount;
+            bench.context->PSSetShader((v & 2) ? pixelShaderArray : pixelShader, nullptr, 0);
+            bench.context->PSSetShaderResources(0, 1, &views[i][v]);
+
+            UINT tile = bench.width / 8;
+            D3D11_VIEWPORT viewport = { (FLOAT)(i % 8 * tile), (FLOAT)(i / 8 * tile), (FLOAT)tile, (FLOAT)tile, 0.0f, 1.0f };
+            bench.context->RSSetViewports(1, &viewport);
+            bench.context->Draw(4, 0);
+        }
+
+        bench.swapChain->Present(0, 0);
+        if(frame >= kWarmupFrames)
+            measuredTime += BenchNow() - frameStart;
+        frame++;
+    }
+    BenchWaitIdle(bench);
+
+    if(frame == kWarmupFrames + kMeasuredFrames)
+        printf("%u textures with %u views renamed per frame: %.3f ms CPU per frame over %u frames\n",
+               kTextureCount, kViewCount, measuredTime / kMeasuredFrames, kMeasuredFrames);
+
+    for(UINT i = 0; i < kTextureCount; i++)
+    {
+        for(UINT v = 0; v < kViewCount; v++)
+            views[i][v]->Release();
+        textures[i]->Release();
+    }
+    samplerState->Release();
+    pixelShaderArray->Release();
+    pixelShader->Release();
+    vertexShader->Release();
+    BenchRelease(bench);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "dxmt_tasks.hpp"
+#include "log/log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace dxmt;
+using bench_clock = std::chrono::steady_clock;
+
+Logger Logger::s_instance("bench_task_scheduler.log");
+
+/**
+ * Stands in for a shader or pipeline compile: spins for \c work, optionally
+ * after \c dependency has completed
+ */
+struct BenchTask {
+  std::chrono::nanoseconds work{0};
+  BenchTask *dependency = nullptr;
+  std::atomic_bool queued = false;
+  std::atomic_bool done = false;
+  std::atomic_uint64_t *completed = nullptr;
+  bench_clock::time_point submitted;
+  bench_clock::time_point finished;
+};
+
+template <> struct dxmt::task_trait<BenchTask *> {
+  BenchTask *
+  run_task(BenchTask *task) {
+    if (task->dependency && !task->dependency->done.load(std::memory_order_acquire))
+      return task->dependency;
+    auto until = bench_clock::now() + task->work;
+    while (bench_clock::now() < until) {
+    }
+    return task;
+  }
+  bool get_done(BenchTask *task) { return task->done.load(std::memory_order_acquire); }
+  void
+  set_done(BenchTask *task) {
+    task->finished = bench_clock::now();
+    task->done.store(true, std::memory_order_release);
+    task->done.notify_all();
+    if (task->completed) {
+      task->completed->fetch_add(1, std::memory_order_release);
+      task->completed->notify_all();
+    }
+  }
+  void set_queued(BenchTask *task) { task->queued.store(true, std::memory_order_release); }
+  bool get_queued(BenchTask *task) { return task->queued.load(std::memory_order_acquire); }
+  bool try_dequeue(BenchTask *task) { return task->queued.exchange(false, std::memory_order_acq_rel); }
+};
+
+static void
+waitCompleted(std::atomic_uint64_t &completed, uint64_t count) {
+  for (auto value = completed.load(std::memory_order_acquire); value < count;
+       value = completed.load(std::memory_order_acquire))
+    completed.wait(value, std::memory_order_acquire);
+}
+
+static double
+milliseconds(bench_clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+/**
+ * Many tiny tasks submitted at once from several threads, like the shader
+ * creation burst of a loading screen
+ */
+static void
+benchThroughput(uint32_t submitters, uint32_t count, std::chrono::nanoseconds work) {
+  std::vector<BenchTask> tasks(count);
+  std::atomic_uint64_t completed = 0;
+  for (auto &task : tasks) {
+    task.work = work;
+    task.completed = &completed;
+  }
+  // every other task depends on the one submitted before it
+  for (uint32_t i = 1; i < count; i += 2)
+    tasks[i].dependency = &tasks[i - 1];
+
+  task_scheduler<BenchTask *> scheduler;
+  auto t0 = bench_clock::now();
+  std::vector<std::thread> threads;
+  for (uint32_t s = 0; s < submitters; s++) {
+    threads.emplace_back([&, s]() {
+      for (uint32_t i = s; i < count; i += submitters)
+        scheduler.submit(&tasks[i]);
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+  waitCompleted(completed, count);
+  auto elapsed = bench_clock::now() - t0;
+  scheduler.shutdown();
+
+  std::printf(
+      "throughput: %u submitters, %u tasks of %lldns: %.2fms, %.0f tasks/s\n", submitters, count,
+      (long long)work.count(), milliseconds(elapsed), count / std::chrono::duration<double>(elapsed).count()
+  );
+}
+
+/**
+ * Tasks waited on by a draw, each submitted after a batch of background
+ * pre-warming. They are promoted the way \c GetPipeline does before it
+ * blocks.
+ */
+static void
+benchTailLatency(uint32_t background, uint32_t samples, bool promote) {
+  std::vector<BenchTask> prewarm(background);
+  std::atomic_uint64_t prewarmed = 0;
+  for (auto &task : prewarm) {
+    task.work = std::chrono::microseconds(200);
+    task.completed = &prewarmed;
+  }
+  std::vector<BenchTask> blocking(samples);
+  for (auto &task : blocking)
+    task.work = std::chrono::microseconds(50);
+
+  task_scheduler<BenchTask *> scheduler;
+  std::vector<double> latencies;
+  uint32_t batch = background / samples;
+  for (uint32_t i = 0; i < samples; i++) {
+    for (uint32_t j = 0; j < batch; j++)
+      scheduler.submit(&prewarm[i * batch + j]);
+    auto &task = blocking[i];
+    task.submitted = bench_clock::now();
+    scheduler.submit(&task);
+    if (promote)
+      scheduler.promote(&task);
+    task.done.wait(false, std::memory_order_acquire);
+    latencies.push_back(milliseconds(task.finished - task.submitted));
+  }
+  waitCompleted(prewarmed, batch * samples);
+  scheduler.shutdown();
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) { return latencies[std::min<size_t>(latencies.size() - 1, latencies.size() * p)]; };
+  std::printf(
+      "latency (%s): %u blocking tasks, %u background tasks before each: p50 %.3fms, p99 %.3fms, max %.3fms\n",
+      promote ? "promoted" : "not promoted", samples, batch, percentile(0.5), percentile(0.99), latencies.back()
+  );
+}
+
+int
+main() {
+  benchThroughput(1, 200000, std::chrono::nanoseconds(0));
+  benchThroughput(4, 200000, std::chrono::nanoseconds(0));
+  benchThroughput(4, 20000, std::chrono::microseconds(20));
+  benchTailLatency(20000, 200, false);
+  benchTailLatency(20000, 200, true);
+  return 0;
+}
@@ -0,0 +1,140 @@
+#include "airconv_context.hpp"
+#include "airconv_public.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+#include "unit_test.hpp"
+#include <string>
+#include <vector>
+
+namespace dxmt::dxbc {
+llvm::Error convertDXBC(
+  sm50_shader_t pShader, const char *name, llvm::LLVMContext &context,
+  llvm::Module &module, SM50_SHADER_COMPILATION_ARGUMENT_DATA *pArgs
+);
+}
+
+/**
+ * A ps_5_0 container with empty signatures and a lone `ret`, the depth bounds
+ * prologue is all that is left in the converted function
+ */
+static std::vector<uint32_t>
+emptyPixelShader() {
+  auto fourcc = [](const char (&s)[5]) {
+    return uint32_t(s[0]) | uint32_t(s[1]) << 8 | uint32_t(s[2]) << 16 | uint32_t(s[3]) << 24;
+  };
+  std::vector<uint32_t> signature = {0 /* parameters */, 8 /* parameter info offset */};
+  std::vector<uint32_t> code = {0x00000050 /* ps_5_0 */, 3 /* length */, 0x0100003e /* ret */};
+
+  std::vector<std::pair<uint32_t, std::vector<uint32_t>>> blobs = {
+    {fourcc("ISGN"), signature},
+    {fourcc("OSGN"), signature},
+    {fourcc("SHEX"), code},
+  };
+  // fourcc, hash, version, size, blob count
+  std::vector<uint32_t> container = {fourcc("DXBC"), 0, 0, 0, 0, 1, 0, (uint32_t)blobs.size()};
+  uint32_t offset = (container.size() + blobs.size()) * 4;
+  for (auto &[_, data] : blobs) {
+    container.push_back(offset);
+    offset += 8 + data.size() * 4;
+  }
+  for (auto &[name, data] : blobs) {
+    container.push_back(name);
+    container.push_back(data.size() * 4);
+    container.insert(container.end(), data.begin(), data.end());
+  }
+  container[6] = container.size() * 4;
+  return container;
+}
+
+static std::string
+convert(uint32_t sample_count, bool array) {
+  auto bytecode = emptyPixelShader();
+  sm50_shader_t shader;
+  sm50_error_t err;
+  if (SM50Initialize(bytecode.data(), bytecode.size() * 4, &shader, nullptr, &err)) {
+    std::fprintf(stderr, "%s\n", SM50GetErrorMessageString(err));
+    SM50FreeError(err);
+    return {};
+  }
+
+  SM50_SHADER_COMMON_DATA data;
+  data.metal_version = SM50_SHADER_METAL_320;
+  data.flags = {};
+  data.next = 0;
+  data.type = SM50_SHADER_COMMON;
+
+  SM50_SHADER_PSO_PIXEL_SHADER_DATA pixel_data = {};
+  pixel_data.type = SM50_SHADER_PSO_PIXEL_SHADER;
+  pixel_data.next = &data;
+  pixel_data.sample_mask = 0xffffffff;
+  pixel_data.depth_bounds_test_sample_count = sample_count;
+  pixel_data.depth_bounds_test_array = array;
+
+  llvm::LLVMContext context;
+  llvm::Module module("default", context);
+  dxmt::initializeModule(module);
+  std::string ir;
+  if (auto error = dxmt::dxbc::convertDXBC(
+          shader, "shader_main", context, module, (SM50_SHADER_COMPILATION_ARGUMENT_DATA *)&pixel_data
+      )) {
+    llvm::consumeError(std::move(error));
+  } else {
+    llvm::raw_string_ostream os(ir);
+    module.print(os, nullptr);
+  }
+  SM50Destroy(shader);
+  return ir;
+}
+
+static bool
+contains(const std::string &ir, const char *str) {
+  return ir.find(str) != std::string::npos;
+}
+
+static void
+testDisabled() {
+  auto ir = convert(0, false);
+  CHECK(contains(ir, "define"));
+  CHECK(!contains(ir, "depth_bounds"));
+  CHECK(!contains(ir, "air.discard_fragment"));
+}
+
+static void
+testDepth2D() {
+  auto ir = convert(1, false);
+  CHECK(contains(ir, "@air.read_depth_2d."));
+  CHECK(contains(ir, "air.discard_fragment"));
+  CHECK(contains(ir, "!\"depth_bounds_attachment\""));
+  CHECK(contains(ir, "!\"depth_bounds\""));
+  CHECK(contains(ir, "air.position"));
+  CHECK(!contains(ir, "air.render_target_array_index"));
+}
+
+static void
+testDepth2DMultisample() {
+  auto ir = convert(4, false);
+  CHECK(contains(ir, "@air.read_depth_2d_ms."));
+  CHECK(!contains(ir, "@air.read_depth_2d."));
+}
+
+static void
+testDepth2DArray() {
+  auto ir = convert(1, true);
+  CHECK(contains(ir, "@air.read_depth_2d_array."));
+  CHECK(contains(ir, "air.render_target_array_index"));
+
+  ir = convert(4, true);
+  CHECK(contains(ir, "@air.read_depth_2d_ms_array."));
+  CHECK(contains(ir, "air.render_target_array_index"));
+}
+
+int
+main() {
+  testDisabled();
+  testDepth2D();
+  testDepth2DMultisample();
+  testDepth2DArray();
+  return UNIT_TEST_RESULT();
+}
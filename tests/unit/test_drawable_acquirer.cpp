@@ -0,0 +1,123 @@
+#include "dxmt_drawable_acquirer.hpp"
+#include "unit_test.hpp"
+#include <atomic>
+#include <thread>
+
+using namespace dxmt;
+using namespace std::chrono_literals;
+
+struct FakeDrawable {
+  uint32_t id = 0;
+  uint32_t width = 0;
+
+  explicit operator bool() const { return id != 0; }
+};
+
+/**
+ * Stands in for a CAMetalLayer: every drawable takes \c latency to become
+ * available, and the first \c nil_count attempts time out with nil
+ */
+struct FakeLayer {
+  std::chrono::milliseconds latency{0};
+  std::atomic_uint32_t nil_count = 0;
+  std::atomic_uint32_t width = 100;
+  std::atomic_uint32_t acquired = 0;
+
+  FakeDrawable
+  nextDrawable() {
+    std::this_thread::sleep_for(latency);
+    if (nil_count) {
+      nil_count--;
+      return {};
+    }
+    return {++acquired, width};
+  }
+};
+
+static auto
+anyDrawable() {
+  return [](FakeDrawable &) { return true; };
+}
+
+static void
+testAcquiredAhead() {
+  FakeLayer layer;
+  layer.latency = 20ms;
+  DrawableAcquirer<FakeDrawable> acquirer([&]() { return layer.nextDrawable(); }, 1s);
+
+  acquirer.request();
+  std::this_thread::sleep_for(100ms);
+
+  // the drawable was acquired while the "frame" was being recorded
+  auto t0 = std::chrono::steady_clock::now();
+  auto drawable = acquirer.acquire(anyDrawable());
+  CHECK(drawable);
+  CHECK(std::chrono::steady_clock::now() - t0 < 10ms);
+  // nothing is acquired without a pending request
+  CHECK_EQ(layer.acquired.load(), 1u);
+}
+
+static void
+testDroppedOnTimeout() {
+  FakeLayer layer;
+  layer.latency = 200ms;
+  DrawableAcquirer<FakeDrawable> acquirer([&]() { return layer.nextDrawable(); }, 50ms);
+
+  acquirer.request();
+  auto t0 = std::chrono::steady_clock::now();
+  auto drawable = acquirer.acquire(anyDrawable());
+  auto elapsed = std::chrono::steady_clock::now() - t0;
+  CHECK(!drawable);
+  CHECK(elapsed >= 50ms);
+  CHECK(elapsed < 200ms);
+
+  // the late drawable serves the next present
+  acquirer.request();
+  std::this_thread::sleep_for(300ms);
+  CHECK(acquirer.acquire(anyDrawable()));
+}
+
+static void
+testNilIsRetried() {
+  FakeLayer layer;
+  layer.latency = 5ms;
+  layer.nil_count = 3;
+  DrawableAcquirer<FakeDrawable> acquirer([&]() { return layer.nextDrawable(); }, 1s);
+
+  acquirer.request();
+  auto drawable = acquirer.acquire(anyDrawable());
+  CHECK(drawable);
+  CHECK_EQ(layer.nil_count.load(), 0u);
+}
+
+static void
+testStaleIsReplacedOnce() {
+  FakeLayer layer;
+  layer.latency = 5ms;
+  DrawableAcquirer<FakeDrawable> acquirer([&]() { return layer.nextDrawable(); }, 1s);
+
+  acquirer.request();
+  std::this_thread::sleep_for(50ms);
+  // "resized" after the drawable has been acquired
+  layer.width = 200;
+  auto drawable = acquirer.acquire([](FakeDrawable &d) { return d.width == 200; });
+  CHECK(drawable);
+  CHECK_EQ(drawable.width, 200u);
+  CHECK_EQ(drawable.id, 2u);
+
+  // but only once, a second mismatch is presented anyway
+  acquirer.request();
+  std::this_thread::sleep_for(50ms);
+  drawable = acquirer.acquire([](FakeDrawable &) { return false; });
+  CHECK(drawable);
+  CHECK_EQ(drawable.id, 4u);
+}
+
+int
+main() {
+  testAcquiredAhead();
+  testDroppedOnTimeout();
+  testNilIsRetried();
+  testStaleIsReplacedOnce();
+  return UNIT_TEST_RESULT();
+}
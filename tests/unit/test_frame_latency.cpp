@@ -0,0 +1,126 @@
+#include "dxmt_frame_latency.hpp"
+#include "unit_test.hpp"
+
+using namespace dxmt;
+using namespace std::chrono_literals;
+
+static FrameStatistics
+frame(clock::duration interval, clock::duration gpu_busy, clock::duration cpu_wait) {
+  FrameStatistics stats;
+  stats.present_interval = interval;
+  stats.gpu_busy_interval = gpu_busy;
+  stats.present_latency_interval = cpu_wait;
+  return stats;
+}
+
+/**
+ * Feeds a whole window of identical frames, returns the latency decided at
+ * its end
+ */
+static uint32_t
+feedWindow(FrameLatencyController &controller, const FrameStatistics &stats, uint32_t latency, uint32_t max) {
+  for (uint32_t i = 0; i < FrameLatencyController::kWindowSize - 1; i++) {
+    CHECK_EQ(controller.update(stats, latency, max), latency);
+  }
+  return controller.update(stats, latency, max);
+}
+
+static void
+testGpuBusyDisjoint() {
+  GpuBusyTracker tracker;
+  CHECK_EQ(tracker.add(100, 200), 100u);
+  CHECK_EQ(tracker.add(300, 350), 50u);
+  // no time recorded
+  CHECK_EQ(tracker.add(0, 0), 0u);
+}
+
+static void
+testGpuBusyOverlapping() {
+  GpuBusyTracker tracker;
+  CHECK_EQ(tracker.add(100, 200), 100u);
+  // only [200, 250) is new
+  CHECK_EQ(tracker.add(150, 250), 50u);
+  // fully covered
+  CHECK_EQ(tracker.add(160, 240), 0u);
+  CHECK_EQ(tracker.add(250, 300), 50u);
+  // four command buffers in flight at once count as busy as one
+  GpuBusyTracker parallel;
+  uint64_t total = 0;
+  for (uint64_t i = 0; i < 4; i++)
+    total += parallel.add(1000 + i, 2000 + i);
+  CHECK_EQ(total, 1003u);
+}
+
+static void
+testSaturatedReduces() {
+  FrameLatencyController controller;
+  // GPU busy all the time and the application waits on it
+  auto stats = frame(16ms, 16ms, 4ms);
+  CHECK_EQ(feedWindow(controller, stats, 3, 3), 2u);
+  CHECK_EQ(feedWindow(controller, stats, 2, 3), 1u);
+  // never below 1
+  CHECK_EQ(feedWindow(controller, stats, 1, 3), 1u);
+}
+
+static void
+testStarvedIncreases() {
+  FrameLatencyController controller;
+  // pipeline bubbles: the GPU idles while the application waits
+  auto stats = frame(16ms, 10ms, 2ms);
+  CHECK_EQ(feedWindow(controller, stats, 1, 3), 2u);
+  CHECK_EQ(feedWindow(controller, stats, 2, 3), 3u);
+  // never above the application's maximum
+  CHECK_EQ(feedWindow(controller, stats, 3, 3), 3u);
+}
+
+static void
+testCpuBoundUnchanged() {
+  FrameLatencyController controller;
+  // GPU idles but the application never waits
+  auto stats = frame(16ms, 8ms, 0ms);
+  CHECK_EQ(feedWindow(controller, stats, 2, 3), 2u);
+  // GPU saturated but nobody waits either
+  stats = frame(16ms, 16ms, 0ms);
+  CHECK_EQ(feedWindow(controller, stats, 2, 3), 2u);
+}
+
+static void
+testOverlapDoesNotSaturate() {
+  // two command buffers per frame running side by side, 10ms each: summed
+  // they'd look like 20ms of GPU time in a 16ms frame
+  GpuBusyTracker tracker;
+  uint64_t base = 0;
+  FrameLatencyController controller;
+  uint32_t latency = 2;
+  for (uint32_t i = 0; i < FrameLatencyController::kWindowSize; i++) {
+    uint64_t busy = tracker.add(base, base + 10'000'000) + tracker.add(base + 1'000'000, base + 11'000'000);
+    latency = controller.update(frame(16ms, std::chrono::nanoseconds(busy), 2ms), latency, 3);
+    base += 16'000'000;
+  }
+  // 11ms out of 16ms is starved, not saturated
+  CHECK_EQ(latency, 3u);
+}
+
+static void
+testIgnoresFramesWithoutInterval() {
+  FrameLatencyController controller;
+  auto stats = frame(0ms, 16ms, 4ms);
+  for (uint32_t i = 0; i < FrameLatencyController::kWindowSize * 2; i++) {
+    CHECK_EQ(controller.update(stats, 3, 3), 3u);
+  }
+  // and clamps into the valid range
+  CHECK_EQ(controller.update(stats, 0, 3), 1u);
+  CHECK_EQ(controller.update(stats, 5, 3), 3u);
+}
+
+int
+main() {
+  testGpuBusyDisjoint();
+  testGpuBusyOverlapping();
+  testSaturatedReduces();
+  testStarvedIncreases();
+  testCpuBoundUnchanged();
+  testOverlapDoesNotSaturate();
+  testIgnoresFramesWithoutInterval();
+  return UNIT_TEST_RESULT();
+}
@@ -0,0 +1,176 @@
+#include "dxmt_memory_budget.hpp"
+#include "dxmt_ring_bump_allocator.hpp"
+#include "unit_test.hpp"
+#include <deque>
+
+using namespace dxmt;
+
+constexpr uint64_t kMB = 1 << 20;
+
+static void
+testTrackAndSet() {
+  MemoryBudget budget;
+  budget.track(MemoryCategory::Buffer, 10 * kMB);
+  budget.track(MemoryCategory::Texture, 20 * kMB);
+  budget.track(MemoryCategory::Buffer, -int64_t(4 * kMB));
+  budget.set(MemoryCategory::Heap, 5 * kMB);
+  CHECK_EQ(budget.usage(MemoryCategory::Buffer), 6 * kMB);
+  CHECK_EQ(budget.usage(MemoryCategory::Texture), 20 * kMB);
+  // heaps are sampled, not accumulated
+  budget.set(MemoryCategory::Heap, 3 * kMB);
+  CHECK_EQ(budget.usage(MemoryCategory::Heap), 3 * kMB);
+  CHECK_EQ(budget.totalUsage(), 29 * kMB);
+}
+
+static void
+testWithoutBudget() {
+  MemoryBudget budget;
+  budget.track(MemoryCategory::Texture, 100 * kMB);
+  CHECK(!budget.update());
+  CHECK(!budget.underPressure());
+  CHECK_EQ(budget.generation(), 0u);
+}
+
+static void
+testInitBudgetOnce() {
+  MemoryBudget budget;
+  budget.initBudget(100 * kMB);
+  // a second device doesn't overwrite it
+  budget.initBudget(200 * kMB);
+  CHECK_EQ(budget.budget(), 100 * kMB);
+}
+
+static void
+testHysteresis() {
+  MemoryBudget budget;
+  budget.initBudget(100 * kMB);
+
+  budget.set(MemoryCategory::Heap, 90 * kMB);
+  CHECK(!budget.update());
+  CHECK(!budget.underPressure());
+
+  budget.set(MemoryCategory::Heap, 91 * kMB);
+  CHECK(budget.update());
+  CHECK(budget.underPressure());
+  CHECK_EQ(budget.generation(), 1u);
+  // reported once
+  CHECK(!budget.update());
+
+  // stays under pressure down to 80%
+  budget.set(MemoryCategory::Heap, 85 * kMB);
+  CHECK(!budget.update());
+  CHECK(budget.underPressure());
+  budget.set(MemoryCategory::Heap, 81 * kMB);
+  CHECK(!budget.update());
+  budget.set(MemoryCategory::Heap, 80 * kMB);
+  CHECK(budget.update());
+  CHECK(!budget.underPressure());
+  CHECK_EQ(budget.generation(), 2u);
+}
+
+/**
+ * Host memory blocks that count how many of them are alive
+ */
+class CountingBlockAllocator {
+public:
+  CountingBlockAllocator(uint32_t &alive) : alive_(&alive) {}
+
+  class Block {
+  public:
+    uint32_t *alive = nullptr;
+
+    Block() = default;
+    Block(const Block &) = delete;
+    Block(Block &&move) {
+      alive = move.alive;
+      move.alive = nullptr;
+    }
+
+    ~Block() {
+      if (alive)
+        (*alive)--;
+    }
+  };
+
+  Block
+  allocate(size_t) {
+    Block block;
+    block.alive = alive_;
+    (*alive_)++;
+    return block;
+  }
+
+private:
+  uint32_t *alive_;
+};
+
+static void
+testRingBumpTrim() {
+  constexpr size_t kBlockSize = 0x10000;
+  uint32_t alive = 0;
+  RingBumpState<CountingBlockAllocator, kBlockSize, dxmt::null_mutex> heap(CountingBlockAllocator{alive});
+
+  // fill three blocks, none of them completes in the meantime
+  for (uint64_t seq = 1; seq <= 3; seq++)
+    heap.allocate(seq, 0, kBlockSize, 1);
+  CHECK_EQ(alive, 3u);
+
+  // once they complete, the next block is taken from the retired ones
+  heap.allocate(4, 3, 16, 16);
+  auto stats = heap.statistics();
+  CHECK_EQ(stats.bytes_pooled, 2 * kBlockSize);
+  CHECK_EQ(stats.bytes_live, kBlockSize);
+  CHECK_EQ(stats.blocks_recycled, 1u);
+  CHECK_EQ(alive, 3u);
+
+  heap.trim();
+  stats = heap.statistics();
+  CHECK_EQ(stats.bytes_pooled, 0u);
+  CHECK_EQ(stats.bytes_live, kBlockSize);
+  CHECK_EQ(stats.blocks_released, 2u);
+  CHECK_EQ(alive, 1u);
+
+  // the block in use is left alone and still serves allocations
+  auto [block, offset] = heap.allocate(4, 3, 16, 16);
+  CHECK(block.alive);
+  CHECK_EQ(offset, 16u);
+  CHECK_EQ(alive, 1u);
+
+  // nothing pooled, nothing to release
+  heap.trim();
+  CHECK_EQ(heap.statistics().blocks_released, 2u);
+
+  // the pool refills on demand
+  heap.allocate(5, 3, kBlockSize, 1);
+  CHECK_EQ(alive, 2u);
+}
+
+static void
+testRingBumpCursorCollision() {
+  constexpr size_t kBlockSize = 0x20000;
+  uint32_t alive = 0;
+  using Heap = RingBumpState<CountingBlockAllocator, kBlockSize, dxmt::null_mutex>;
+  std::deque<Heap> heaps;
+  for (size_t i = 0; i <= kRingBumpCursorSlots; i++)
+    heaps.emplace_back(CountingBlockAllocator{alive});
+  // the ids of the first and the last heap map to the same cursor slot
+  auto &a = heaps.front(), &b = heaps.back();
+  for (uint32_t i = 0; i < 256; i++) {
+    a.allocate(1, 0, 16, 16);
+    b.allocate(1, 0, 16, 16);
+  }
+  // every allocation reserving a new span would have taken 16 blocks each
+  CHECK_EQ(a.statistics().blocks_allocated, 1u);
+  CHECK_EQ(b.statistics().blocks_allocated, 1u);
+}
+
+int
+main() {
+  testTrackAndSet();
+  testWithoutBudget();
+  testInitBudgetOnce();
+  testHysteresis();
+  testRingBumpTrim();
+  testRingBumpCursorCollision();
+  return UNIT_TEST_RESULT();
+}
@@ -0,0 +1,134 @@
+#include "dxmt_staging_layout.hpp"
+#include "unit_test.hpp"
+#include <vector>
+
+using namespace dxmt;
+
+constexpr uint32_t kBC1BlockSize = 8;
+constexpr uint32_t kBC3BlockSize = 16;
+
+static void
+testExtentUncompressed() {
+  auto extent = GetStagingExtent(13, 7, 4, false);
+  CHECK_EQ(extent.bytes_per_row, 52u);
+  CHECK_EQ(extent.rows, 7u);
+}
+
+static void
+testExtentBlockRounding() {
+  // whole blocks
+  auto extent = GetStagingExtent(16, 8, kBC1BlockSize, true);
+  CHECK_EQ(extent.bytes_per_row, 4 * kBC1BlockSize);
+  CHECK_EQ(extent.rows, 2u);
+  // partial blocks at the edge of a mip level count as whole ones
+  extent = GetStagingExtent(5, 6, kBC3BlockSize, true);
+  CHECK_EQ(extent.bytes_per_row, 2 * kBC3BlockSize);
+  CHECK_EQ(extent.rows, 2u);
+  // mip levels smaller than a block
+  extent = GetStagingExtent(1, 2, kBC1BlockSize, true);
+  CHECK_EQ(extent.bytes_per_row, kBC1BlockSize);
+  CHECK_EQ(extent.rows, 1u);
+}
+
+static void
+testOffset() {
+  // 64x64x4 RGBA8
+  CHECK_EQ(GetStagingOffset(0, 0, 0, 4, false, 256, 16384), 0u);
+  CHECK_EQ(GetStagingOffset(3, 2, 1, 4, false, 256, 16384), 16384u + 512u + 12u);
+  // 64x64 BC3: 16 blocks per row, 16 rows of blocks
+  CHECK_EQ(GetStagingOffset(8, 12, 0, kBC3BlockSize, true, 256, 4096), 3 * 256u + 2 * kBC3BlockSize);
+  // a BC3 array slice or depth slice
+  CHECK_EQ(GetStagingOffset(4, 0, 2, kBC3BlockSize, true, 256, 4096), 2 * 4096u + kBC3BlockSize);
+  // large subresources don't overflow 32 bits
+  CHECK_EQ(GetStagingOffset(0, 0, 2048, 4, false, 65536, 0x1000000), 2048ull << 24);
+}
+
+static std::vector<uint8_t>
+pattern(size_t size) {
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; i++)
+    data[i] = uint8_t(i * 7 + 1);
+  return data;
+}
+
+static void
+testWriteTightlyPacked() {
+  auto src = pattern(4 * 3 * 2);
+  std::vector<uint8_t> dst(src.size());
+  WriteStagingRows(dst.data(), 4, 12, src.data(), 4, 12, 4, 3, 2);
+  CHECK(dst == src);
+}
+
+static void
+testWritePartialBox() {
+  // a 2x2 box at (1, 1) of a 4x3 R8 subresource, source rows padded to 8 bytes
+  constexpr uint32_t kRowPitch = 4, kImagePitch = 12;
+  auto src = pattern(16);
+  std::vector<uint8_t> dst(kImagePitch, 0);
+  auto offset = GetStagingOffset(1, 1, 0, 1, false, kRowPitch, kImagePitch);
+  auto extent = GetStagingExtent(2, 2, 1, false);
+  WriteStagingRows(
+      dst.data() + offset, kRowPitch, kImagePitch, src.data(), 8, 16, extent.bytes_per_row, extent.rows, 1
+  );
+  std::vector<uint8_t> expected = {
+      0, 0,      0,      0, //
+      0, src[0], src[1], 0, //
+      0, src[8], src[9], 0, //
+  };
+  CHECK(dst == expected);
+}
+
+static void
+testWriteDepthPitch() {
+  // two 2x2 slices of a 3x3xN R8 subresource, the source has a padded depth pitch
+  constexpr uint32_t kRowPitch = 3, kImagePitch = 9;
+  auto src = pattern(2 * 10);
+  std::vector<uint8_t> dst(3 * kImagePitch, 0);
+  auto offset = GetStagingOffset(0, 1, 1, 1, false, kRowPitch, kImagePitch);
+  WriteStagingRows(dst.data() + offset, kRowPitch, kImagePitch, src.data(), 2, 10, 2, 2, 2);
+  for (uint32_t z = 0; z < 3; z++) {
+    for (uint32_t y = 0; y < 3; y++) {
+      for (uint32_t x = 0; x < 3; x++) {
+        uint8_t expected = 0;
+        if (z >= 1 && y >= 1 && x < 2)
+          expected = src[(z - 1) * 10 + (y - 1) * 2 + x];
+        CHECK_EQ(dst[z * kImagePitch + y * kRowPitch + x], expected);
+      }
+    }
+  }
+}
+
+static void
+testWriteBlockRows() {
+  // a 6x6 box at (4, 4) of a 12x12 BC1 subresource: 2x2 blocks of 3x3
+  constexpr uint32_t kRowPitch = 3 * kBC1BlockSize, kImagePitch = 3 * kRowPitch;
+  auto extent = GetStagingExtent(6, 6, kBC1BlockSize, true);
+  CHECK_EQ(extent.rows, 2u);
+  auto src = pattern(2 * 2 * kBC1BlockSize);
+  std::vector<uint8_t> dst(kImagePitch, 0);
+  auto offset = GetStagingOffset(4, 4, 0, kBC1BlockSize, true, kRowPitch, kImagePitch);
+  WriteStagingRows(
+      dst.data() + offset, kRowPitch, kImagePitch, src.data(), extent.bytes_per_row, 0, extent.bytes_per_row,
+      extent.rows, 1
+  );
+  for (uint32_t row = 0; row < 3; row++) {
+    for (uint32_t byte = 0; byte < kRowPitch; byte++) {
+      uint8_t expected = 0;
+      if (row >= 1 && byte >= kBC1BlockSize)
+        expected = src[(row - 1) * extent.bytes_per_row + byte - kBC1BlockSize];
+      CHECK_EQ(dst[row * kRowPitch + byte], expected);
+    }
+  }
+}
+
+int
+main() {
+  testExtentUncompressed();
+  testExtentBlockRounding();
+  testOffset();
+  testWriteTightlyPacked();
+  testWritePartialBox();
+  testWriteDepthPitch();
+  testWriteBlockRows();
+  return UNIT_TEST_RESULT();
+}
@@ -0,0 +1,91 @@
+#include "dxmt_timestamp_calibration.hpp"
+#include "unit_test.hpp"
+
+using namespace dxmt;
+
+constexpr uint64_t kMs = 1'000'000;
+
+/**
+ * Synthetic clocks: the GPU ticks at \c frequency per second, offset from
+ * the CPU clock by \c gpu_base ticks
+ */
+struct SyntheticClock {
+  uint64_t frequency;
+  uint64_t gpu_base;
+
+  uint64_t
+  ticks(uint64_t cpu_ns) const {
+    return gpu_base + uint64_t(double(cpu_ns) * double(frequency) / 1e9);
+  }
+};
+
+static void
+testFrequency() {
+  TimestampCalibration calibration;
+  SyntheticClock clock{24'000'000, 12345};
+  CHECK_EQ(calibration.frequency(), TimestampCalibration::kDefaultFrequency);
+
+  uint64_t epoch = calibration.calibrate(1000 * kMs, clock.ticks(1000 * kMs));
+  // too close to the reference to derive a rate
+  CHECK_EQ(calibration.calibrate(1001 * kMs, clock.ticks(1001 * kMs)), epoch);
+  CHECK_EQ(calibration.frequency(), TimestampCalibration::kDefaultFrequency);
+
+  for (uint64_t t = 1016; t < 2000; t += 16)
+    CHECK_EQ(calibration.calibrate(t * kMs, clock.ticks(t * kMs)), epoch);
+  CHECK_EQ(calibration.frequency(), 24'000'000ull);
+}
+
+static void
+testJitterWithinTolerance() {
+  TimestampCalibration calibration;
+  SyntheticClock clock{24'000'000, 0};
+  uint64_t epoch = calibration.calibrate(0, 0);
+  for (uint64_t i = 1; i < 64; i++) {
+    uint64_t t = i * 16 * kMs;
+    // +-0.3% sampling jitter
+    uint64_t ticks = clock.ticks(t) + (i & 1 ? 1000 : 0);
+    CHECK_EQ(calibration.calibrate(t, ticks), epoch);
+  }
+  auto frequency = calibration.frequency();
+  CHECK(frequency > 23'900'000 && frequency < 24'100'000);
+}
+
+static void
+testDriftStartsEpoch() {
+  TimestampCalibration calibration;
+  SyntheticClock clock{24'000'000, 0};
+  uint64_t epoch = calibration.calibrate(0, 0);
+  uint64_t t = 0;
+  for (; t < 320 * kMs; t += 16 * kMs)
+    calibration.calibrate(t, clock.ticks(t));
+  CHECK_EQ(calibration.epoch(), epoch);
+
+  // rate changes by 5%
+  uint64_t ticks = clock.ticks(t - 16 * kMs);
+  ticks += uint64_t(16 * kMs * 0.024 * 1.05);
+  CHECK(calibration.calibrate(t, ticks) != epoch);
+  CHECK_EQ(calibration.epoch(), epoch + 1);
+}
+
+static void
+testGpuClockGoingBackwards() {
+  TimestampCalibration calibration;
+  SyntheticClock clock{1'000'000'000, 5'000'000'000};
+  uint64_t epoch = calibration.calibrate(100 * kMs, clock.ticks(100 * kMs));
+  calibration.calibrate(200 * kMs, clock.ticks(200 * kMs));
+  CHECK_EQ(calibration.epoch(), epoch);
+
+  // e.g. reset after a power state change
+  CHECK_EQ(calibration.calibrate(300 * kMs, 1000), epoch + 1);
+  // the new reference is comparable again
+  CHECK_EQ(calibration.calibrate(400 * kMs, 1000 + 100 * kMs), epoch + 1);
+}
+
+int
+main() {
+  testFrequency();
+  testJitterWithinTolerance();
+  testDriftStartsEpoch();
+  testGpuClockGoingBackwards();
+  return UNIT_TEST_RESULT();
+}
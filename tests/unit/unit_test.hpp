@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+
+/**
+ * Minimal checks for unit tests of platform-independent code, a failed
+ * check is reported and makes the test exit with a non-zero status
+ */
+
+static int unit_test_failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,    \
+                   #cond);                                                     \
+      unit_test_failures++;                                                    \
+    }                                                                          \
+  } while (0)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+
+#define UNIT_TEST_RESULT() (unit_test_failures ? 1 : 0)